@@ -0,0 +1,615 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "clock.h"
+#include "cpu.h"
+#include "display.h"
+#include "keypad.h"
+#include "macros.h"
+#include "memory.h"
+#include "movie.h"
+#include "rewind.h"
+#include "state.h"
+
+#define USAGE                                  \
+    "Usage: %s [options]\n"                    \
+    "\n"                                       \
+    "  --json    Write the results as JSON.\n" \
+    "  --csv     Write the results as CSV.\n"  \
+    "  --quick   Run 100 times fewer iterations, for smoke testing.\n"
+
+#define DISPATCH_CYCLES 10000000  // Cycles per opcode family and core
+#define DRAW_ITERATIONS 2000000   // Draws per sprite height and position
+#define STARTUP_ITERATIONS 20000  // Calls per startup function
+#define ROM_CYCLES 100000000      // Cycles per whole ROM and core
+#define MOVIE_FRAMES 36000        // Frames of recorded input per core
+#define MOVIE_SPEED 30000         // Instructions per second of the movie
+#define QUICK_DIVISOR 100         // How much --quick shortens every benchmark
+
+#define MAX_RESULTS 128  // Enough for every benchmark below
+#define MAX_NAME 32      // Longest name of a single result
+#define BODY_REPEATS 64  // Copies of the measured instruction per loop
+
+// The formats results can be written in.
+enum format {
+    FORMAT_TEXT,  // Aligned columns, for humans
+    FORMAT_JSON,  // A single JSON object, for tracking over time
+    FORMAT_CSV,   // One line per result, for spreadsheets
+};
+
+// A single measurement. Every unit is a time per operation, so lower is
+// always better.
+struct result {
+    const char *group;    // The kind of benchmark
+    char name[MAX_NAME];  // What was measured within the group
+    const char *unit;     // The unit of the value
+    double value;         // The measured value
+};
+
+// A program exercising a single family of instructions.
+//
+// The setup instructions run once, after which the body instruction is
+// repeated and jumped back to forever. Instructions which jump on their own
+// are not repeated, and form the whole loop instead.
+struct family {
+    const char *name;
+    uint16_t setup[4];  // Instructions to run once, terminated by 0x0000
+    uint16_t body;      // The measured instruction
+    bool loops;         // If the body jumps back to itself
+};
+
+struct rom {
+    const char *name;
+    const uint8_t *bytes;
+    uint16_t size;
+};
+
+// A position of a sprite on the display.
+struct position {
+    const char *name;
+    uint8_t x;
+    uint8_t y;
+};
+
+// The setups make sure skips are never taken, and memory accesses stay clear
+// of the program.
+static const struct family FAMILIES[] = {
+    {"00E0", {0x0000}, 0x00E0, false},
+    {"00CN", {0x00FF, 0x0000}, 0x00C1, false},
+    {"00FB", {0x00FF, 0x0000}, 0x00FB, false},
+    {"1NNN", {0x0000}, 0x1000, true},
+    {"2NNN+00EE", {0x0000}, 0x2000, true},
+    {"3XNN", {0x0000}, 0x3001, false},
+    {"4XNN", {0x0000}, 0x4000, false},
+    {"5XY0", {0x6101, 0x0000}, 0x5010, false},
+    {"5XY2", {0xA300, 0x0000}, 0x50F2, false},
+    {"5XY3", {0xA300, 0x0000}, 0x50E3, false},
+    {"6XNN", {0x0000}, 0x6005, false},
+    {"7XNN", {0x0000}, 0x7001, false},
+    {"8XY4", {0x6101, 0x0000}, 0x8014, false},
+    {"8XYE", {0x0000}, 0x801E, false},
+    {"9XY0", {0x0000}, 0x9010, false},
+    {"ANNN", {0x0000}, 0xA300, false},
+    {"BNNN", {0x0000}, 0xB000, true},
+    {"CXNN", {0x0000}, 0xC0FF, false},
+    {"DXYN", {0x6103, 0x6204, 0xA050, 0x0000}, 0xD125, false},
+    {"DXY0", {0x00FF, 0xA050, 0x0000}, 0xD120, false},
+    {"DXYN+FN01", {0xF301, 0xA050, 0x0000}, 0xD125, false},
+    {"FX1E", {0x0000}, 0xF01E, false},
+    {"FX29", {0x0000}, 0xF029, false},
+    {"FX33", {0xA300, 0x0000}, 0xF033, false},
+    {"FX55", {0xA300, 0x0000}, 0xF255, false},
+    {"FX65", {0xA300, 0x0000}, 0xF265, false},
+};
+
+// Counts V1 up to 255 over and over, mixing arithmetic, logic and skips.
+static const uint8_t ARITHMETIC[] = {
+    0x61, 0x00,  // 0x200: V1 = 0
+    0x71, 0x01,  // 0x202: V1 += 1
+    0x80, 0x10,  // 0x204: V0 = V1
+    0x80, 0x12,  // 0x206: V0 &= V1
+    0x82, 0x34,  // 0x208: V2 += V3
+    0x31, 0x00,  // 0x20A: Skip if V1 == 0
+    0x12, 0x02,  // 0x20C: Jump to 0x202
+    0x12, 0x00,  // 0x20E: Jump to 0x200
+};
+
+// Walks font characters across the display.
+static const uint8_t DRAWING[] = {
+    0xF0, 0x29,  // 0x200: I = font character of V0
+    0xD1, 0x25,  // 0x202: Draw 8x5 at V1, V2
+    0x70, 0x01,  // 0x204: V0 += 1
+    0x71, 0x03,  // 0x206: V1 += 3
+    0x72, 0x01,  // 0x208: V2 += 1
+    0x12, 0x00,  // 0x20A: Jump to 0x200
+};
+
+// Calls a subroutine that draws a font character and stores its digits.
+static const uint8_t SUBROUTINES[] = {
+    0x23, 0x00,  // 0x200: Call 0x300
+    0x70, 0x01,  // 0x202: V0 += 1
+    0x12, 0x00,  // 0x204: Jump to 0x200
+};
+static const uint8_t SUBROUTINE[] = {
+    0xF0, 0x29,  // 0x300: I = font character of V0
+    0xD1, 0x25,  // 0x302: Draw 8x5 at V1, V2
+    0xA4, 0x00,  // 0x304: I = 0x400
+    0xF0, 0x33,  // 0x306: Store decimal digits of V0
+    0xF2, 0x65,  // 0x308: Load V0 to V2
+    0x00, 0xEE,  // 0x30A: Return
+};
+
+// Moves a random font character around with keys 5, 7, 8 and 9, and waits
+// for a release of key 0 whenever it is held down, as games do.
+static const uint8_t INTERACTIVE[] = {
+    0x60, 0x00,  // 0x200: V0 = 0
+    0xF3, 0x29,  // 0x202: I = font character of V3
+    0xD1, 0x25,  // 0x204: Draw 8x5 at V1, V2
+    0x64, 0x05,  // 0x206: V4 = 5
+    0xE4, 0xA1,  // 0x208: Skip if key V4 is up
+    0x72, 0xFF,  // 0x20A: V2 -= 1
+    0x64, 0x08,  // 0x20C: V4 = 8
+    0xE4, 0xA1,  // 0x20E: Skip if key V4 is up
+    0x72, 0x01,  // 0x210: V2 += 1
+    0x64, 0x07,  // 0x212: V4 = 7
+    0xE4, 0xA1,  // 0x214: Skip if key V4 is up
+    0x71, 0xFF,  // 0x216: V1 -= 1
+    0x64, 0x09,  // 0x218: V4 = 9
+    0xE4, 0xA1,  // 0x21A: Skip if key V4 is up
+    0x71, 0x01,  // 0x21C: V1 += 1
+    0xE0, 0xA1,  // 0x21E: Skip if key V0 is up
+    0xF6, 0x0A,  // 0x220: V6 = key
+    0xC3, 0x0F,  // 0x222: V3 = random & 0xF
+    0x12, 0x02,  // 0x224: Jump to 0x202
+};
+
+// The keys a player of INTERACTIVE holds down at a time.
+static const uint16_t PLAYER_KEYS[] = {
+    0,
+    1 << 0x5,
+    1 << 0x7,
+    1 << 0x8,
+    1 << 0x9,
+    1 << 0x5 | 1 << 0x9,
+    1 << 0x8 | 1 << 0x7,
+    1 << 0x0,
+};
+
+static const struct position POSITIONS[] = {
+    {"aligned", 8, 8},
+    {"unaligned", 3, 8},
+    {"clip-right", 60, 8},
+    {"clip-bottom", 8, 28},
+};
+
+static const uint8_t HEIGHTS[] = {1, 5, 8, 15};
+
+static const struct {
+    const char *name;
+    enum cpu_core core;
+} CORES[] = {
+    {"table", CORE_TABLE},
+    {"threaded", CORE_THREADED},
+    {"dynarec", CORE_DYNAREC},
+};
+
+static struct chip8_vm vm;
+static struct result results[MAX_RESULTS];
+static uint16_t result_count;
+static uint32_t divisor = 1;
+
+/**
+ * Records the result of a benchmark.
+ *
+ * @param group The kind of benchmark.
+ * @param name What was measured within the group.
+ * @param unit The unit of the value.
+ * @param value The measured value.
+ */
+static void record(
+    const char *group,
+    const char *name,
+    const char *unit,
+    double value)
+{
+    struct result *result = &results[result_count++];
+    result->group = group;
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->unit = unit;
+    result->value = value;
+}
+
+/**
+ * Runs the loaded program for a fixed amount of cycles.
+ *
+ * @param cycles The amount of cycles to run.
+ * @return The time spent per cycle, in nanoseconds.
+ */
+static double time_cycles(uint64_t cycles)
+{
+    struct cpu_status status;
+    double start = read_clock();
+    uint64_t executed = run_cycles(&vm, cycles, &status);
+    double elapsed = read_clock() - start;
+
+    // Warnings go to stderr, to keep the results parseable.
+    if (status.code) {
+        fprintf(
+            stderr,
+            "WARNING: CPU error %d while executing instruction %04X.\n",
+            status.code,
+            status.instruction);
+    }
+
+    return executed ? elapsed / executed * 1e9 : 0;
+}
+
+/**
+ * Assembles the program exercising a family of instructions.
+ *
+ * @param family The family to exercise.
+ * @param rom The buffer to assemble the program into.
+ * @return The size of the program in bytes.
+ */
+static uint16_t assemble_family(
+    const struct family *family,
+    uint8_t rom[MEMORY_SIZE - PROGRAM_START])
+{
+    uint16_t instructions[BODY_REPEATS + 8];
+    uint16_t count = 0;
+    for (uint8_t i = 0; family->setup[i]; i++) {
+        instructions[count++] = family->setup[i];
+    }
+
+    uint16_t body = PROGRAM_START + count * 2;
+    if (family->body == 0x2000) {
+        // A call to a return right behind a jump back to the call.
+        instructions[count++] = 0x2000 | (body + 4);
+        instructions[count++] = 0x1000 | body;
+        instructions[count++] = 0x00EE;
+    } else if (family->loops) {
+        instructions[count++] = family->body | body;
+    } else {
+        for (uint8_t i = 0; i < BODY_REPEATS; i++) {
+            instructions[count++] = family->body;
+        }
+        instructions[count++] = 0x1000 | body;
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+        rom[i * 2] = instructions[i] >> 8;
+        rom[i * 2 + 1] = instructions[i] & 0xFF;
+    }
+    return count * 2;
+}
+
+/**
+ * Measures the cost of every family of instructions on every core.
+ *
+ * The instructions are run through run_cycles(), so fetching, decoding and
+ * dispatching is included, as it is for any real program.
+ */
+static void bench_dispatch()
+{
+    uint8_t rom[MEMORY_SIZE - PROGRAM_START];
+    char name[MAX_NAME];
+
+    for (uint8_t i = 0; i < len(FAMILIES); i++) {
+        uint16_t size = assemble_family(&FAMILIES[i], rom);
+        for (uint8_t c = 0; c < len(CORES); c++) {
+            set_cpu_core(&vm, CORES[c].core);
+            startup_rom(&vm, rom, size);
+
+            snprintf(
+                name,
+                sizeof(name),
+                "%s/%s",
+                FAMILIES[i].name,
+                CORES[c].name);
+            record(
+                "dispatch",
+                name,
+                "ns/instruction",
+                time_cycles(DISPATCH_CYCLES / divisor));
+        }
+    }
+}
+
+/**
+ * Measures draw_sprite() for every sprite height and position.
+ */
+static void bench_draw()
+{
+    static const uint8_t sprite[15] = {
+        0x6C, 0xFE, 0xFE, 0x7C, 0x38, 0x10, 0xFF, 0x81,
+        0x81, 0xFF, 0x3C, 0x42, 0x81, 0x42, 0x3C,
+    };
+    uint32_t iterations = DRAW_ITERATIONS / divisor;
+    char name[MAX_NAME];
+
+    for (uint8_t h = 0; h < len(HEIGHTS); h++) {
+        for (uint8_t p = 0; p < len(POSITIONS); p++) {
+            const struct position *position = &POSITIONS[p];
+            clear_display(&vm);
+
+            // Drawing twice in a row erases the sprite again, so every other
+            // draw collides, as it does for most animations.
+            uint32_t collisions = 0;
+            double start = read_clock();
+            for (uint32_t i = 0; i < iterations; i++) {
+                collisions += draw_sprite(
+                    &vm,
+                    position->x,
+                    position->y,
+                    HEIGHTS[h],
+                    (uint8_t *)sprite);
+            }
+            double elapsed = read_clock() - start;
+
+            // Keep the collisions observable, so the draws are never elided.
+            if (collisions != iterations / 2) {
+                fprintf(stderr, "WARNING: Unexpected sprite collisions.\n");
+            }
+
+            snprintf(
+                name,
+                sizeof(name),
+                "8x%u/%s",
+                HEIGHTS[h],
+                position->name);
+            record("draw", name, "ns/draw", elapsed / iterations * 1e9);
+        }
+    }
+}
+
+/**
+ * Measures the functions resetting a machine before running a program, or
+ * restoring it from a save state.
+ */
+static void bench_startup()
+{
+    uint32_t iterations = STARTUP_ITERATIONS / divisor;
+
+    double start = read_clock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        init_memory(&vm);
+    }
+    double per_call = (read_clock() - start) / iterations * 1e9;
+    record("startup", "init_memory", "ns/call", per_call);
+
+    start = read_clock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        startup_rom(&vm, ARITHMETIC, sizeof(ARITHMETIC));
+    }
+    per_call = (read_clock() - start) / iterations * 1e9;
+    record("startup", "startup_rom", "ns/call", per_call);
+
+    // The machine has to be released again before being initialized.
+    start = read_clock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        free_vm(&vm);
+        init_vm(&vm);
+    }
+    per_call = (read_clock() - start) / iterations * 1e9;
+    record("startup", "init_vm", "ns/call", per_call);
+
+    // Restore a checkpoint of the running program, as when resuming a run.
+    static uint8_t state[STATE_SIZE];
+    startup_rom(&vm, ARITHMETIC, sizeof(ARITHMETIC));
+    start = read_clock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        save_state(&vm, state, sizeof(state));
+    }
+    per_call = (read_clock() - start) / iterations * 1e9;
+    record("startup", "save_state", "ns/call", per_call);
+
+    start = read_clock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        load_state(&vm, state, sizeof(state));
+    }
+    per_call = (read_clock() - start) / iterations * 1e9;
+    record("startup", "load_state", "ns/call", per_call);
+
+    // Capture a snapshot with a few changed registers every frame, as the
+    // rewind history does while running.
+    static struct rewind r;
+    init_rewind(&r, DEFAULT_REWIND_BUDGET, 1);
+    start = read_clock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        vm.V[0] = i;
+        vm.PC = PROGRAM_START + (i & 0xFE);
+        record_frame(&r, &vm);
+    }
+    per_call = (read_clock() - start) / iterations * 1e9;
+    record("startup", "record_frame", "ns/call", per_call);
+    free_rewind(&r);
+}
+
+/**
+ * Measures whole programs on every core.
+ */
+static void bench_roms()
+{
+    // The subroutine lives at 0x300, so pad the ROM up to it.
+    uint8_t subroutines[0x100 + sizeof(SUBROUTINE)] = {0};
+    memcpy(subroutines, SUBROUTINES, sizeof(SUBROUTINES));
+    memcpy(subroutines + 0x100, SUBROUTINE, sizeof(SUBROUTINE));
+
+    struct rom roms[] = {
+        {"arithmetic", ARITHMETIC, sizeof(ARITHMETIC)},
+        {"drawing", DRAWING, sizeof(DRAWING)},
+        {"subroutines", subroutines, sizeof(subroutines)},
+    };
+    char name[MAX_NAME];
+
+    for (uint8_t r = 0; r < len(roms); r++) {
+        for (uint8_t c = 0; c < len(CORES); c++) {
+            set_cpu_core(&vm, CORES[c].core);
+            startup_rom(&vm, roms[r].bytes, roms[r].size);
+
+            snprintf(
+                name,
+                sizeof(name),
+                "%s/%s",
+                roms[r].name,
+                CORES[c].name);
+            record("rom", name, "ns/cycle", time_cycles(ROM_CYCLES / divisor));
+        }
+    }
+}
+
+/**
+ * Records a player pressing keys at random into INTERACTIVE.
+ *
+ * The keys are drawn from a fixed seed, so every run of the benchmark plays
+ * the exact same movie.
+ *
+ * @param movie The movie to record into.
+ * @param frames The amount of frames to record.
+ */
+static void record_player(struct movie *movie, uint32_t frames)
+{
+    set_instructions_per_second(&vm, MOVIE_SPEED);
+    startup_rom(&vm, INTERACTIVE, sizeof(INTERACTIVE));
+    start_recording(movie, &vm);
+
+    struct cpu_status status;
+    uint32_t random = 1;
+    uint16_t keys = 0;
+    uint8_t held = 0;
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        // Hold every combination of keys for 4 to 19 frames.
+        if (held-- == 0) {
+            random = random * 1103515245 + 12345;
+            keys = PLAYER_KEYS[(random >> 16) % len(PLAYER_KEYS)];
+            held = 4 + (random >> 8) % 16;
+        }
+        set_keys(&vm, keys);
+        record_keys(movie, keys);
+        run_frame(&vm, &status);
+    }
+    finish_recording(movie, &vm);
+}
+
+/**
+ * Measures playing back a movie of an interactive program on every core,
+ * which exercises the keypad, waits for keys and frame pacing the way a
+ * player would, rather than an attract mode.
+ */
+static void bench_movies()
+{
+    static struct movie movie;
+    init_movie(&movie);
+    record_player(&movie, MOVIE_FRAMES / divisor);
+    char name[MAX_NAME];
+
+    for (uint8_t c = 0; c < len(CORES); c++) {
+        set_cpu_core(&vm, CORES[c].core);
+        startup_rom(&vm, INTERACTIVE, sizeof(INTERACTIVE));
+        start_playback(&movie, &vm);
+
+        struct cpu_status status;
+        uint16_t keys;
+        double start = read_clock();
+        while (next_keys(&movie, &keys)) {
+            set_keys(&vm, keys);
+            run_frame(&vm, &status);
+        }
+        double per_frame = (read_clock() - start) / movie.frames * 1e9;
+
+        // A diverging core would not have run the same workload.
+        if (!verify_movie(&movie, &vm)) {
+            fprintf(
+                stderr,
+                "WARNING: Playback diverged on the %s core.\n",
+                CORES[c].name);
+        }
+
+        snprintf(name, sizeof(name), "interactive/%s", CORES[c].name);
+        record("movie", name, "ns/frame", per_frame);
+    }
+
+    free_movie(&movie);
+    set_instructions_per_second(&vm, INSTRUCTIONS_PER_SECOND);
+}
+
+/**
+ * Writes all recorded results to stdout.
+ *
+ * @param format The format to write the results in.
+ */
+static void write_results(enum format format)
+{
+    if (format == FORMAT_JSON) {
+        printf("{\n  \"benchmarks\": [\n");
+    } else if (format == FORMAT_CSV) {
+        printf("group,name,unit,value\n");
+    }
+
+    for (uint16_t i = 0; i < result_count; i++) {
+        struct result *result = &results[i];
+        switch (format) {
+            case FORMAT_TEXT:
+                printf(
+                    "%-10s %-24s %10.2f %s\n",
+                    result->group,
+                    result->name,
+                    result->value,
+                    result->unit);
+                break;
+            case FORMAT_JSON:
+                printf(
+                    "    {\"group\": \"%s\", \"name\": \"%s\", "
+                    "\"unit\": \"%s\", \"value\": %.3f}%s\n",
+                    result->group,
+                    result->name,
+                    result->unit,
+                    result->value,
+                    i + 1 < result_count ? "," : "");
+                break;
+            case FORMAT_CSV:
+                printf(
+                    "%s,%s,%s,%.3f\n",
+                    result->group,
+                    result->name,
+                    result->unit,
+                    result->value);
+                break;
+        }
+    }
+
+    if (format == FORMAT_JSON) {
+        printf("  ]\n}\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    enum format format = FORMAT_TEXT;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            format = FORMAT_JSON;
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            format = FORMAT_CSV;
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            divisor = QUICK_DIVISOR;
+        } else {
+            printf(USAGE, argv[0]);
+            return 1;
+        }
+    }
+
+    init_vm(&vm);
+    bench_dispatch();
+    bench_draw();
+    bench_startup();
+    bench_roms();
+    bench_movies();
+    free_vm(&vm);
+
+    write_results(format);
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "cpu.h"
+#include "keypad.h"
+#include "memory.h"
+#include "quirks.h"
+
+// Every input starts with a header picking how the rest of it runs:
+//
+// - The core in the lowest two bits, and the quirk profile in the next two.
+// - If the rest is a stream of instructions rather than a ROM, in bit 4.
+// - The keys held down throughout, as two bytes.
+//
+// A ROM runs from its first instruction like any other program. A stream runs
+// its instructions one after the other regardless of where they jump to, so
+// every instruction is reached no matter how the ones before it behave.
+#define HEADER_SIZE 3
+#define CORE_MASK 0x03
+#define QUIRKS_SHIFT 2
+#define STREAM_MODE 0x10
+
+#define MAX_CYCLES 4096  // Cycles a ROM runs for, as most never halt
+
+// The machine is reused across inputs, as resetting it only restores what the
+// last input changed, which is far cheaper than initializing it again.
+static struct chip8_vm vm;
+static bool initialized = false;
+static enum quirk_profile profile = DEFAULT_QUIRK_PROFILE;
+
+/**
+ * Runs an input as a stream of instructions, loaded as the ROM as well, so
+ * instructions reading from memory around the program counter see the stream.
+ *
+ * @param stream The instructions, two bytes each.
+ * @param size The amount of bytes of the stream.
+ */
+static void run_stream(const uint8_t *stream, size_t size)
+{
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        debug_run_instruction(&vm, (stream[i] << 8) | stream[i + 1]);
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (!initialized) {
+        init_vm(&vm);
+        initialized = true;
+    }
+    if (size < HEADER_SIZE) {
+        return 0;
+    }
+
+    // The spare value of the core bits is rejected rather than folded onto a
+    // core, which would run that core twice as often as the others.
+    if ((data[0] & CORE_MASK) > CORE_DYNAREC) {
+        return 0;
+    }
+    enum cpu_core core = data[0] & CORE_MASK;
+
+    // Changing the quirks decodes every instruction again, so only do so when
+    // they actually change.
+    enum quirk_profile quirks = (data[0] >> QUIRKS_SHIFT) % QUIRK_PROFILE_COUNT;
+    if (quirks != profile) {
+        set_quirks(&vm, QUIRK_PROFILES[quirks]);
+        profile = quirks;
+    }
+    set_cpu_core(&vm, core);
+
+    const uint8_t *rom = data + HEADER_SIZE;
+    size -= HEADER_SIZE;
+    if (size > MEMORY_SIZE - PROGRAM_START) {
+        size = MEMORY_SIZE - PROGRAM_START;
+    }
+
+    // Nothing of the last input may carry over, or crashes could not be
+    // reproduced from their input alone.
+    memset(vm.flags, 0, sizeof(vm.flags));
+    set_keys(&vm, 0);
+    startup_rom(&vm, rom, size);
+    set_keys(&vm, data[1] | data[2] << 8);
+
+    if (data[0] & STREAM_MODE) {
+        run_stream(rom, size);
+    } else {
+        struct cpu_status status;
+        run_cycles(&vm, MAX_CYCLES, &status);
+    }
+    return 0;
+}
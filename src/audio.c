@@ -0,0 +1,116 @@
+#include "audio.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "chip8.h"
+
+#define PATTERN_BITS (AUDIO_PATTERN_SIZE * 8)
+
+// 2 ^ (i / 48) as 16.16 fixed point, the fractional octaves of the pitch, so
+// rendering never needs the math library.
+static const uint32_t OCTAVE_STEPS[48] = {
+    65536,  66489,  67456,  68438,  69433,  70443,  71468,  72507,
+    73562,  74632,  75717,  76819,  77936,  79069,  80220,  81386,
+    82570,  83771,  84990,  86226,  87480,  88752,  90043,  91353,
+    92682,  94030,  95398,  96785,  98193,  99621,  101070, 102540,
+    104032, 105545, 107080, 108638, 110218, 111821, 113448, 115098,
+    116772, 118470, 120194, 121942, 123715, 125515, 127341, 129193,
+};
+
+void reset_audio(struct chip8_vm *vm)
+{
+    // Alternate 4 bits on and off, a 500 Hz square wave at the default pitch.
+    memset(vm->audio.pattern, 0xF0, AUDIO_PATTERN_SIZE);
+    vm->audio.pitch = DEFAULT_PITCH;
+}
+
+void set_audio_pattern(struct chip8_vm *vm, const uint8_t *pattern)
+{
+    memcpy(vm->audio.pattern, pattern, AUDIO_PATTERN_SIZE);
+}
+
+void set_pitch(struct chip8_vm *vm, uint8_t pitch)
+{
+    vm->audio.pitch = pitch;
+}
+
+void init_audio_output(struct audio_output *output)
+{
+    atomic_init(&output->head, 0);
+    atomic_init(&output->tail, 0);
+    output->phase = 0;
+}
+
+void set_audio_output(struct chip8_vm *vm, struct audio_output *output)
+{
+    vm->audio_out = output;
+}
+
+void play_tick(struct chip8_vm *vm)
+{
+    struct audio_output *output = vm->audio_out;
+    uint32_t head = atomic_load_explicit(&output->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&output->tail, memory_order_acquire);
+    if (head - tail > MAX_QUEUED_SAMPLES) {
+        return;
+    }
+
+    if (vm->sound_timer == 0) {
+        for (uint32_t i = 0; i < TICK_SAMPLES; i++) {
+            output->samples[(head + i) % AUDIO_RING_SIZE] = 0;
+        }
+    } else {
+        const uint8_t *pattern = vm->audio.pattern;
+        uint32_t step = pattern_step(vm->audio.pitch);
+        uint32_t phase = output->phase;
+        for (uint32_t i = 0; i < TICK_SAMPLES; i++) {
+            uint8_t bit = phase >> 16;
+            bool on = (pattern[bit / 8] >> (7 - bit % 8)) & 1;
+            output->samples[(head + i) % AUDIO_RING_SIZE] =
+                on ? SAMPLE_VOLUME : -SAMPLE_VOLUME;
+            phase = (phase + step) % (PATTERN_BITS << 16);
+        }
+        output->phase = phase;
+    }
+
+    // Publish the samples only once they are all written.
+    atomic_store_explicit(
+        &output->head,
+        head + TICK_SAMPLES,
+        memory_order_release);
+}
+
+uint32_t drain_audio(
+    struct audio_output *output,
+    int16_t *samples,
+    uint32_t count)
+{
+    uint32_t tail = atomic_load_explicit(&output->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&output->head, memory_order_acquire);
+    uint32_t taken = head - tail < count ? head - tail : count;
+
+    for (uint32_t i = 0; i < taken; i++) {
+        samples[i] = output->samples[(tail + i) % AUDIO_RING_SIZE];
+    }
+    for (uint32_t i = taken; i < count; i++) {
+        samples[i] = 0;
+    }
+
+    // Hand the drained part of the ring back to the emulation.
+    atomic_store_explicit(&output->tail, tail + taken, memory_order_release);
+    return taken;
+}
+
+static uint32_t pattern_step(uint8_t pitch)
+{
+    // 4000 * 2 ^ ((pitch - 64) / 48) bits per second, split into whole and
+    // fractional octaves around the default pitch.
+    int16_t offset = pitch - DEFAULT_PITCH;
+    int16_t octaves = offset >= 0 ? offset / 48 : (offset - 47) / 48;
+    uint64_t rate = 4000 * (uint64_t)OCTAVE_STEPS[offset - octaves * 48];
+    rate = octaves >= 0 ? rate << octaves : rate >> -octaves;
+    return rate / SAMPLE_RATE;
+}
@@ -0,0 +1,122 @@
+#ifndef AUDIO_H_
+#define AUDIO_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define AUDIO_PATTERN_SIZE 16  // Bytes of the pattern F002 loads, 128 bits
+#define DEFAULT_PITCH 64       // Plays the pattern at 4000 bits per second
+
+#define SAMPLE_RATE 44100     // Samples per second of the audio output
+#define TICK_SAMPLES 735      // Samples per timer tick, SAMPLE_RATE / 60
+#define SAMPLE_VOLUME 4096    // The amplitude of the samples
+#define AUDIO_RING_SIZE 4096  // Samples the ring holds, a power of two
+
+// The most samples left queued before another tick is pushed, which bounds
+// the latency of the output to about four ticks.
+#define MAX_QUEUED_SAMPLES (4 * TICK_SAMPLES)
+
+struct chip8_vm;
+
+// The sound of the XO-CHIP, which plays a 1-bit pattern on repeat while the
+// sound timer runs. Programs that never load a pattern get a square wave.
+struct audio {
+    uint8_t pattern[AUDIO_PATTERN_SIZE];  // The bits to play, MSB first
+    uint8_t pitch;                        // The playback rate, set by FX3A
+};
+
+// The samples a machine plays, handed from the thread emulating it to the
+// audio thread of the host.
+//
+// The ring has a single producer and a single consumer, which each only write
+// their own index, so neither ever waits for the other. Samples of ticks the
+// audio thread has no room for are dropped, and the audio thread plays
+// silence when it runs out, so neither emulating ahead nor falling behind
+// glitches the output for longer than it lasts.
+struct audio_output {
+    _Atomic uint32_t head;             // Samples pushed by the emulation
+    _Atomic uint32_t tail;             // Samples drained by the audio thread
+    uint32_t phase;                    // Bits into the pattern, as 16.16
+    int16_t samples[AUDIO_RING_SIZE];  // Indexed modulo the ring size
+};
+
+/**
+ * Restores the default square wave and pitch.
+ *
+ * @param vm The machine whose sound to reset.
+ */
+void reset_audio(struct chip8_vm *vm);
+
+/**
+ * Replaces the pattern played while the sound timer runs.
+ *
+ * Corresponds to the CPU instruction 0xF002.
+ *
+ * @param vm The machine whose pattern to replace.
+ * @param pattern The AUDIO_PATTERN_SIZE bytes of the new pattern.
+ */
+void set_audio_pattern(struct chip8_vm *vm, const uint8_t *pattern);
+
+/**
+ * Sets the rate at which the pattern is played.
+ *
+ * Corresponds to the CPU instruction 0xFX3A. The pattern plays at
+ * 4000 * 2 ^ ((pitch - 64) / 48) bits per second.
+ *
+ * @param vm The machine whose pitch to set.
+ * @param pitch The new pitch.
+ */
+void set_pitch(struct chip8_vm *vm, uint8_t pitch);
+
+/**
+ * Empties an audio output.
+ *
+ * @param output The output to empty.
+ */
+void init_audio_output(struct audio_output *output);
+
+/**
+ * Sends the samples of every following timer tick to an audio output.
+ *
+ * The output is not part of the machine's state, and only ever touched by the
+ * thread running the machine, besides the audio thread draining it.
+ *
+ * @param vm The machine whose samples to send.
+ * @param output The output to send them to, or NULL to stop sending any.
+ */
+void set_audio_output(struct chip8_vm *vm, struct audio_output *output);
+
+/**
+ * Renders the samples of a single timer tick into the audio output.
+ *
+ * Called by the scheduler on every tick, before the sound timer counts down,
+ * so a sound timer set to N sounds for exactly N ticks. The tick is dropped if
+ * the output is too full, and never waits for the audio thread.
+ *
+ * @param vm The machine whose sound to render, with an audio output.
+ */
+void play_tick(struct chip8_vm *vm);
+
+/**
+ * Takes samples out of an audio output, on the audio thread.
+ *
+ * @param output The output to drain.
+ * @param samples The buffer to fill, padded with silence if the output runs
+ * out of samples.
+ * @param count The amount of samples to fill in.
+ * @return The amount of samples taken out of the output.
+ */
+uint32_t drain_audio(
+    struct audio_output *output,
+    int16_t *samples,
+    uint32_t count);
+
+/**
+ * Calculates how far the pattern advances per sample.
+ *
+ * @param pitch The pitch the pattern plays at.
+ * @return The bits of the pattern played per sample, as 16.16 fixed point.
+ */
+static uint32_t pattern_step(uint8_t pitch);
+
+#endif  // !AUDIO_H_
@@ -0,0 +1,70 @@
+#include "bytes.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Every value is written and read a byte at a time through a local pointer,
+// which compilers merge into a single store or load on little-endian hosts.
+// Going through the position itself would not merge, as the bytes written
+// could alias it.
+
+void put_u16(uint8_t **out, uint16_t value)
+{
+    uint8_t *bytes = *out;
+    bytes[0] = value & 0xFF;
+    bytes[1] = value >> 8;
+    *out = bytes + 2;
+}
+
+void put_u32(uint8_t **out, uint32_t value)
+{
+    uint8_t *bytes = *out;
+    for (uint8_t i = 0; i < 4; i++) {
+        bytes[i] = value >> (i * 8);
+    }
+    *out = bytes + 4;
+}
+
+void put_u64(uint8_t **out, uint64_t value)
+{
+    uint8_t *bytes = *out;
+    for (uint8_t i = 0; i < 8; i++) {
+        bytes[i] = value >> (i * 8);
+    }
+    *out = bytes + 8;
+}
+
+uint16_t get_u16(const uint8_t **in)
+{
+    const uint8_t *bytes = *in;
+    *in = bytes + 2;
+    return bytes[0] | bytes[1] << 8;
+}
+
+uint32_t get_u32(const uint8_t **in)
+{
+    const uint8_t *bytes = *in;
+    *in = bytes + 4;
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 |
+           (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+uint64_t get_u64(const uint8_t **in)
+{
+    uint64_t low = get_u32(in);
+    return low | (uint64_t)get_u32(in) << 32;
+}
+
+void put_u64_array(uint8_t **out, const uint64_t *values, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        put_u64(out, values[i]);
+    }
+}
+
+void get_u64_array(const uint8_t **in, uint64_t *values, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        values[i] = get_u64(in);
+    }
+}
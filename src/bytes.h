@@ -0,0 +1,76 @@
+#ifndef BYTES_H_
+#define BYTES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Save states and movies are written in little-endian byte order, so files
+// move between hosts regardless of their own byte order.
+
+/**
+ * Writes a 16-bit value in little-endian byte order.
+ *
+ * @param out The position to write to, advanced past the value.
+ * @param value The value to write.
+ */
+void put_u16(uint8_t **out, uint16_t value);
+
+/**
+ * Writes a 32-bit value in little-endian byte order.
+ *
+ * @param out The position to write to, advanced past the value.
+ * @param value The value to write.
+ */
+void put_u32(uint8_t **out, uint32_t value);
+
+/**
+ * Writes a 64-bit value in little-endian byte order.
+ *
+ * @param out The position to write to, advanced past the value.
+ * @param value The value to write.
+ */
+void put_u64(uint8_t **out, uint64_t value);
+
+/**
+ * Reads a 16-bit value in little-endian byte order.
+ *
+ * @param in The position to read from, advanced past the value.
+ * @return The value that was read.
+ */
+uint16_t get_u16(const uint8_t **in);
+
+/**
+ * Reads a 32-bit value in little-endian byte order.
+ *
+ * @param in The position to read from, advanced past the value.
+ * @return The value that was read.
+ */
+uint32_t get_u32(const uint8_t **in);
+
+/**
+ * Reads a 64-bit value in little-endian byte order.
+ *
+ * @param in The position to read from, advanced past the value.
+ * @return The value that was read.
+ */
+uint64_t get_u64(const uint8_t **in);
+
+/**
+ * Writes an array of 64-bit values in little-endian byte order.
+ *
+ * @param out The position to write to, advanced past the values.
+ * @param values The values to write.
+ * @param count The amount of values to write.
+ */
+void put_u64_array(uint8_t **out, const uint64_t *values, size_t count);
+
+/**
+ * Reads an array of 64-bit values in little-endian byte order.
+ *
+ * @param in The position to read from, advanced past the values.
+ * @param values Receives the values that were read.
+ * @param count The amount of values to read.
+ */
+void get_u64_array(const uint8_t **in, uint64_t *values, size_t count);
+
+#endif  // !BYTES_H_
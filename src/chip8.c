@@ -0,0 +1,122 @@
+#include "chip8.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bytes.h"
+
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325
+#define FNV_PRIME 0x100000001B3
+
+void init_vm(struct chip8_vm *vm)
+{
+    memset(vm, 0, sizeof(*vm));
+    vm->PC = PROGRAM_START;
+    vm->core = CPU_DEFAULT_CORE;
+    vm->quirks = QUIRK_PROFILES[DEFAULT_QUIRK_PROFILE];
+    vm->display_dirty = true;
+    select_planes(vm, 0x1);
+    reset_audio(vm);
+    init_stack(&vm->stack);
+    init_cpu(vm);
+    init_memory(vm);
+    set_instructions_per_second(vm, INSTRUCTIONS_PER_SECOND);
+    set_idle_skipping(vm, true);
+    reset_scheduler(vm);
+    seed_rng(vm, DEFAULT_SEED);
+}
+
+void free_vm(struct chip8_vm *vm)
+{
+    free_decoded_pages(vm);
+#ifdef HAS_DYNAREC
+    free_dynarec(vm);
+#endif  // HAS_DYNAREC
+}
+
+/**
+ * Folds a range of bytes into a running FNV-1a hash.
+ *
+ * @param hash The hash so far.
+ * @param data The bytes to hash.
+ * @param size The amount of bytes to hash.
+ * @return The updated hash.
+ */
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * Folds a 16-bit value into a running FNV-1a hash, in little-endian order.
+ *
+ * @param hash The hash so far.
+ * @param value The value to hash.
+ * @return The updated hash.
+ */
+static uint64_t hash_u16(uint64_t hash, uint16_t value)
+{
+    uint8_t bytes[sizeof(value)];
+    uint8_t *out = bytes;
+    put_u16(&out, value);
+    return hash_bytes(hash, bytes, sizeof(bytes));
+}
+
+/**
+ * Folds a 64-bit value into a running FNV-1a hash, in little-endian order.
+ *
+ * @param hash The hash so far.
+ * @param value The value to hash.
+ * @return The updated hash.
+ */
+static uint64_t hash_u64(uint64_t hash, uint64_t value)
+{
+    uint8_t bytes[sizeof(value)];
+    uint8_t *out = bytes;
+    put_u64(&out, value);
+    return hash_bytes(hash, bytes, sizeof(bytes));
+}
+
+uint64_t hash_vm(const struct chip8_vm *vm)
+{
+    // Wider values are hashed in little-endian order, so every host hashes
+    // the same machine alike, as movies recorded on one host verify on all.
+    uint64_t hash = FNV_OFFSET_BASIS;
+    hash = hash_u16(hash, vm->PC);
+    hash = hash_u16(hash, vm->I);
+    hash = hash_bytes(hash, vm->V, sizeof(vm->V));
+    hash = hash_bytes(hash, &vm->delay_timer, sizeof(vm->delay_timer));
+    hash = hash_bytes(hash, &vm->sound_timer, sizeof(vm->sound_timer));
+    hash = hash_u64(hash, vm->rng.state);
+
+    // Only the used part of the stack, as popped entries are left behind.
+    hash = hash_bytes(hash, &vm->stack.pointer, sizeof(vm->stack.pointer));
+    for (int8_t i = 0; i <= vm->stack.pointer; i++) {
+        hash = hash_u16(hash, vm->stack.addresses[i]);
+    }
+
+    hash = hash_bytes(hash, vm->memory, sizeof(vm->memory));
+    hash = hash_bytes(hash, vm->flags, sizeof(vm->flags));
+    hash = hash_bytes(hash, &vm->hires, sizeof(vm->hires));
+    hash = hash_bytes(hash, &vm->planes, sizeof(vm->planes));
+    hash = hash_bytes(hash, &vm->audio, sizeof(vm->audio));
+
+    const uint64_t *words = &vm->display[0][0][0];
+    for (size_t i = 0; i < sizeof(vm->display) / sizeof(*words); i++) {
+        hash = hash_u64(hash, words[i]);
+    }
+    return hash;
+}
+
+uint64_t hash_program(const struct chip8_vm *vm)
+{
+    return hash_bytes(
+        FNV_OFFSET_BASIS,
+        &vm->memory[PROGRAM_START],
+        MEMORY_SIZE - PROGRAM_START);
+}
@@ -0,0 +1,120 @@
+#ifndef CHIP8_H_
+#define CHIP8_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio.h"
+#include "cpu.h"
+#include "display.h"
+#include "dynarec.h"
+#include "keypad.h"
+#include "memory.h"
+#include "profile.h"
+#include "rng.h"
+#include "scheduler.h"
+#include "stack.h"
+
+// A complete CHIP-8 machine.
+//
+// Every module keeps its state in here rather than in file-level statics, so
+// any amount of machines can exist side by side. The machine is a single
+// block, ordered by how often the fields are accessed, so the state touched by
+// every instruction shares cache lines. Only caches derived from memory are
+// allocated, page by page as instructions in them first execute.
+struct chip8_vm {
+    uint16_t PC;                      // Program counter
+    uint16_t I;                       // Index register
+    uint8_t V[16];                    // Variable registers
+    enum cpu_core core;               // The core executing instructions
+    struct quirks quirks;             // Which behavior quirky instructions have
+    stack stack;                      // The stack memory
+    bool display_dirty;               // If the display changed since published
+    bool hires;                       // If the display is in high resolution
+    uint64_t drawn_rows;              // Rows drawn to since the last reset
+    uint8_t planes;                   // The bit-planes drawn to, as a mask
+    uint8_t delay_timer;              // Counts down at 60 Hz
+    uint8_t sound_timer;              // Counts down at 60 Hz, beeping until 0
+    struct keypad keypad;             // The keys the host holds down
+    struct scheduler scheduler;       // When the timers tick next
+    struct rng rng;                   // Draws the numbers of CXNN
+    uint8_t flags[FLAG_REGISTERS];    // Kept by FX75 across programs
+    struct audio audio;               // What plays while the sound timer runs
+    memory_write_hook write_hook;     // Notified of any writes to memory
+    struct audio_output *audio_out;   // Receives the samples of every tick
+    uint8_t memory[MEMORY_SIZE];      // The memory, including the font
+
+    // The lines of memory written to since it was last reset, as a bit per
+    // line, see reset_memory().
+    uint64_t dirty_lines[MEMORY_LINES / 64];
+
+    // The pixels of every plane, as rows of words in the high resolution, see
+    // display.c.
+    uint64_t display[PLANE_COUNT][HIRES_SCREEN_HEIGHT][ROW_WORDS];
+
+    // Decoded instructions by their address, in pages of memory allocated as
+    // their first instruction executes. Filled in lazily as they are first
+    // executed and invalidated whenever the memory they were decoded from
+    // changes.
+    struct decoded_instruction *decoded_pages[MEMORY_PAGES];
+    // Stands in for instructions whose page could not be allocated, which are
+    // decoded again every time they execute.
+    struct decoded_instruction uncached;
+
+#ifdef HAS_DYNAREC
+    struct dynarec_cache *dynarec;  // Native code, allocated on first use
+#endif  // HAS_DYNAREC
+
+#ifdef CHIP8_PROFILE
+    struct profile profile;  // What the machine spent its cycles on
+#endif  // CHIP8_PROFILE
+};
+
+/**
+ * Initializes a machine into a stable, empty state.
+ *
+ * Must be called once before any other use of the machine. A ROM still has to
+ * be loaded with startup() or startup_rom() before running it. A machine that
+ * ran before has to be released with free_vm() first, or the resources it
+ * acquired leak.
+ *
+ * @param vm The machine to initialize.
+ */
+void init_vm(struct chip8_vm *vm);
+
+/**
+ * Releases any resources the machine acquired while running.
+ *
+ * The machine itself is never allocated, but the pages of decoded instructions
+ * are, and the dynamic recompiler maps executable memory for its native code.
+ * The machine can be initialized again afterwards.
+ *
+ * @param vm The machine to release.
+ */
+void free_vm(struct chip8_vm *vm);
+
+/**
+ * Hashes the observable state of a machine.
+ *
+ * Covers the registers, timers, random number generator, stack, memory,
+ * display and sound, but none of the state derived from them, so machines that
+ * ran the same program to the same point hash identically regardless of the
+ * core that ran them.
+ *
+ * @param vm The machine to hash.
+ * @return The 64-bit FNV-1a hash of the machine state.
+ */
+uint64_t hash_vm(const struct chip8_vm *vm);
+
+/**
+ * Hashes the program space of a machine.
+ *
+ * Identifies the loaded program right after startup(), as the program space
+ * holds nothing else yet.
+ *
+ * @param vm The machine whose program to hash.
+ * @return The 64-bit FNV-1a hash of the memory from PROGRAM_START on.
+ */
+uint64_t hash_program(const struct chip8_vm *vm);
+
+#endif  // !CHIP8_H_
@@ -0,0 +1,14 @@
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+/**
+ * Reads a monotonic timestamp in seconds.
+ *
+ * Unlike the wall-clock time, it never jumps when the system clock is set, so
+ * the difference between two timestamps is always the time that passed.
+ *
+ * @return The time in seconds since an arbitrary, fixed point in the past.
+ */
+double read_clock();
+
+#endif  // !CLOCK_H_
@@ -3,10 +3,18 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "audio.h"
+#include "chip8.h"
 #include "display.h"
+#include "dynarec.h"
+#include "keypad.h"
 #include "macros.h"
 #include "memory.h"
+#include "profile.h"
+#include "rng.h"
+#include "scheduler.h"
 #include "stack.h"
 
 // Bit masks for extracting instructions.
@@ -17,251 +25,1434 @@
 #define B2 0x00FF  // Second byte - an 8-bit number
 #define MA 0x0FFF  // Three nibbles - a 12-bit memory address
 
-static uint16_t PC = 0x200;  // Program counter
-static uint16_t I = 0x000;   // Index register
-static uint8_t V[16];        // Variable registers
-static stack s;              // The stack memory
+// Computed gotos are a GCC extension, which Clang supports as well.
+#if defined(__GNUC__)
+#define HAS_COMPUTED_GOTO
+#endif  // __GNUC__
 
-void startup(char *path)
+typedef enum cpu_status_code (*instruction_handler)(
+    struct chip8_vm *vm,
+    struct decoded_instruction *decoded);
+
+static const instruction_handler handlers[OPCODE_COUNT];
+
+// The opcodes of FX55 and FX65, by how far they advance the index register.
+static const uint8_t STORE_OPCODES[] = {
+    [INDEX_KEPT] = OP_LD_MEM_V,
+    [INDEX_PLUS_X] = OP_LD_MEM_V_INC_X,
+    [INDEX_PLUS_X_1] = OP_LD_MEM_V_INC,
+};
+static const uint8_t LOAD_OPCODES[] = {
+    [INDEX_KEPT] = OP_LD_V_MEM,
+    [INDEX_PLUS_X] = OP_LD_V_MEM_INC_X,
+    [INDEX_PLUS_X_1] = OP_LD_V_MEM_INC,
+};
+
+void init_cpu(struct chip8_vm *vm)
+{
+    set_memory_write_hook(vm, invalidate_instructions);
+}
+
+bool startup(struct chip8_vm *vm, char *path)
 {
     // Read the program from a file into memory.
     FILE *f;
     f = fopen(path, "rb");
-    uint8_t program[0xFFF - 0x200];
-    fread(program, 1, 0xFFF - 0x200, f);
+    if (f == NULL) {
+        return false;
+    }
+    uint8_t program[MEMORY_SIZE - PROGRAM_START];
+    size_t size = fread(program, 1, MEMORY_SIZE - PROGRAM_START, f);
     fclose(f);
 
+    startup_rom(vm, program, size);
+    return true;
+}
+
+void startup_rom(struct chip8_vm *vm, const uint8_t *rom, uint16_t size)
+{
+    // Anything past the program space is cut off.
+    if (size > MEMORY_SIZE - PROGRAM_START) {
+        size = MEMORY_SIZE - PROGRAM_START;
+    }
+
     // Reset the CPU state.
-    PC = 0x200;
-    I = 0x000;
+    vm->PC = PROGRAM_START;
+    vm->I = 0x000;
     for (uint8_t i = 0; i < 16; i++) {
-        V[i] = 0x00;
+        vm->V[i] = 0x00;
     }
+    vm->delay_timer = 0;
+    vm->sound_timer = 0;
+    vm->keypad.released = 0;
 
-    // Initialize the sub-modules of the system.
-    init_stack(&s);
-    init_memory();
-    load_program(program);
-    clear_display();
+    // Initialize the sub-modules of the system. Only what the last program
+    // wrote to is reset, so restarting a machine costs little more than the
+    // size of the ROM.
+    init_cpu(vm);
+    init_stack(&vm->stack);
+    reset_memory(vm);
+    load_program(vm, rom, size);
+    select_planes(vm, 0x1);
+    reset_display(vm);
+    reset_audio(vm);
+    reset_scheduler(vm);
+    reset_rng(vm);
 }
 
-struct cpu_status run_cycle()
+void set_quirks(struct chip8_vm *vm, struct quirks quirks)
 {
-    uint16_t instruction = read_instruction();
-    struct cpu_status status = {.code = SUCCESS, .instruction = instruction};
-    run_instruction(instruction, &status);
+    vm->quirks = quirks;
+    invalidate_instructions(vm, 0x000, MEMORY_SIZE);
+}
+
+void set_cpu_core(struct chip8_vm *vm, enum cpu_core core)
+{
+    vm->core = core;
+}
+
+struct cpu_status run_cycle(struct chip8_vm *vm)
+{
+#ifdef HAS_COMPUTED_GOTO
+    if (vm->core == CORE_THREADED) {
+        struct cpu_status status;
+        run_threaded(vm, 1, NULL, &status);
+        return status;
+    }
+#endif  // HAS_COMPUTED_GOTO
+
+    return run_table_cycle(vm);
+}
+
+uint64_t run_cycles(
+    struct chip8_vm *vm,
+    uint64_t count,
+    struct cpu_status *status)
+{
+#ifdef HAS_COMPUTED_GOTO
+    if (vm->core == CORE_THREADED) {
+        return run_threaded(vm, count, NULL, status);
+    }
+#endif  // HAS_COMPUTED_GOTO
+#ifdef HAS_DYNAREC
+    if (vm->core == CORE_DYNAREC) {
+        return run_dynarec_core(vm, count, status);
+    }
+#endif  // HAS_DYNAREC
+
+    status->code = SUCCESS;
+    status->instruction = 0x0000;
+
+    uint64_t executed = 0;
+    while (executed < count) {
+        *status = run_table_cycle(vm);
+        executed++;
+        if (status->code) {
+            break;
+        }
+    }
+
+    return executed;
+}
+
+uint64_t skip_idle_loop(struct chip8_vm *vm, uint64_t count)
+{
+    uint16_t pc = vm->PC;
+    if (pc > MEMORY_SIZE - 2) {
+        return 0;
+    }
+
+    // A wait for a key ends with the next sample of the keypad at the
+    // earliest.
+    if (is_waiting_for_key(vm)) {
+        PROFILE_IDLE(vm, count);
+        return count;
+    }
+
+    // A jump to itself spins forever. Jumps only reach the lowest 4 KB, so
+    // above them, a jump with the same low bits as its address leads away.
+    uint16_t instruction = (vm->memory[pc] << 8) | vm->memory[pc + 1];
+    if (pc <= MA && instruction == (0x1000 | pc)) {
+        PROFILE_IDLE(vm, count);
+        return count;
+    }
+
+    // A timer poll can be entered at any of its instructions, but when entered
+    // at its skip, the register still holds a value polled before the last
+    // tick, so it has to match the timer or the skip could leave the loop.
+    uint8_t x;
+    uint16_t head = pc;
+    for (uint8_t offset = 0; offset < 3; offset++, head -= 2) {
+        if (head > pc || !is_timer_poll(vm, head, &x)) {
+            continue;
+        }
+        if (offset == 1 && vm->V[x] != vm->delay_timer) {
+            return 0;
+        }
+
+        // Whole iterations keep the program counter where it is, and leave
+        // the register with the value of the timer.
+        uint64_t skipped = count / 3 * 3;
+        if (skipped) {
+            vm->V[x] = vm->delay_timer;
+            PROFILE_IDLE(vm, skipped);
+        }
+        return skipped;
+    }
+
+    return 0;
+}
+
+static bool is_timer_poll(struct chip8_vm *vm, uint16_t head, uint8_t *x)
+{
+    // The jump back has to reach the head, which only works within the lowest
+    // 4 KB, and those always hold the whole loop.
+    if (head > MA) {
+        return false;
+    }
+
+    uint8_t *m = &vm->memory[head];
+    uint16_t poll = (m[0] << 8) | m[1];
+    uint16_t skip = (m[2] << 8) | m[3];
+    uint16_t jump = (m[4] << 8) | m[5];
+
+    *x = (poll & N2) >> 8;
+    if ((poll & 0xF0FF) != 0xF007 || ((skip & N2) >> 8) != *x ||
+        jump != (0x1000 | head)) {
+        return false;
+    }
+
+    // The loop only spins as long as the skip out of it is not taken.
+    uint8_t nn = skip & B2;
+    switch (skip & N1) {
+        case 0x3000:
+            return vm->delay_timer != nn;
+        case 0x4000:
+            return vm->delay_timer == nn;
+        default:
+            return false;
+    }
+}
+
+static struct cpu_status run_table_cycle(struct chip8_vm *vm)
+{
+    // An instruction has to fit within memory, as it spans two addresses.
+    if (vm->PC > MEMORY_SIZE - 2) {
+        struct cpu_status status = {
+            .code = INVALID_MEMORY_ACCESS,
+            .instruction = 0x0000,
+        };
+        PROFILE_STATUS(vm, status.code);
+        return status;
+    }
+
+    // Undecoded instructions are handled by op_decode(), which decodes them
+    // before running them, so the common case is a single indirect call.
+    PROFILE_FETCH(vm, vm->PC);
+    struct decoded_instruction *decoded = find_decoded(vm, vm->PC);
+    vm->PC += 2;
+
+    // Run the handler first, as undecoded instructions only know their raw
+    // instruction once op_decode() has filled it in.
+    struct cpu_status status;
+    status.code = handlers[decoded->op](vm, decoded);
+    status.instruction = decoded->instruction;
+    PROFILE_EXECUTE(vm, decoded->op);
+    PROFILE_STATUS(vm, status.code);
     return status;
 }
 
-static void run_instruction(uint16_t instruction, struct cpu_status *status)
+static void run_instruction(
+    struct chip8_vm *vm,
+    uint16_t instruction,
+    struct cpu_status *status)
+{
+    struct decoded_instruction decoded;
+    decode_instruction(instruction, &vm->quirks, &decoded);
+
+#ifdef HAS_COMPUTED_GOTO
+    if (vm->core == CORE_THREADED) {
+        run_threaded(vm, 1, &decoded, status);
+        return;
+    }
+#endif  // HAS_COMPUTED_GOTO
+
+    status->code = handlers[decoded.op](vm, &decoded);
+}
+
+static void decode_instruction(
+    uint16_t instruction,
+    const struct quirks *quirks,
+    struct decoded_instruction *decoded)
 {
-    // TODO: Implement the missing instructions.
+    decoded->instruction = instruction;
+    decoded->nnn = instruction & MA;
+    decoded->x = (instruction & N2) >> 8;
+    decoded->y = (instruction & N3) >> 4;
+    decoded->n = instruction & N4;
+    decoded->nn = instruction & B2;
+
     switch (instruction & N1) {
         case 0x0000:  // System
             switch (instruction & MA) {
                 case 0x00E0:  // Clear display
-                    clear_display();
+                    decoded->op = OP_CLS;
                     break;
                 case 0x00EE:  // Return from subroutine
-                    pop(&s, &PC);
+                    decoded->op = OP_RET;
+                    break;
+                case 0x00FB:  // Scroll right
+                    decoded->op = OP_SCR;
+                    break;
+                case 0x00FC:  // Scroll left
+                    decoded->op = OP_SCL;
+                    break;
+                case 0x00FE:  // Low resolution
+                    decoded->op = OP_LOW;
                     break;
-                default:  // Call machine code routine
-                    status->code = INVALID_INSTRUCTION;
-                    status->instruction = instruction;
+                case 0x00FF:  // High resolution
+                    decoded->op = OP_HIGH;
+                    break;
+                default:
+                    if ((instruction & 0x0FF0) == 0x00C0) {  // Scroll down
+                        decoded->op = OP_SCD;
+                    } else if ((instruction & 0x0FF0) == 0x00D0) {
+                        decoded->op = OP_SCU;  // Scroll up
+                    } else {  // Call machine code routine
+                        decoded->op = OP_INVALID;
+                    }
             }
             break;
         case 0x1000:  // Jump
-            PC = instruction & MA;
+            decoded->op = OP_JP;
             break;
         case 0xB000:  // Jump with offset
-            PC = (instruction & MA) + V[0x0];
-            // TODO: Add configurable option to use offset of specific register.
+            decoded->op = quirks->jump_vx ? OP_JP_VX : OP_JP_V0;
             break;
         case 0x2000:  // Call subroutine
-            push(&s, PC);
-            PC = instruction & MA;
+            decoded->op = OP_CALL;
+            break;
         case 0x3000:  // Skip if variable equal to constant
-            if (V[(instruction & N2) >> 8] == (instruction & B2)) {
-                PC += 2;
-            }
+            decoded->op = OP_SE_VX_NN;
             break;
         case 0x4000:  // Skip if variable not equal to constant
-            if (V[(instruction & N2) >> 8] != (instruction & B2)) {
-                PC += 2;
-            }
+            decoded->op = OP_SNE_VX_NN;
             break;
-        case 0x5000:  // Skip if variable equal to variable
-            if (V[(instruction & N2) >> 8] == V[(instruction & N3) >> 4]) {
-                PC += 2;
+        case 0x5000:
+            switch (instruction & N4) {
+                case 0x000:  // Skip if variable equal to variable
+                    decoded->op = OP_SE_VX_VY;
+                    break;
+                case 0x002:  // Store range of variables
+                    decoded->op = OP_LD_MEM_RANGE;
+                    break;
+                case 0x003:  // Load range of variables
+                    decoded->op = OP_LD_RANGE_MEM;
+                    break;
+                default:
+                    decoded->op = OP_INVALID;
             }
             break;
         case 0x9000:  // Skip if variable not equal to variable
-            if (V[(instruction & N2) >> 8] != V[(instruction & N3) >> 4]) {
-                PC += 2;
-            }
+            decoded->op = OP_SNE_VX_VY;
             break;
         case 0x6000:  // Set variable register
-            V[(instruction & N2) >> 8] = instruction & B2;
+            decoded->op = OP_LD_VX_NN;
             break;
         case 0x7000:  // Add to variable register
-            V[(instruction & N2) >> 8] += instruction & B2;
+            decoded->op = OP_ADD_VX_NN;
             break;
         case 0x8000:  // Logic and arithmetic
-        {
-            uint8_t *VX = &V[(instruction & N2) >> 8];
-            uint8_t *VY = &V[(instruction & N3) >> 4];
             switch (instruction & N4) {
                 case 0x000:  // Set
-                    V[(instruction & N2) >> 8] = V[(instruction & N3) >> 4];
+                    decoded->op = OP_LD_VX_VY;
                     break;
                 case 0x004:  // Add
-                    *VX = *VX + *VY;
-                    V[0xF] = *VX <= *VY;
+                    decoded->op = OP_ADD_VX_VY;
                     break;
                 case 0x005:  // Subtract Y from X
-                    V[0xF] = *VY > *VX;
-                    *VX = *VY - *VX;
+                    decoded->op = OP_SUB_VY_VX;
                     break;
                 case 0x007:  // Subtract X from Y
-                    V[0xF] = *VX > *VY;
-                    *VX = *VX - *VY;
+                    decoded->op = OP_SUB_VX_VY;
                     break;
                 case 0x00E:  // Shift left
-                    V[0xF] = (*VX & 0x80) >> 7;
-                    *VX = *VX << 1;
-                    // TODO: Add configurable option to move VY into VX.
+                    decoded->op = quirks->shift_vy ? OP_SHL_VY : OP_SHL;
                     break;
                 case 0x006:  // Shift right
-                    V[0xF] = *VX & 0x01;
-                    *VX = *VX >> 1;
-                    // TODO: Add configurable option to move VY into VX.
+                    decoded->op = quirks->shift_vy ? OP_SHR_VY : OP_SHR;
                     break;
                 case 0x002:  // AND
-                    *VX = *VX & *VY;
+                    decoded->op = quirks->vf_reset ? OP_AND_VF_RESET : OP_AND;
                     break;
                 case 0x001:  // OR
-                    *VX = *VX | *VY;
+                    decoded->op = quirks->vf_reset ? OP_OR_VF_RESET : OP_OR;
                     break;
                 case 0x003:  // XOR
-                    *VX = *VX ^ *VY;
+                    decoded->op = quirks->vf_reset ? OP_XOR_VF_RESET : OP_XOR;
                     break;
                 default:
-                    status->code = INVALID_INSTRUCTION;
-                    status->instruction = instruction;
+                    decoded->op = OP_INVALID;
             }
-        }
+            break;
         case 0xA000:  // Set index register
-            I = instruction & MA;
+            decoded->op = OP_LD_I;
             break;
         case 0xD000:  // Draw
-            V[0xF] = draw_sprite(
-                V[(instruction & N2) >> 8],
-                V[(instruction & N3) >> 4],
-                instruction & N4,
-                get_memory_pointer(I));
+            if (decoded->n == 0) {  // Draw 16x16
+                decoded->op = quirks->wrap ? OP_DRW_LARGE_WRAP : OP_DRW_LARGE;
+            } else {
+                decoded->op = quirks->wrap ? OP_DRW_WRAP : OP_DRW;
+            }
             break;
         case 0xC000:  // Random
-            V[(instruction & N2) >> 8] = (uint8_t)rand() & (instruction & B2);
+            decoded->op = OP_RND;
+            break;
+        case 0xE000:  // Keypad
+            switch (instruction & B2) {
+                case 0x009E:  // Skip if key down
+                    decoded->op = OP_SKP;
+                    break;
+                case 0x00A1:  // Skip if key up
+                    decoded->op = OP_SKNP;
+                    break;
+                default:
+                    decoded->op = OP_INVALID;
+            }
             break;
         case 0xF000:  // Misc.
             switch (instruction & B2) {
+                case 0x0000:  // Set index register to long address
+                    decoded->op = decoded->x == 0 ? OP_LD_I_LONG : OP_INVALID;
+                    break;
+                case 0x0001:  // Select planes
+                    decoded->op = OP_PLANE;
+                    break;
+                case 0x0002:  // Load audio pattern
+                    decoded->op = decoded->x == 0 ? OP_AUDIO : OP_INVALID;
+                    break;
+                case 0x0007:  // Read delay timer
+                    decoded->op = OP_LD_VX_DT;
+                    break;
+                case 0x000A:  // Wait for key
+                    decoded->op = OP_LD_VX_K;
+                    break;
+                case 0x0015:  // Set delay timer
+                    decoded->op = OP_LD_DT_VX;
+                    break;
+                case 0x0018:  // Set sound timer
+                    decoded->op = OP_LD_ST_VX;
+                    break;
                 case 0x001E:  // Add to index register
-                    I += V[(instruction & N2) >> 8];
-                    // Manually handle overflow, as the variable is a uint16,
-                    // but the memory space of the system is 12 bits long.
-                    if (I > 0xFFF) {
-                        I = I % 0xFFF - 1;
-                        V[0xF] = 1;
-                    }
+                    decoded->op = OP_ADD_I;
                     break;
                 case 0x0029:  // Set index register to character
-                {
-                    uint8_t character = V[(instruction & N2) >> 8] & 0x0F;
-                    I = FONT_START + character * 5;
-                } break;
+                    decoded->op = OP_LD_F;
+                    break;
+                case 0x0030:  // Set index register to large character
+                    decoded->op = OP_LD_HF;
+                    break;
                 case 0x0033:  // Convert to decimal
-                {
-                    uint8_t *memory = get_memory_pointer(I);
-                    uint8_t num = V[(instruction & N2) >> 8];
-                    // Extract the digits least significant to most.
-                    uint8_t digits[3];
-                    uint8_t i = 0;
-                    do {
-                        digits[i++] = num % 10;
-                        num /= 10;
-                    } while (num != 0);
-                    // Insert the digits most significant to least.
-                    uint8_t j = 0;
-                    do {
-                        memory[j++] = digits[--i];
-                    } while (i != 0);
-                } break;
+                    decoded->op = OP_LD_B;
+                    break;
+                case 0x003A:  // Set pitch
+                    decoded->op = OP_PITCH;
+                    break;
                 case 0x0055:  // Store memory
-                {
-                    uint8_t *memory = get_memory_pointer(I);
-                    for (uint8_t i = 0; i <= (instruction & N2) >> 8; i++) {
-                        memory[i] = V[i];
-                        // TODO: Add configurable option to increment I.
-                    }
+                    decoded->op = STORE_OPCODES[quirks->index];
                     break;
-                }
                 case 0x0065:  // Load memory
-                {
-                    uint8_t *memory = get_memory_pointer(I);
-                    for (uint8_t i = 0; i <= (instruction & N2) >> 8; i++) {
-                        V[i] = memory[i];
-                        // TODO: Add configurable option to increment I.
-                    }
+                    decoded->op = LOAD_OPCODES[quirks->index];
+                    break;
+                case 0x0075:  // Save flag registers
+                    decoded->op = OP_LD_R_VX;
+                    break;
+                case 0x0085:  // Load flag registers
+                    decoded->op = OP_LD_VX_R;
                     break;
-                }
                 default:
-                    status->code = INVALID_INSTRUCTION;
-                    status->instruction = instruction;
+                    decoded->op = OP_INVALID;
             }
             break;
         default:
-            status->code = UNKNOWN_INSTRUCTION;
-            status->instruction = instruction;
+            decoded->op = OP_UNKNOWN;
     }
 }
 
-static uint16_t read_instruction()
+static void invalidate_instructions(
+    struct chip8_vm *vm,
+    uint16_t address,
+    uint32_t length)
 {
-    uint16_t instruction = (read_memory(PC) << 8) | read_memory(PC + 1);
-    PC += 2;
+    // The instruction starting just before the range also reads from it.
+    uint16_t first = address > 0 ? address - 1 : 0;
+    uint32_t last = (uint32_t)address + length;
+    if (last > MEMORY_SIZE) {
+        last = MEMORY_SIZE;
+    }
+
+    for (uint32_t i = first; i < last; i++) {
+        // Pages nothing executed from yet hold nothing to invalidate.
+        struct decoded_instruction *page =
+            vm->decoded_pages[i / MEMORY_PAGE_SIZE];
+        if (page == NULL) {
+            i |= MEMORY_PAGE_SIZE - 1;
+            continue;
+        }
+        page[i % MEMORY_PAGE_SIZE].op = OP_UNDECODED;
+        page[i % MEMORY_PAGE_SIZE].interpreted = false;
+    }
+
+#ifdef HAS_DYNAREC
+    invalidate_dynarec(vm, address, length);
+#endif  // HAS_DYNAREC
+}
+
+static struct decoded_instruction *find_decoded(
+    struct chip8_vm *vm,
+    uint16_t address)
+{
+    struct decoded_instruction *page =
+        vm->decoded_pages[address / MEMORY_PAGE_SIZE];
+    if (page == NULL) {
+        page = allocate_decoded_page(vm, address);
+        if (page == NULL) {
+            vm->uncached.op = OP_UNDECODED;
+            vm->uncached.interpreted = false;
+            return &vm->uncached;
+        }
+    }
+    return &page[address % MEMORY_PAGE_SIZE];
+}
+
+static struct decoded_instruction *allocate_decoded_page(
+    struct chip8_vm *vm,
+    uint16_t address)
+{
+    // Undecoded entries are all zeroes, as OP_UNDECODED is the first opcode.
+    struct decoded_instruction *page =
+        calloc(MEMORY_PAGE_SIZE, sizeof(struct decoded_instruction));
+    vm->decoded_pages[address / MEMORY_PAGE_SIZE] = page;
+    return page;
+}
+
+void free_decoded_pages(struct chip8_vm *vm)
+{
+    for (uint8_t i = 0; i < MEMORY_PAGES; i++) {
+        free(vm->decoded_pages[i]);
+        vm->decoded_pages[i] = NULL;
+    }
+}
+
+static uint16_t read_instruction(struct chip8_vm *vm)
+{
+    uint16_t instruction =
+        (read_memory(vm, vm->PC) << 8) | read_memory(vm, vm->PC + 1);
+    vm->PC += 2;
     return instruction;
 }
 
+static void skip_instruction(struct chip8_vm *vm)
+{
+    // F000 NNNN is the only instruction spanning four bytes.
+    uint16_t pc = vm->PC;
+    bool is_long = pc <= MEMORY_SIZE - 2 && vm->memory[pc] == 0xF0 &&
+                   vm->memory[pc + 1] == 0x00;
+    vm->PC += is_long ? 4 : 2;
+}
+
+// MARK: Instruction handlers
+
+// Decodes an instruction of the cache on its first execution, then runs it.
+static enum cpu_status_code op_decode(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    // Only the table core runs this, after moving past the instruction.
+    uint16_t address = vm->PC - 2;
+    decode_instruction(
+        (read_memory(vm, address) << 8) | read_memory(vm, address + 1),
+        &vm->quirks,
+        d);
+    return handlers[d->op](vm, d);
+}
+
+static enum cpu_status_code op_unknown(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    return UNKNOWN_INSTRUCTION;
+}
+
+static enum cpu_status_code op_invalid(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    return INVALID_INSTRUCTION;
+}
+
+// 0x00E0 - Clear display
+static enum cpu_status_code op_cls(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    clear_display(vm);
+    return SUCCESS;
+}
+
+// 0x00EE - Return from subroutine
+static enum cpu_status_code op_ret(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    if (!pop(&vm->stack, &vm->PC)) {
+        return INVALID_STACK_OPERATION;
+    }
+    return SUCCESS;
+}
+
+// 0x00CN - Scroll down
+static enum cpu_status_code op_scd(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    scroll_down(vm, d->n);
+    return SUCCESS;
+}
+
+// 0x00DN - Scroll up
+static enum cpu_status_code op_scu(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    scroll_up(vm, d->n);
+    return SUCCESS;
+}
+
+// 0x00FB - Scroll right
+static enum cpu_status_code op_scr(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    scroll_right(vm, 4);
+    return SUCCESS;
+}
+
+// 0x00FC - Scroll left
+static enum cpu_status_code op_scl(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    scroll_left(vm, 4);
+    return SUCCESS;
+}
+
+// 0x00FE - Low resolution
+static enum cpu_status_code op_low(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    set_resolution(vm, false);
+    return SUCCESS;
+}
+
+// 0x00FF - High resolution
+static enum cpu_status_code op_high(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    set_resolution(vm, true);
+    return SUCCESS;
+}
+
+// 0x1NNN - Jump
+static enum cpu_status_code op_jp(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->PC = d->nnn;
+    return SUCCESS;
+}
+
+// 0xBNNN - Jump with offset
+static enum cpu_status_code op_jp_v0(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->PC = d->nnn + vm->V[0x0];
+    return SUCCESS;
+}
+
+// 0xBXNN - Jump with offset of VX, as on the CHIP-48
+static enum cpu_status_code op_jp_vx(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->PC = d->nnn + vm->V[d->x];
+    return SUCCESS;
+}
+
+// 0x2NNN - Call subroutine
+static enum cpu_status_code op_call(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    if (!push(&vm->stack, vm->PC)) {
+        return INVALID_STACK_OPERATION;
+    }
+    vm->PC = d->nnn;
+    return SUCCESS;
+}
+
+// 0x3XNN - Skip if variable equal to constant
+static enum cpu_status_code op_se_vx_nn(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    if (vm->V[d->x] == d->nn) {
+        skip_instruction(vm);
+    }
+    return SUCCESS;
+}
+
+// 0x4XNN - Skip if variable not equal to constant
+static enum cpu_status_code op_sne_vx_nn(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    if (vm->V[d->x] != d->nn) {
+        skip_instruction(vm);
+    }
+    return SUCCESS;
+}
+
+// 0x5XY0 - Skip if variable equal to variable
+static enum cpu_status_code op_se_vx_vy(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    if (vm->V[d->x] == vm->V[d->y]) {
+        skip_instruction(vm);
+    }
+    return SUCCESS;
+}
+
+// 0x5XY2 - Store range of variables
+static enum cpu_status_code op_ld_mem_range(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    uint8_t count = d->x <= d->y ? d->y - d->x + 1 : d->x - d->y + 1;
+    if (vm->I + count > MEMORY_SIZE) {
+        return INVALID_MEMORY_ACCESS;
+    }
+
+    // Ranges are stored from VX to VY, so backwards ones are reversed.
+    uint8_t *memory = get_memory_pointer(vm, vm->I);
+    if (d->x <= d->y) {
+        memcpy(memory, &vm->V[d->x], count);
+    } else {
+        for (uint8_t i = 0; i < count; i++) {
+            memory[i] = vm->V[d->x - i];
+        }
+    }
+    mark_memory_written(vm, vm->I, count);
+    return SUCCESS;
+}
+
+// 0x5XY3 - Load range of variables
+static enum cpu_status_code op_ld_range_mem(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    uint8_t count = d->x <= d->y ? d->y - d->x + 1 : d->x - d->y + 1;
+    if (vm->I + count > MEMORY_SIZE) {
+        return INVALID_MEMORY_ACCESS;
+    }
+
+    uint8_t *memory = get_memory_pointer(vm, vm->I);
+    if (d->x <= d->y) {
+        memcpy(&vm->V[d->x], memory, count);
+    } else {
+        for (uint8_t i = 0; i < count; i++) {
+            vm->V[d->x - i] = memory[i];
+        }
+    }
+    return SUCCESS;
+}
+
+// 0x9XY0 - Skip if variable not equal to variable
+static enum cpu_status_code op_sne_vx_vy(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    if (vm->V[d->x] != vm->V[d->y]) {
+        skip_instruction(vm);
+    }
+    return SUCCESS;
+}
+
+// 0x6XNN - Set variable register
+static enum cpu_status_code op_ld_vx_nn(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[d->x] = d->nn;
+    return SUCCESS;
+}
+
+// 0x7XNN - Add to variable register
+static enum cpu_status_code op_add_vx_nn(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[d->x] += d->nn;
+    return SUCCESS;
+}
+
+// 0x8XY0 - Set
+static enum cpu_status_code op_ld_vx_vy(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[d->x] = vm->V[d->y];
+    return SUCCESS;
+}
+
+// 0x8XY1 - OR
+static enum cpu_status_code op_or(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[d->x] |= vm->V[d->y];
+    return SUCCESS;
+}
+
+// 0x8XY1 - OR, resetting VF as on the COSMAC VIP
+static enum cpu_status_code op_or_vf_reset(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    op_or(vm, d);
+    vm->V[0xF] = 0;
+    return SUCCESS;
+}
+
+// 0x8XY2 - AND
+static enum cpu_status_code op_and(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[d->x] &= vm->V[d->y];
+    return SUCCESS;
+}
+
+// 0x8XY2 - AND, resetting VF as on the COSMAC VIP
+static enum cpu_status_code op_and_vf_reset(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    op_and(vm, d);
+    vm->V[0xF] = 0;
+    return SUCCESS;
+}
+
+// 0x8XY3 - XOR
+static enum cpu_status_code op_xor(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[d->x] ^= vm->V[d->y];
+    return SUCCESS;
+}
+
+// 0x8XY3 - XOR, resetting VF as on the COSMAC VIP
+static enum cpu_status_code op_xor_vf_reset(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    op_xor(vm, d);
+    vm->V[0xF] = 0;
+    return SUCCESS;
+}
+
+// 0x8XY4 - Add
+static enum cpu_status_code op_add_vx_vy(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[d->x] = vm->V[d->x] + vm->V[d->y];
+    vm->V[0xF] = vm->V[d->x] <= vm->V[d->y];
+    return SUCCESS;
+}
+
+// 0x8XY5 - Subtract Y from X
+static enum cpu_status_code op_sub_vy_vx(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[0xF] = vm->V[d->y] > vm->V[d->x];
+    vm->V[d->x] = vm->V[d->y] - vm->V[d->x];
+    return SUCCESS;
+}
+
+// 0x8XY6 - Shift right
+static enum cpu_status_code op_shr(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[0xF] = vm->V[d->x] & 0x01;
+    vm->V[d->x] = vm->V[d->x] >> 1;
+    return SUCCESS;
+}
+
+// 0x8XY6 - Shift right, moving VY into VX first as on the COSMAC VIP
+static enum cpu_status_code op_shr_vy(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[d->x] = vm->V[d->y];
+    return op_shr(vm, d);
+}
+
+// 0x8XY7 - Subtract X from Y
+static enum cpu_status_code op_sub_vx_vy(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[0xF] = vm->V[d->x] > vm->V[d->y];
+    vm->V[d->x] = vm->V[d->x] - vm->V[d->y];
+    return SUCCESS;
+}
+
+// 0x8XYE - Shift left
+static enum cpu_status_code op_shl(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[0xF] = (vm->V[d->x] & 0x80) >> 7;
+    vm->V[d->x] = vm->V[d->x] << 1;
+    return SUCCESS;
+}
+
+// 0x8XYE - Shift left, moving VY into VX first as on the COSMAC VIP
+static enum cpu_status_code op_shl_vy(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[d->x] = vm->V[d->y];
+    return op_shl(vm, d);
+}
+
+// 0xANNN - Set index register
+static enum cpu_status_code op_ld_i(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->I = d->nnn;
+    return SUCCESS;
+}
+
+// 0xF000 NNNN - Set index register to long address
+static enum cpu_status_code op_ld_i_long(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    // The address is the whole instruction following this one.
+    if (vm->PC > MEMORY_SIZE - 2) {
+        return INVALID_MEMORY_ACCESS;
+    }
+    vm->I = (read_memory(vm, vm->PC) << 8) | read_memory(vm, vm->PC + 1);
+    vm->PC += 2;
+    return SUCCESS;
+}
+
+// 0xCXNN - Random
+static enum cpu_status_code op_rnd(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[d->x] = (uint8_t)next_random(vm) & d->nn;
+    return SUCCESS;
+}
+
+// 0xDXYN - Draw
+static enum cpu_status_code op_drw(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    if (vm->I + get_sprite_size(vm, d->n, false) > MEMORY_SIZE) {
+        return INVALID_MEMORY_ACCESS;
+    }
+    vm->V[0xF] = draw_sprite(
+        vm,
+        vm->V[d->x],
+        vm->V[d->y],
+        d->n,
+        get_memory_pointer(vm, vm->I));
+    return SUCCESS;
+}
+
+// 0xDXYN - Draw, wrapping around the screen edges
+static enum cpu_status_code op_drw_wrap(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    if (vm->I + get_sprite_size(vm, d->n, false) > MEMORY_SIZE) {
+        return INVALID_MEMORY_ACCESS;
+    }
+    vm->V[0xF] = draw_wrapped_sprite(
+        vm,
+        vm->V[d->x],
+        vm->V[d->y],
+        d->n,
+        get_memory_pointer(vm, vm->I));
+    return SUCCESS;
+}
+
+// 0xDXY0 - Draw 16x16
+static enum cpu_status_code op_drw_large(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    if (vm->I + get_sprite_size(vm, 16, true) > MEMORY_SIZE) {
+        return INVALID_MEMORY_ACCESS;
+    }
+    vm->V[0xF] = draw_large_sprite(
+        vm,
+        vm->V[d->x],
+        vm->V[d->y],
+        get_memory_pointer(vm, vm->I));
+    return SUCCESS;
+}
+
+// 0xDXY0 - Draw 16x16, wrapping around the screen edges
+static enum cpu_status_code op_drw_large_wrap(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    if (vm->I + get_sprite_size(vm, 16, true) > MEMORY_SIZE) {
+        return INVALID_MEMORY_ACCESS;
+    }
+    vm->V[0xF] = draw_wrapped_large_sprite(
+        vm,
+        vm->V[d->x],
+        vm->V[d->y],
+        get_memory_pointer(vm, vm->I));
+    return SUCCESS;
+}
+
+// 0xEX9E - Skip if key down
+static enum cpu_status_code op_skp(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    if (is_key_down(vm, vm->V[d->x])) {
+        skip_instruction(vm);
+    }
+    return SUCCESS;
+}
+
+// 0xEXA1 - Skip if key up
+static enum cpu_status_code op_sknp(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    if (!is_key_down(vm, vm->V[d->x])) {
+        skip_instruction(vm);
+    }
+    return SUCCESS;
+}
+
+// 0xFN01 - Select planes
+static enum cpu_status_code op_plane(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    select_planes(vm, d->x);
+    return SUCCESS;
+}
+
+// 0xF002 - Load audio pattern
+static enum cpu_status_code op_audio(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    if (vm->I + AUDIO_PATTERN_SIZE > MEMORY_SIZE) {
+        return INVALID_MEMORY_ACCESS;
+    }
+    set_audio_pattern(vm, get_memory_pointer(vm, vm->I));
+    return SUCCESS;
+}
+
+// 0xFX07 - Read delay timer
+static enum cpu_status_code op_ld_vx_dt(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->V[d->x] = vm->delay_timer;
+    return SUCCESS;
+}
+
+// 0xFX0A - Wait for key
+static enum cpu_status_code op_ld_vx_k(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    // Waits for a key to be released, as on the COSMAC VIP, so a key held
+    // down across two waits is only taken once.
+    uint8_t key;
+    if (take_released_key(vm, &key)) {
+        vm->V[d->x] = key;
+        return SUCCESS;
+    }
+
+    // Stay on the instruction, so it runs again once the CPU is woken up, and
+    // save states taken in between resume the wait.
+    vm->PC -= 2;
+    return WAITING_FOR_KEY;
+}
+
+// 0xFX15 - Set delay timer
+static enum cpu_status_code op_ld_dt_vx(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->delay_timer = vm->V[d->x];
+    return SUCCESS;
+}
+
+// 0xFX18 - Set sound timer
+static enum cpu_status_code op_ld_st_vx(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    vm->sound_timer = vm->V[d->x];
+    return SUCCESS;
+}
+
+// 0xFX1E - Add to index register
+static enum cpu_status_code op_add_i(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    // The index register spans the whole 16-bit memory space, so it simply
+    // wraps around its end.
+    vm->I += vm->V[d->x];
+    return SUCCESS;
+}
+
+// 0xFX29 - Set index register to character
+static enum cpu_status_code op_ld_f(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    uint8_t character = vm->V[d->x] & 0x0F;
+    vm->I = FONT_START + character * 5;
+    return SUCCESS;
+}
+
+// 0xFX30 - Set index register to large character
+static enum cpu_status_code op_ld_hf(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    uint8_t character = vm->V[d->x] & 0x0F;
+    vm->I = LARGE_FONT_START + character * 10;
+    return SUCCESS;
+}
+
+// 0xFX33 - Convert to decimal
+static enum cpu_status_code op_ld_b(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    uint8_t num = vm->V[d->x];
+    // Extract the digits least significant to most.
+    uint8_t digits[3];
+    uint8_t i = 0;
+    do {
+        digits[i++] = num % 10;
+        num /= 10;
+    } while (num != 0);
+    if (vm->I + i > MEMORY_SIZE) {
+        return INVALID_MEMORY_ACCESS;
+    }
+    // Insert the digits most significant to least.
+    uint8_t *memory = get_memory_pointer(vm, vm->I);
+    uint8_t j = 0;
+    do {
+        memory[j++] = digits[--i];
+    } while (i != 0);
+    mark_memory_written(vm, vm->I, j);
+    return SUCCESS;
+}
+
+// 0xFX3A - Set pitch
+static enum cpu_status_code op_pitch(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    set_pitch(vm, vm->V[d->x]);
+    return SUCCESS;
+}
+
+// 0xFX55 - Store memory
+static enum cpu_status_code op_ld_mem_v(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    uint8_t count = d->x + 1;
+    if (vm->I + count > MEMORY_SIZE) {
+        return INVALID_MEMORY_ACCESS;
+    }
+    uint8_t *memory = get_memory_pointer(vm, vm->I);
+    for (uint8_t i = 0; i < count; i++) {
+        memory[i] = vm->V[i];
+    }
+    mark_memory_written(vm, vm->I, count);
+    return SUCCESS;
+}
+
+// 0xFX55 - Store memory, leaving I on the last register as on the CHIP-48
+static enum cpu_status_code op_ld_mem_v_inc_x(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    enum cpu_status_code code = op_ld_mem_v(vm, d);
+    if (code == SUCCESS) {
+        vm->I += d->x;
+    }
+    return code;
+}
+
+// 0xFX55 - Store memory, leaving I past the last register as on the COSMAC VIP
+static enum cpu_status_code op_ld_mem_v_inc(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    enum cpu_status_code code = op_ld_mem_v(vm, d);
+    if (code == SUCCESS) {
+        vm->I += d->x + 1;
+    }
+    return code;
+}
+
+// 0xFX65 - Load memory
+static enum cpu_status_code op_ld_v_mem(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    if (vm->I + d->x + 1 > MEMORY_SIZE) {
+        return INVALID_MEMORY_ACCESS;
+    }
+    uint8_t *memory = get_memory_pointer(vm, vm->I);
+    for (uint8_t i = 0; i <= d->x; i++) {
+        vm->V[i] = memory[i];
+    }
+    return SUCCESS;
+}
+
+// 0xFX65 - Load memory, leaving I on the last register as on the CHIP-48
+static enum cpu_status_code op_ld_v_mem_inc_x(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    enum cpu_status_code code = op_ld_v_mem(vm, d);
+    if (code == SUCCESS) {
+        vm->I += d->x;
+    }
+    return code;
+}
+
+// 0xFX65 - Load memory, leaving I past the last register as on the COSMAC VIP
+static enum cpu_status_code op_ld_v_mem_inc(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    enum cpu_status_code code = op_ld_v_mem(vm, d);
+    if (code == SUCCESS) {
+        vm->I += d->x + 1;
+    }
+    return code;
+}
+
+// 0xFX75 - Save flag registers
+static enum cpu_status_code op_ld_r_vx(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    memcpy(vm->flags, vm->V, d->x + 1);
+    return SUCCESS;
+}
+
+// 0xFX85 - Load flag registers
+static enum cpu_status_code op_ld_vx_r(
+    struct chip8_vm *vm,
+    struct decoded_instruction *d)
+{
+    memcpy(vm->V, vm->flags, d->x + 1);
+    return SUCCESS;
+}
+
+static const instruction_handler handlers[OPCODE_COUNT] = {
+    [OP_UNDECODED] = op_decode,
+#define X(opcode, handler) [opcode] = handler,
+    OPCODES(X)
+#undef X
+};
+
+#ifdef HAS_COMPUTED_GOTO
+static uint64_t run_threaded(
+    struct chip8_vm *vm,
+    uint64_t count,
+    struct decoded_instruction *first,
+    struct cpu_status *status)
+{
+    static void *const labels[OPCODE_COUNT] = {
+        [OP_UNDECODED] = &&threaded_op_decode,
+#define X(opcode, handler) [opcode] = &&threaded_##handler,
+        OPCODES(X)
+#undef X
+    };
+
+    struct decoded_instruction *d = first;
+    enum cpu_status_code code = SUCCESS;
+    uint16_t instruction = 0x0000;
+    uint64_t executed = 0;
+
+// Fetches the next decoded instruction and jumps straight to its handler.
+#define DISPATCH()                         \
+    if (executed == count) {               \
+        goto done;                         \
+    }                                      \
+    if (vm->PC > MEMORY_SIZE - 2) {        \
+        code = INVALID_MEMORY_ACCESS;      \
+        instruction = 0x0000;              \
+        PROFILE_STATUS(vm, code);          \
+        goto done;                         \
+    }                                      \
+    PROFILE_FETCH(vm, vm->PC);             \
+    d = find_decoded(vm, vm->PC);          \
+    vm->PC += 2;                           \
+    executed++;                            \
+    goto *labels[d->op]
+
+    if (d != NULL) {
+        executed++;
+        goto *labels[d->op];
+    }
+    DISPATCH();
+
+threaded_op_decode:
+    decode_instruction(
+        (read_memory(vm, vm->PC - 2) << 8) | read_memory(vm, vm->PC - 1),
+        &vm->quirks,
+        d);
+    goto *labels[d->op];
+
+#define X(opcode, handler)        \
+    threaded_##handler:           \
+    code = handler(vm, d);        \
+    instruction = d->instruction; \
+    PROFILE_EXECUTE(vm, opcode);  \
+    PROFILE_STATUS(vm, code);     \
+    if (code != SUCCESS) {        \
+        goto done;                \
+    }                             \
+    DISPATCH();
+    OPCODES(X)
+#undef X
+#undef DISPATCH
+
+done:
+    status->code = code;
+    status->instruction = instruction;
+    return executed;
+}
+#endif  // HAS_COMPUTED_GOTO
+
+#ifdef HAS_DYNAREC
+static uint64_t run_dynarec_core(
+    struct chip8_vm *vm,
+    uint64_t count,
+    struct cpu_status *status)
+{
+    struct cpu_status last = {.code = SUCCESS, .instruction = 0x0000};
+
+    uint64_t remaining = count;
+    while (remaining > 0) {
+        // Instructions outside of memory are reported by the table core.
+        struct decoded_instruction *d = find_decoded(vm, vm->PC);
+        if (vm->PC <= MEMORY_SIZE - 2 && !d->interpreted) {
+            uint64_t budget = remaining;
+            if (!run_dynarec(vm, vm->PC, &budget, fetch_decoded)) {
+                d->interpreted = true;
+            } else if (budget != remaining) {
+                remaining = budget;
+                continue;
+            }
+        }
+
+        // Nothing could be run natively, so interpret a single instruction.
+        last = run_table_cycle(vm);
+        remaining--;
+        if (last.code) {
+            break;
+        }
+    }
+
+    *status = last;
+    return count - remaining;
+}
+
+static struct decoded_instruction *fetch_decoded(
+    struct chip8_vm *vm,
+    uint16_t address)
+{
+    struct decoded_instruction *d = find_decoded(vm, address);
+    if (d->op == OP_UNDECODED) {
+        decode_instruction(
+            (read_memory(vm, address) << 8) | read_memory(vm, address + 1),
+            &vm->quirks,
+            d);
+    }
+    return d;
+}
+#endif  // HAS_DYNAREC
+
 #ifdef UNIT_TEST
-uint16_t get_program_counter()
+uint16_t get_program_counter(struct chip8_vm *vm)
 {
-    return PC;
+    return vm->PC;
 }
 
-uint16_t get_index_register()
+uint16_t get_index_register(struct chip8_vm *vm)
 {
-    return I;
+    return vm->I;
 }
 
-uint8_t *get_variable_registers()
+uint8_t *get_variable_registers(struct chip8_vm *vm)
 {
-    return V;
+    return vm->V;
 }
 
-stack *get_stack()
+stack *get_stack(struct chip8_vm *vm)
 {
-    return &s;
+    return &vm->stack;
 }
 
-uint16_t debug_read_instruction()
+uint16_t debug_read_instruction(struct chip8_vm *vm)
 {
-    return read_instruction();
+    return read_instruction(vm);
 }
 
-struct cpu_status debug_run_instruction(uint16_t instruction)
+struct cpu_status debug_run_instruction(
+    struct chip8_vm *vm,
+    uint16_t instruction)
 {
     struct cpu_status status = {.code = SUCCESS, .instruction = instruction};
-    run_instruction(instruction, &status);
+    run_instruction(vm, instruction, &status);
     return status;
 }
 #endif  // !UNIT_TEST
@@ -8,15 +8,123 @@
 #include "stack.h"
 #endif  // !UNIT_TEST
 
+#include "quirks.h"
+
 #define INSTRUCTIONS_PER_SECOND 700
+#define FLAG_REGISTERS 16  // How many registers FX75 and FX85 can save
+
+struct chip8_vm;
+
+// Every status a CPU cycle can end with.
+//
+// WAITING_FOR_KEY is no error, but stops the cores all the same, as the CPU
+// is blocked on 0xFX0A until the next sample of the keypad.
+#define STATUS_CODES(X)          \
+    X(SUCCESS)                   \
+    X(UNKNOWN_INSTRUCTION)       \
+    X(INVALID_INSTRUCTION)       \
+    X(INVALID_MEMORY_ACCESS)     \
+    X(INVALID_STACK_OPERATION)   \
+    X(INVALID_VARIABLE_REGISTER) \
+    X(WAITING_FOR_KEY)
 
 enum cpu_status_code {
-    SUCCESS,
-    UNKNOWN_INSTRUCTION,
-    INVALID_INSTRUCTION,
-    INVALID_MEMORY_ACCESS,
-    INVALID_STACK_OPERATION,
-    INVALID_VARIABLE_REGISTER,
+#define X(code) code,
+    STATUS_CODES(X)
+#undef X
+    STATUS_CODE_COUNT,
+};
+
+// Every distinct instruction, as its opcode and the name of its handler.
+//
+// Instructions whose behavior depends on the quirks get an opcode for every
+// behavior, which is picked once when decoding, so no handler ever checks the
+// quirks while running.
+#define OPCODES(X)                          \
+    X(OP_UNKNOWN, op_unknown)               \
+    X(OP_INVALID, op_invalid)               \
+    X(OP_CLS, op_cls)                       \
+    X(OP_RET, op_ret)                       \
+    X(OP_SCD, op_scd)                       \
+    X(OP_SCU, op_scu)                       \
+    X(OP_SCR, op_scr)                       \
+    X(OP_SCL, op_scl)                       \
+    X(OP_LOW, op_low)                       \
+    X(OP_HIGH, op_high)                     \
+    X(OP_JP, op_jp)                         \
+    X(OP_JP_V0, op_jp_v0)                   \
+    X(OP_JP_VX, op_jp_vx)                   \
+    X(OP_CALL, op_call)                     \
+    X(OP_SE_VX_NN, op_se_vx_nn)             \
+    X(OP_SNE_VX_NN, op_sne_vx_nn)           \
+    X(OP_SE_VX_VY, op_se_vx_vy)             \
+    X(OP_SNE_VX_VY, op_sne_vx_vy)           \
+    X(OP_LD_MEM_RANGE, op_ld_mem_range)     \
+    X(OP_LD_RANGE_MEM, op_ld_range_mem)     \
+    X(OP_LD_VX_NN, op_ld_vx_nn)             \
+    X(OP_ADD_VX_NN, op_add_vx_nn)           \
+    X(OP_LD_VX_VY, op_ld_vx_vy)             \
+    X(OP_OR, op_or)                         \
+    X(OP_OR_VF_RESET, op_or_vf_reset)       \
+    X(OP_AND, op_and)                       \
+    X(OP_AND_VF_RESET, op_and_vf_reset)     \
+    X(OP_XOR, op_xor)                       \
+    X(OP_XOR_VF_RESET, op_xor_vf_reset)     \
+    X(OP_ADD_VX_VY, op_add_vx_vy)           \
+    X(OP_SUB_VY_VX, op_sub_vy_vx)           \
+    X(OP_SHR, op_shr)                       \
+    X(OP_SHR_VY, op_shr_vy)                 \
+    X(OP_SUB_VX_VY, op_sub_vx_vy)           \
+    X(OP_SHL, op_shl)                       \
+    X(OP_SHL_VY, op_shl_vy)                 \
+    X(OP_LD_I, op_ld_i)                     \
+    X(OP_LD_I_LONG, op_ld_i_long)           \
+    X(OP_RND, op_rnd)                       \
+    X(OP_DRW, op_drw)                       \
+    X(OP_DRW_WRAP, op_drw_wrap)             \
+    X(OP_DRW_LARGE, op_drw_large)           \
+    X(OP_DRW_LARGE_WRAP, op_drw_large_wrap) \
+    X(OP_SKP, op_skp)                       \
+    X(OP_SKNP, op_sknp)                     \
+    X(OP_LD_VX_DT, op_ld_vx_dt)             \
+    X(OP_LD_VX_K, op_ld_vx_k)               \
+    X(OP_LD_DT_VX, op_ld_dt_vx)             \
+    X(OP_LD_ST_VX, op_ld_st_vx)             \
+    X(OP_ADD_I, op_add_i)                   \
+    X(OP_LD_F, op_ld_f)                     \
+    X(OP_LD_HF, op_ld_hf)                   \
+    X(OP_LD_B, op_ld_b)                     \
+    X(OP_PITCH, op_pitch)                   \
+    X(OP_LD_MEM_V, op_ld_mem_v)             \
+    X(OP_LD_MEM_V_INC_X, op_ld_mem_v_inc_x) \
+    X(OP_LD_MEM_V_INC, op_ld_mem_v_inc)     \
+    X(OP_LD_V_MEM, op_ld_v_mem)             \
+    X(OP_LD_V_MEM_INC_X, op_ld_v_mem_inc_x) \
+    X(OP_LD_V_MEM_INC, op_ld_v_mem_inc)     \
+    X(OP_LD_R_VX, op_ld_r_vx)               \
+    X(OP_LD_VX_R, op_ld_vx_r)               \
+    X(OP_PLANE, op_plane)                   \
+    X(OP_AUDIO, op_audio)
+
+// Indices into the handler table, one for every distinct instruction.
+enum opcode {
+    OP_UNDECODED,  // Cache entries that still need to be decoded
+#define X(opcode, handler) opcode,
+    OPCODES(X)
+#undef X
+    OPCODE_COUNT,
+};
+
+// An instruction with all of its operands extracted ahead of time.
+struct decoded_instruction {
+    uint16_t instruction;  // The raw instruction
+    uint16_t nnn;          // Three nibbles - a 12-bit memory address
+    uint8_t op;            // The opcode, indexing the handler table
+    uint8_t x;             // Second nibble - usually a variable register
+    uint8_t y;             // Third nibble - usually a variable register
+    uint8_t n;             // Fourth nibble - a 4-bit number
+    uint8_t nn;            // Second byte - an 8-bit number
+    bool interpreted;      // If the dynamic recompiler has no translation
 };
 
 struct cpu_status {
@@ -24,15 +132,87 @@ struct cpu_status {
     uint16_t instruction;       // The instruction that was executed this cycle.
 };
 
+// The interpreter cores that can execute instructions.
+enum cpu_core {
+    CORE_TABLE,     // Calls handlers through a table of function pointers.
+    CORE_THREADED,  // Jumps between handlers with computed gotos.
+    CORE_DYNAREC,   // Runs blocks of instructions translated to native code.
+};
+
+// The core used unless another one is selected at runtime.
+#ifndef CPU_DEFAULT_CORE
+#define CPU_DEFAULT_CORE CORE_TABLE
+#endif  // !CPU_DEFAULT_CORE
+
+/**
+ * Connects the CPU to the memory of a machine.
+ *
+ * Keeps the decoded instructions in sync with any later writes to memory, no
+ * matter if a program was loaded through startup() or a save state.
+ *
+ * @param vm The machine whose CPU to connect.
+ */
+void init_cpu(struct chip8_vm *vm);
+
+/**
+ * Releases the pages of decoded instructions of a machine.
+ *
+ * They are allocated again as instructions execute, so the machine keeps
+ * running afterwards, only slower until its pages are decoded again.
+ *
+ * @param vm The machine whose decoded instructions to release.
+ */
+void free_decoded_pages(struct chip8_vm *vm);
+
 /**
  * Performs the startup sequence of the emulator.
  *
  * Initializes the system into a stable state and loads a ROM from the provided
  * file path.
  *
+ * @param vm The machine to start.
  * @param path The path to a ROM file which should be read into memory.
+ * @return If the file could be read, otherwise the machine is left as it was.
  */
-void startup(char *path);
+bool startup(struct chip8_vm *vm, char *path);
+
+/**
+ * Performs the startup sequence of the emulator with a ROM already in memory.
+ *
+ * Behaves the same as startup(), without any file access. Only restores the
+ * memory and display the last program changed, so it is cheap enough to call
+ * for every input of a fuzzer.
+ *
+ * @param vm The machine to start.
+ * @param rom The bytes of the ROM to load into memory.
+ * @param size The amount of bytes of the ROM.
+ */
+void startup_rom(struct chip8_vm *vm, const uint8_t *rom, uint16_t size);
+
+/**
+ * Selects how instructions with differing behavior between interpreters run.
+ *
+ * Every instruction is decoded again afterwards, as the quirks are baked into
+ * the decoded instructions.
+ *
+ * @param vm The machine to configure.
+ * @param quirks The quirks to run instructions with.
+ */
+void set_quirks(struct chip8_vm *vm, struct quirks quirks);
+
+/**
+ * Selects the interpreter core used to execute instructions.
+ *
+ * Every core behaves identically, they only differ in how fast they are on a
+ * specific compiler and host. The threaded core relies on computed gotos, so
+ * it falls back to the table core on compilers without them. The dynamic
+ * recompiler only supports x86-64 hosts, and falls back to the table core
+ * elsewhere.
+ *
+ * @param vm The machine to select the core of.
+ * @param core The core to use for all following CPU cycles.
+ */
+void set_cpu_core(struct chip8_vm *vm, enum cpu_core core);
 
 /**
  * Runs a single CPU cycle.
@@ -40,9 +220,44 @@ void startup(char *path);
  * Provides a shared abstraction for both reading and executing an instruction
  * from the system's memory.
  *
+ * @param vm The machine to run.
  * @return Meta information about the CPU cycle.
  */
-struct cpu_status run_cycle();
+struct cpu_status run_cycle(struct chip8_vm *vm);
+
+/**
+ * Runs several CPU cycles in a row.
+ *
+ * Stops early if any cycle reports an error, or blocks on 0xFX0A waiting for a
+ * key. Running many cycles at once lets the interpreter core stay within its
+ * dispatch loop, which is considerably faster than calling run_cycle()
+ * repeatedly.
+ *
+ * @param vm The machine to run.
+ * @param count The maximum amount of CPU cycles to run.
+ * @param status Meta information about the last CPU cycle that was run.
+ * @return The amount of CPU cycles that were run.
+ */
+uint64_t run_cycles(
+    struct chip8_vm *vm,
+    uint64_t count,
+    struct cpu_status *status);
+
+/**
+ * Skips whole iterations of an idle loop the CPU is spinning in.
+ *
+ * Recognizes jumps to themselves, loops that poll the delay timer with FX07,
+ * skip out of the loop on the polled value with 3XNN or 4XNN, and jump back
+ * otherwise, and FX0A blocked on a key. None can make progress before the
+ * timers tick next, so skipping their iterations up to the tick leaves the
+ * exact same state behind as running them.
+ *
+ * @param vm The machine to inspect.
+ * @param count The maximum amount of CPU cycles to skip.
+ * @return The amount of CPU cycles that were skipped, or 0 if the CPU is not
+ * idle.
+ */
+uint64_t skip_idle_loop(struct chip8_vm *vm, uint64_t count);
 
 /**
  * Reads and returns the next CPU instruction.
@@ -50,9 +265,10 @@ struct cpu_status run_cycle();
  * Localizes the entire handling of the program counter and read access of the
  * memory for the current CPU cycle.
  *
+ * @param vm The machine to read from.
  * @return The 4 bytes that describe the next instruction.
  */
-static uint16_t read_instruction();
+static uint16_t read_instruction(struct chip8_vm *vm);
 
 /**
  * Runs the provided CPU instruction.
@@ -60,58 +276,201 @@ static uint16_t read_instruction();
  * Localizes the decoding and execution of the provided instruction, delagating
  * steps to other modules of the system where appropriate.
  *
+ * @param vm The machine to run the instruction on.
  * @param instruction The instruction to execute.
  * @param error Meta information about the CPU cycle.
  */
-static void run_instruction(uint16_t instruction, struct cpu_status *error);
+static void run_instruction(
+    struct chip8_vm *vm,
+    uint16_t instruction,
+    struct cpu_status *error);
+
+/**
+ * Decodes the provided CPU instruction.
+ *
+ * Extracts the opcode and all operands of the instruction once, so executing
+ * it again later skips straight to its handler.
+ *
+ * @param instruction The instruction to decode.
+ * @param quirks The quirks picking the opcode of quirky instructions.
+ * @param decoded The decoded instruction to fill in.
+ */
+static void decode_instruction(
+    uint16_t instruction,
+    const struct quirks *quirks,
+    struct decoded_instruction *decoded);
+
+/**
+ * Invalidates the decoded instructions overlapping a range of memory.
+ *
+ * Registered as the memory write hook, so instructions are decoded again after
+ * the program modifies them.
+ *
+ * @param vm The machine whose memory was written to.
+ * @param address The first memory address that was written to.
+ * @param length The amount of consecutive bytes that were written.
+ */
+static void invalidate_instructions(
+    struct chip8_vm *vm,
+    uint16_t address,
+    uint32_t length);
+
+/**
+ * Finds the cache entry of the instruction at an address.
+ *
+ * Allocates the page of the address if nothing executed from it before. If
+ * that fails, a single entry shared by all such addresses is returned instead,
+ * so the instruction is decoded again every time it executes.
+ *
+ * @param vm The machine whose decoded instructions to search.
+ * @param address The memory address of the instruction.
+ * @return The entry of the instruction, which may still be undecoded.
+ */
+static struct decoded_instruction *find_decoded(
+    struct chip8_vm *vm,
+    uint16_t address);
+
+/**
+ * Allocates the page of decoded instructions containing an address.
+ *
+ * @param vm The machine to allocate the page for.
+ * @param address Any memory address within the page.
+ * @return The page with all of its instructions undecoded, or NULL if it could
+ * not be allocated.
+ */
+static struct decoded_instruction *allocate_decoded_page(
+    struct chip8_vm *vm,
+    uint16_t address);
+
+/**
+ * Skips the instruction the program counter points at.
+ *
+ * Skips both words of F000 NNNN, so a skip never lands on its address.
+ *
+ * @param vm The machine whose program counter to advance.
+ */
+static void skip_instruction(struct chip8_vm *vm);
+
+/**
+ * Checks if a loop polling the delay timer starts at an address.
+ *
+ * @param vm The machine to inspect.
+ * @param head The memory address of the first instruction of the loop.
+ * @param x The variable register the delay timer is polled into.
+ * @return If the loop spins until the next timer tick, given the timer's
+ * current value.
+ */
+static bool is_timer_poll(struct chip8_vm *vm, uint16_t head, uint8_t *x);
+
+/**
+ * Runs decoded instructions through the table core.
+ *
+ * @param vm The machine to run.
+ * @return Meta information about the CPU cycle.
+ */
+static struct cpu_status run_table_cycle(struct chip8_vm *vm);
+
+/**
+ * Runs decoded instructions through the threaded core.
+ *
+ * Every handler ends with its own dispatch to the next handler, rather than
+ * returning to a shared loop, which gives the host's branch predictor a
+ * separate history for every instruction.
+ *
+ * @param vm The machine to run.
+ * @param count The maximum amount of CPU cycles to run.
+ * @param first An instruction to run before fetching any, or NULL.
+ * @param status Meta information about the last CPU cycle that was run.
+ * @return The amount of CPU cycles that were run.
+ */
+static uint64_t run_threaded(
+    struct chip8_vm *vm,
+    uint64_t count,
+    struct decoded_instruction *first,
+    struct cpu_status *status);
+
+/**
+ * Runs instructions through the dynamic recompiler.
+ *
+ * Blocks of instructions are run as native code where possible, and single
+ * instructions without a native translation are run through the table core.
+ *
+ * @param vm The machine to run.
+ * @param count The maximum amount of CPU cycles to run.
+ * @param status Meta information about the last CPU cycle that was run.
+ * @return The amount of CPU cycles that were run.
+ */
+static uint64_t run_dynarec_core(
+    struct chip8_vm *vm,
+    uint64_t count,
+    struct cpu_status *status);
+
+/**
+ * Provides the decoded instruction at an address to the dynamic recompiler.
+ *
+ * @param vm The machine to decode from.
+ * @param address The memory address of the instruction.
+ * @return The decoded instruction, decoded first if it was not yet.
+ */
+static struct decoded_instruction *fetch_decoded(
+    struct chip8_vm *vm,
+    uint16_t address);
 
 #ifdef UNIT_TEST
 /**
  * Retrieves the program counter for testing purposes.
  *
+ * @param vm The machine to inspect.
  * @return The program counter.
  */
-uint16_t get_program_counter();
+uint16_t get_program_counter(struct chip8_vm *vm);
 
 /**
  * Retrieves the index register for testing purposes.
  *
+ * @param vm The machine to inspect.
  * @return The index register.
  */
-uint16_t get_index_register();
+uint16_t get_index_register(struct chip8_vm *vm);
 
 /**
  * Retrieves the variable registers for testing purposes.
  *
+ * @param vm The machine to inspect.
  * @return The variable registers.
  */
-uint8_t *get_variable_registers();
+uint8_t *get_variable_registers(struct chip8_vm *vm);
 
 /**
  * Retrieves the stack for testing purposes.
  *
+ * @param vm The machine to inspect.
  * @return The stack.
  */
-stack *get_stack();
+stack *get_stack(struct chip8_vm *vm);
 
 /**
  * Reads and returns the next CPU instruction.
  *
  * Publicly exposes the read_instruction function for testing purposes.
  *
+ * @param vm The machine to read from.
  * @return The 4 bytes that describe the next instruction.
  */
-uint16_t debug_read_instruction();
+uint16_t debug_read_instruction(struct chip8_vm *vm);
 
 /**
  * Runs the provided CPU instruction.
  *
  * Publicly exposes the run_instruction function for testing purposes.
  *
+ * @param vm The machine to run the instruction on.
  * @param instruction The instruction to execute.
  * @return Meta information about the CPU cycle.
  */
-struct cpu_status debug_run_instruction(uint16_t instruction);
+struct cpu_status debug_run_instruction(
+    struct chip8_vm *vm,
+    uint16_t instruction);
 #endif  // !UNIT_TEST
 
 #endif  // !CPU_H_
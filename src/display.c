@@ -1,77 +1,375 @@
 #include "display.h"
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
-#ifndef UNIT_TEST
-#include "raylib.h"
-#endif  // !UNIT_TEST
+#include "chip8.h"
+#include "profile.h"
 
-static bool display[SCREEN_HEIGHT][SCREEN_WIDTH];
+// Each row of the display is stored as two words, with the leftmost pixel in
+// the most significant bit of the first word, so a sprite row can be drawn and
+// the display scrolled with a handful of word-wide operations instead of a
+// loop over its pixels. The low resolution only uses the first word of the
+// first 32 rows.
+//
+// Every plane of the XO-CHIP is a display of its own in that layout, and the
+// color of a pixel is picked by the planes it is turned on in.
 
-void clear_display()
+void clear_display(struct chip8_vm *vm)
 {
-    for (uint8_t y = 0; y < SCREEN_HEIGHT; y++) {
-        for (uint8_t x = 0; x < SCREEN_WIDTH; x++) {
-            display[y][x] = 0;
+    PROFILE_CLEAR(vm);
+    for (uint8_t plane = 0; plane < PLANE_COUNT; plane++) {
+        if (is_selected(vm, plane)) {
+            memset(vm->display[plane], 0, sizeof(vm->display[plane]));
+        }
+    }
+    vm->display_dirty = true;
+}
+
+void set_resolution(struct chip8_vm *vm, bool hires)
+{
+    // Blanks the display as well, but is counted apart from 00E0.
+    PROFILE_RESOLUTION(vm);
+    vm->hires = hires;
+    memset(vm->display, 0, sizeof(vm->display));
+    vm->drawn_rows = 0;
+    vm->display_dirty = true;
+}
+
+void reset_display(struct chip8_vm *vm)
+{
+    uint64_t rows = vm->drawn_rows;
+    for (uint8_t y = 0; rows != 0; y++, rows >>= 1) {
+        if (rows & 1) {
+            for (uint8_t plane = 0; plane < PLANE_COUNT; plane++) {
+                memset(vm->display[plane][y], 0, sizeof(vm->display[plane][y]));
+            }
         }
     }
 
-    draw();
+    vm->hires = false;
+    vm->drawn_rows = 0;
+    vm->display_dirty = true;
 }
 
-bool draw_sprite(uint8_t x, uint8_t y, uint8_t h, uint8_t *sprite_data)
+void select_planes(struct chip8_vm *vm, uint8_t planes)
 {
+    vm->planes = planes & ((1 << PLANE_COUNT) - 1);
+}
+
+uint16_t get_sprite_size(const struct chip8_vm *vm, uint8_t h, bool large)
+{
+    uint8_t planes = 0;
+    for (uint8_t plane = 0; plane < PLANE_COUNT; plane++) {
+        planes += is_selected(vm, plane);
+    }
+    return h * (large ? 2 : 1) * planes;
+}
+
+uint8_t get_screen_width(const struct chip8_vm *vm)
+{
+    return vm->hires ? HIRES_SCREEN_WIDTH : SCREEN_WIDTH;
+}
+
+uint8_t get_screen_height(const struct chip8_vm *vm)
+{
+    return vm->hires ? HIRES_SCREEN_HEIGHT : SCREEN_HEIGHT;
+}
+
+bool draw_sprite(
+    struct chip8_vm *vm,
+    uint8_t x,
+    uint8_t y,
+    uint8_t h,
+    uint8_t *sprite_data)
+{
+    if (vm->hires || vm->planes != 0x1) {
+        return draw_rows(vm, x, y, h, false, false, sprite_data);
+    }
+
+    PROFILE_DRAW(vm);
+
     // Wrap the starting coordinates if they are out of bounds.
     x = x % SCREEN_WIDTH;
     y = y % SCREEN_HEIGHT;
 
-    bool vf = false;
+    // Clip the sprite if it would overflow the bottom of the screen.
+    if (y + h > SCREEN_HEIGHT) {
+        h = SCREEN_HEIGHT - y;
+    }
+
+    uint64_t collisions = 0;
+
+    // Most programs only ever draw these, so they get a path of their own
+    // that only touches the first word of every row of the first plane.
+    uint64_t(*rows)[ROW_WORDS] = vm->display[0];
+    for (uint8_t row = 0; row < h; row++) {
+        // Align the sprite to the leftmost pixel and shift it into place, which
+        // also clips any pixels that would overflow the right of the screen.
+        uint64_t sprite = ((uint64_t)sprite_data[row] << 56) >> x;
+        collisions |= rows[y + row][0] & sprite;
+        rows[y + row][0] ^= sprite;
+    }
+
+    mark_rows_drawn(vm, y, h);
+    vm->display_dirty = true;
+    return collisions != 0;
+}
+
+bool draw_wrapped_sprite(
+    struct chip8_vm *vm,
+    uint8_t x,
+    uint8_t y,
+    uint8_t h,
+    uint8_t *sprite_data)
+{
+    if (vm->hires || vm->planes != 0x1) {
+        return draw_rows(vm, x, y, h, false, true, sprite_data);
+    }
+
+    PROFILE_DRAW(vm);
+
+    x = x % SCREEN_WIDTH;
+    y = y % SCREEN_HEIGHT;
+
+    uint64_t collisions = 0;
 
+    uint64_t(*rows)[ROW_WORDS] = vm->display[0];
     for (uint8_t row = 0; row < h; row++) {
-        uint8_t sprite = sprite_data[row];
-        for (uint8_t col = 0; col < 8; col++) {
-            // Clip the sprite if it would overflow the screen.
-            if (y + row >= SCREEN_HEIGHT || x + col >= SCREEN_WIDTH) {
-                continue;
-            }
+        // Rotate the sprite into place, so the pixels shifted out on the right
+        // come back in on the left.
+        uint64_t sprite = (uint64_t)sprite_data[row] << 56;
+        uint8_t wrapped = (SCREEN_WIDTH - x) % SCREEN_WIDTH;
+        sprite = (sprite >> x) | (sprite << wrapped);
+        uint8_t line = (y + row) % SCREEN_HEIGHT;
+        collisions |= rows[line][0] & sprite;
+        rows[line][0] ^= sprite;
+    }
 
-            if (sprite & (0x80 >> col)) {
-                if (display[y + row][x + col]) {
-                    vf = true;
-                }
-                display[y + row][x + col] ^= 1;
-            }
+    mark_rows_drawn(vm, y, h);
+    vm->display_dirty = true;
+    return collisions != 0;
+}
+
+bool draw_large_sprite(
+    struct chip8_vm *vm,
+    uint8_t x,
+    uint8_t y,
+    uint8_t *sprite_data)
+{
+    return draw_rows(vm, x, y, 16, true, false, sprite_data);
+}
+
+bool draw_wrapped_large_sprite(
+    struct chip8_vm *vm,
+    uint8_t x,
+    uint8_t y,
+    uint8_t *sprite_data)
+{
+    return draw_rows(vm, x, y, 16, true, true, sprite_data);
+}
+
+void scroll_down(struct chip8_vm *vm, uint8_t n)
+{
+    uint8_t height = get_screen_height(vm);
+    if (n > height) {
+        n = height;
+    }
+
+    for (uint8_t plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!is_selected(vm, plane)) {
+            continue;
         }
+        uint64_t(*rows)[ROW_WORDS] = vm->display[plane];
+        memmove(rows[n], rows[0], (height - n) * sizeof(rows[0]));
+        memset(rows[0], 0, n * sizeof(rows[0]));
     }
 
-    draw();
-    return vf;
+    // Rows move around, so any of them might hold pixels now.
+    vm->drawn_rows = UINT64_MAX;
+    vm->display_dirty = true;
 }
 
-static void draw()
+void scroll_up(struct chip8_vm *vm, uint8_t n)
 {
-#ifndef UNIT_TEST
-    BeginDrawing();
-    ClearBackground(BLACK);
-    for (uint8_t y = 0; y < SCREEN_HEIGHT; y++) {
-        for (uint8_t x = 0; x < SCREEN_WIDTH; x++) {
-            if (display[y][x]) {
-                DrawRectangle(
-                    x * SCALING_FACTOR,
-                    y * SCALING_FACTOR,
-                    SCALING_FACTOR,
-                    SCALING_FACTOR,
-                    RAYWHITE);
+    uint8_t height = get_screen_height(vm);
+    if (n > height) {
+        n = height;
+    }
+
+    for (uint8_t plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!is_selected(vm, plane)) {
+            continue;
+        }
+        uint64_t(*rows)[ROW_WORDS] = vm->display[plane];
+        memmove(rows[0], rows[n], (height - n) * sizeof(rows[0]));
+        memset(rows[height - n], 0, n * sizeof(rows[0]));
+    }
+
+    // Rows move around, so any of them might hold pixels now.
+    vm->drawn_rows = UINT64_MAX;
+    vm->display_dirty = true;
+}
+
+void scroll_right(struct chip8_vm *vm, uint8_t n)
+{
+    if (n == 0) {
+        return;
+    }
+
+    for (uint8_t plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!is_selected(vm, plane)) {
+            continue;
+        }
+        uint64_t(*rows)[ROW_WORDS] = vm->display[plane];
+        if (vm->hires) {
+            for (uint8_t y = 0; y < HIRES_SCREEN_HEIGHT; y++) {
+                rows[y][1] = (rows[y][1] >> n) | (rows[y][0] << (64 - n));
+                rows[y][0] >>= n;
+            }
+        } else {
+            for (uint8_t y = 0; y < SCREEN_HEIGHT; y++) {
+                rows[y][0] >>= n;
             }
         }
     }
-    EndDrawing();
-#endif  // !UNIT_TEST
+    vm->display_dirty = true;
+}
+
+void scroll_left(struct chip8_vm *vm, uint8_t n)
+{
+    if (n == 0) {
+        return;
+    }
+
+    for (uint8_t plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!is_selected(vm, plane)) {
+            continue;
+        }
+        uint64_t(*rows)[ROW_WORDS] = vm->display[plane];
+        if (vm->hires) {
+            for (uint8_t y = 0; y < HIRES_SCREEN_HEIGHT; y++) {
+                rows[y][0] = (rows[y][0] << n) | (rows[y][1] >> (64 - n));
+                rows[y][1] <<= n;
+            }
+        } else {
+            for (uint8_t y = 0; y < SCREEN_HEIGHT; y++) {
+                rows[y][0] <<= n;
+            }
+        }
+    }
+    vm->display_dirty = true;
+}
+
+bool get_pixel(struct chip8_vm *vm, uint8_t x, uint8_t y)
+{
+    return get_pixel_planes(vm, x, y) != 0;
+}
+
+uint8_t get_pixel_planes(struct chip8_vm *vm, uint8_t x, uint8_t y)
+{
+    uint8_t planes = 0;
+    for (uint8_t plane = 0; plane < PLANE_COUNT; plane++) {
+        uint64_t word = vm->display[plane][y][x / 64];
+        planes |= ((word >> (63 - x % 64)) & 1) << plane;
+    }
+    return planes;
+}
+
+static bool is_selected(const struct chip8_vm *vm, uint8_t plane)
+{
+    return vm->planes & (1 << plane);
+}
+
+static void mark_rows_drawn(struct chip8_vm *vm, uint8_t y, uint8_t h)
+{
+    // Sprites are at most 16 rows tall, so they wrap around at most once, and
+    // in the low resolution, the rows past the bottom are folded back onto the
+    // top as well.
+    uint64_t rows = ((uint64_t)1 << h) - 1;
+    rows = y > 0 ? (rows << y) | (rows >> (64 - y)) : rows;
+    if (!vm->hires) {
+        rows |= rows >> SCREEN_HEIGHT;
+    }
+    vm->drawn_rows |= rows;
 }
 
-#ifdef UNIT_TEST
-bool (*get_display())[SCREEN_WIDTH]
+static bool draw_rows(
+    struct chip8_vm *vm,
+    uint8_t x,
+    uint8_t y,
+    uint8_t h,
+    bool large,
+    bool wrap,
+    uint8_t *sprite_data)
 {
-    return display;
+    PROFILE_DRAW(vm);
+
+    // Wrap the starting coordinates if they are out of bounds. Both
+    // resolutions are powers of two, so this is a mask rather than a division.
+    uint8_t width = get_screen_width(vm);
+    uint8_t height = get_screen_height(vm);
+    x &= width - 1;
+    y &= height - 1;
+
+    // Every selected plane draws a sprite of its own, and those follow each
+    // other in memory at their full size, even if they end up clipped.
+    uint8_t row_size = large ? 2 : 1;
+    uint16_t sprite_size = h * row_size;
+
+    // Clip the sprite if it would overflow the bottom of the screen.
+    if (!wrap && y + h > height) {
+        h = height - y;
+    }
+
+    uint64_t collisions = 0;
+
+    for (uint8_t plane = 0; plane < PLANE_COUNT; plane++) {
+        if (!is_selected(vm, plane)) {
+            continue;
+        }
+
+        uint64_t(*rows)[ROW_WORDS] = vm->display[plane];
+        for (uint8_t row = 0; row < h; row++) {
+            // Align the sprite to the leftmost pixel.
+            uint8_t *bytes = &sprite_data[row * row_size];
+            uint64_t sprite = (uint64_t)bytes[0] << 56;
+            if (large) {
+                sprite |= (uint64_t)bytes[1] << 48;
+            }
+
+            // Shift it into place across the words of the line, and whatever
+            // overflows the right of the screen into a word of its own.
+            uint64_t left, right, overflow;
+            if (x < 64) {
+                left = sprite >> x;
+                right = x > 0 ? sprite << (64 - x) : 0;
+                overflow = 0;
+            } else {
+                left = 0;
+                right = sprite >> (x - 64);
+                overflow = x > 64 ? sprite << (128 - x) : 0;
+            }
+            if (!vm->hires) {
+                overflow = right;
+                right = 0;
+            }
+
+            // The overflow is clipped, or comes back in on the left.
+            if (wrap) {
+                left |= overflow;
+            }
+
+            uint64_t *line = rows[(y + row) & (height - 1)];
+            collisions |= (line[0] & left) | (line[1] & right);
+            line[0] ^= left;
+            line[1] ^= right;
+        }
+        sprite_data += sprite_size;
+    }
+
+    mark_rows_drawn(vm, y, h);
+    vm->display_dirty = true;
+    return collisions != 0;
 }
-#endif  // !UNIT_TEST
@@ -9,44 +9,268 @@
 #define SCREEN_HEIGHT 32
 #define TARGET_FRAMERATE 60
 
-#define SCALING_FACTOR 10  // Scale of the screen to make it visible.
+// The high resolution of the SUPER-CHIP, which 00FF switches to.
+#define HIRES_SCREEN_WIDTH 128
+#define HIRES_SCREEN_HEIGHT 64
+
+#define ROW_WORDS (HIRES_SCREEN_WIDTH / 64)  // Words per row of the display
+#define PLANE_COUNT 2  // Bit-planes of the XO-CHIP, for 4 colors
+
+struct chip8_vm;
+
+/**
+ * Clears the selected planes of the display, resetting them to the base color.
+ *
+ * Corresponds to the CPU instruction 0x00E0. Only the pixels are changed, the
+ * window is updated the next time the display is presented.
+ *
+ * @param vm The machine whose display to clear.
+ */
+void clear_display(struct chip8_vm *vm);
+
+/**
+ * Switches the display between the low and high resolution.
+ *
+ * Corresponds to the CPU instructions 0x00FE and 0x00FF. Clears every plane of
+ * the display, as the pixels of one resolution have no meaning in the other.
+ *
+ * @param vm The machine whose display to switch.
+ * @param hires If the high resolution should be used.
+ */
+void set_resolution(struct chip8_vm *vm, bool hires);
 
 /**
- * Fully clears the display, resetting it to the base color.
+ * Returns the display to the low resolution with every plane cleared, as
+ * programs start out with.
  *
- * Corresponds to the CPU instruction 0x00E0.
+ * Only clears the rows drawn to since the display was last reset or switched
+ * between resolutions, rather than all of it.
+ *
+ * @param vm The machine whose display to reset.
+ */
+void reset_display(struct chip8_vm *vm);
+
+/**
+ * Selects the planes that are drawn to, cleared and scrolled.
+ *
+ * Corresponds to the CPU instruction 0xFN01. Programs start out with only the
+ * first plane selected, which behaves like the single plane of the CHIP-8.
+ *
+ * @param vm The machine whose planes to select.
+ * @param planes The planes to select, as a mask with the first plane in bit 0.
  */
-void clear_display();
+void select_planes(struct chip8_vm *vm, uint8_t planes);
+
+/**
+ * Calculates how many bytes of memory a sprite is drawn from.
+ *
+ * Every selected plane draws a sprite of its own, which follow each other in
+ * memory, so the CPU can check that all of them fit within it.
+ *
+ * @param vm The machine whose selected planes to draw to.
+ * @param h The height of the sprite.
+ * @param large If every row of the sprite is two bytes wide.
+ * @return The amount of bytes read from memory.
+ */
+uint16_t get_sprite_size(const struct chip8_vm *vm, uint8_t h, bool large);
+
+/**
+ * Gets the width of the display in its current resolution.
+ *
+ * @param vm The machine whose display to measure.
+ * @return The width in pixels.
+ */
+uint8_t get_screen_width(const struct chip8_vm *vm);
+
+/**
+ * Gets the height of the display in its current resolution.
+ *
+ * @param vm The machine whose display to measure.
+ * @return The height in pixels.
+ */
+uint8_t get_screen_height(const struct chip8_vm *vm);
 
 /**
  * Draws the provided sprite at the provided x and y coordinates.
  *
- * Corresponds to the CPU instruction 0xDXYN.
+ * Corresponds to the CPU instruction 0xDXYN. With several planes selected,
+ * every plane draws its own sprite, which directly follow each other in
+ * memory.
  *
+ * @param vm The machine whose display to draw to.
+ * @param x The horizontal offset at which to start drawing the sprite.
+ * @param y The vertical offset at which to start drawing the sprite.
+ * @param h The height at which to draw the sprite.
+ * @param sprite The bytes of the sprite, where active bits should be inverted.
+ * @return The new status of the VF register, based on a pixel collision in
+ * any plane.
+ */
+bool draw_sprite(
+    struct chip8_vm *vm,
+    uint8_t x,
+    uint8_t y,
+    uint8_t h,
+    uint8_t *sprite);
+
+/**
+ * Draws the provided sprite, wrapping it around the edges of the screen.
+ *
+ * Behaves like draw_sprite(), except that pixels past the right or bottom edge
+ * appear on the opposite edge instead of being clipped.
+ *
+ * @param vm The machine whose display to draw to.
  * @param x The horizontal offset at which to start drawing the sprite.
  * @param y The vertical offset at which to start drawing the sprite.
  * @param h The height at which to draw the sprite.
  * @param sprite The bytes of the sprite, where active bits should be inverted.
  * @return The new status of the VF register, based on a pixel collision.
  */
-bool draw_sprite(uint8_t x, uint8_t y, uint8_t h, uint8_t *sprite);
+bool draw_wrapped_sprite(
+    struct chip8_vm *vm,
+    uint8_t x,
+    uint8_t y,
+    uint8_t h,
+    uint8_t *sprite);
 
 /**
- * An abstraction for CPU drawing functions onto Raylib.
+ * Draws the provided 16x16 sprite at the provided x and y coordinates.
+ *
+ * Corresponds to the CPU instruction 0xDXY0. Behaves like draw_sprite(),
+ * except that every row is two bytes wide.
  *
- * Handles drawing a local 2D array of pixels onto the Raylib window, allowing
- * the non-static functions to directly correspond to CPU instructions, without
- * introducing additional complexity for dealing with Raylib.
+ * @param vm The machine whose display to draw to.
+ * @param x The horizontal offset at which to start drawing the sprite.
+ * @param y The vertical offset at which to start drawing the sprite.
+ * @param sprite The 32 bytes of the sprite, two for every row.
+ * @return The new status of the VF register, based on a pixel collision.
  */
-static void draw();
+bool draw_large_sprite(
+    struct chip8_vm *vm,
+    uint8_t x,
+    uint8_t y,
+    uint8_t *sprite);
 
-#ifdef UNIT_TEST
 /**
- * Retrieves the display array for testing purposes.
+ * Draws the provided 16x16 sprite, wrapping it around the edges of the screen.
  *
- * @return The display array.
+ * @param vm The machine whose display to draw to.
+ * @param x The horizontal offset at which to start drawing the sprite.
+ * @param y The vertical offset at which to start drawing the sprite.
+ * @param sprite The 32 bytes of the sprite, two for every row.
+ * @return The new status of the VF register, based on a pixel collision.
+ */
+bool draw_wrapped_large_sprite(
+    struct chip8_vm *vm,
+    uint8_t x,
+    uint8_t y,
+    uint8_t *sprite);
+
+/**
+ * Scrolls the display down, clearing the rows scrolled in at the top.
+ *
+ * Corresponds to the CPU instruction 0x00CN. Distances count pixels of the
+ * current resolution.
+ *
+ * @param vm The machine whose display to scroll.
+ * @param n The amount of rows to scroll by.
+ */
+void scroll_down(struct chip8_vm *vm, uint8_t n);
+
+/**
+ * Scrolls the display up, clearing the rows scrolled in at the bottom.
+ *
+ * Corresponds to the CPU instruction 0x00DN. Distances count pixels of the
+ * current resolution.
+ *
+ * @param vm The machine whose display to scroll.
+ * @param n The amount of rows to scroll by.
+ */
+void scroll_up(struct chip8_vm *vm, uint8_t n);
+
+/**
+ * Scrolls the display right, clearing the columns scrolled in on the left.
+ *
+ * Corresponds to the CPU instruction 0x00FB, which scrolls by 4 pixels of the
+ * current resolution.
+ *
+ * @param vm The machine whose display to scroll.
+ * @param n The amount of columns to scroll by, less than 64.
+ */
+void scroll_right(struct chip8_vm *vm, uint8_t n);
+
+/**
+ * Scrolls the display left, clearing the columns scrolled in on the right.
+ *
+ * Corresponds to the CPU instruction 0x00FC, which scrolls by 4 pixels of the
+ * current resolution.
+ *
+ * @param vm The machine whose display to scroll.
+ * @param n The amount of columns to scroll by, less than 64.
+ */
+void scroll_left(struct chip8_vm *vm, uint8_t n);
+
+/**
+ * Reads a single pixel of the display.
+ *
+ * The display is stored bit-packed, so this is the simplest way to inspect it
+ * outside of the module.
+ *
+ * @param vm The machine whose display to read.
+ * @param x The horizontal coordinate of the pixel, within the screen width.
+ * @param y The vertical coordinate of the pixel, within the screen height.
+ * @return If the pixel is turned on in any plane.
+ */
+bool get_pixel(struct chip8_vm *vm, uint8_t x, uint8_t y);
+
+/**
+ * Reads the planes a single pixel of the display is turned on in.
+ *
+ * @param vm The machine whose display to read.
+ * @param x The horizontal coordinate of the pixel, within the screen width.
+ * @param y The vertical coordinate of the pixel, within the screen height.
+ * @return The planes the pixel is turned on in, as a mask with the first plane
+ * in bit 0, which picks one of the 4 colors.
+ */
+uint8_t get_pixel_planes(struct chip8_vm *vm, uint8_t x, uint8_t y);
+
+/**
+ * Checks if a plane of the display is selected.
+ *
+ * @param vm The machine whose display to check.
+ * @param plane The index of the plane.
+ * @return If the plane is drawn to, cleared and scrolled.
+ */
+static bool is_selected(const struct chip8_vm *vm, uint8_t plane);
+
+/**
+ * Notes the rows a sprite was drawn to, so resetting the display clears them.
+ *
+ * @param vm The machine whose display was drawn to.
+ * @param y The row the sprite starts at, within the screen.
+ * @param h The amount of rows drawn, wrapping around the bottom.
+ */
+static void mark_rows_drawn(struct chip8_vm *vm, uint8_t y, uint8_t h);
+
+/**
+ * Draws the rows of a sprite of one or two bytes wide, in either resolution
+ * and to any of the planes.
+ *
+ * @param vm The machine whose display to draw to.
+ * @param x The horizontal offset at which to start drawing the sprite.
+ * @param y The vertical offset at which to start drawing the sprite.
+ * @param h The height at which to draw the sprite.
+ * @param large If every row of the sprite is two bytes wide.
+ * @param wrap If the sprite wraps around the edges instead of being clipped.
+ * @param sprite The bytes of the sprite, where active bits should be inverted.
+ * @return The new status of the VF register, based on a pixel collision.
  */
-bool (*get_display())[SCREEN_WIDTH];
-#endif  // !UNIT_TEST
+static bool draw_rows(
+    struct chip8_vm *vm,
+    uint8_t x,
+    uint8_t y,
+    uint8_t h,
+    bool large,
+    bool wrap,
+    uint8_t *sprite);
 
 #endif  // !DISPLAY_H_
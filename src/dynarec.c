@@ -0,0 +1,704 @@
+#include "dynarec.h"
+
+#ifdef HAS_DYNAREC
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "chip8.h"
+#include "memory.h"
+
+#define CODE_SIZE (256 * 1024)  // Executable memory for all native code
+#define MAX_BLOCK_CODE (MAX_BLOCK_INSTRUCTIONS * 48 + 64)  // Worst case size
+#define MAX_BLOCK_SPAN (MAX_BLOCK_INSTRUCTIONS * 2 + 2)  // Most memory one block covers
+#define MIN_BLOCK_INSTRUCTIONS 2  // Shortest block worth entering natively
+#define EXIT_STUB 22   // The offset of the stub returning to C
+#define STUBS_SIZE 33  // The amount of bytes used by the stubs
+
+#define NO_BLOCK 0              // The address was not translated yet
+#define INTERPRETED UINT32_MAX  // The address has no native translation
+
+// Registers reserved by the native code for the whole time it runs. All of
+// them are callee-saved, so they are preserved by the entry trampoline.
+//   rbx - Pointer to the variable registers
+//   r12 - The remaining cycle budget
+//   r13 - Pointer to the program counter
+//   r14 - Pointer to the index register
+// rax and rcx are used as scratch registers within a single instruction.
+
+typedef uint64_t (*entry_function)(
+    uint8_t *V,
+    uint16_t *PC,
+    uint16_t *I,
+    uint64_t budget,
+    uint8_t *block);
+
+// MARK: Pages
+
+/**
+ * Finds the block translated from an address.
+ *
+ * @param cache The native code to search.
+ * @param address The address of the first instruction of the block.
+ * @return The offset of the block, INTERPRETED, or NO_BLOCK if nothing was
+ * translated from the address yet.
+ */
+static uint32_t find_block(const struct dynarec_cache *cache, uint16_t address)
+{
+    const struct dynarec_page *page = cache->pages[address / MEMORY_PAGE_SIZE];
+    return page != NULL ? page->blocks[address % MEMORY_PAGE_SIZE] : NO_BLOCK;
+}
+
+/**
+ * Records the block translated from an address.
+ *
+ * The page of the address must already be allocated.
+ *
+ * @param cache The native code containing the block.
+ * @param address The address of the first instruction of the block.
+ * @param block The offset of the block, or INTERPRETED.
+ */
+static void set_block(
+    struct dynarec_cache *cache,
+    uint16_t address,
+    uint32_t block)
+{
+    struct dynarec_page *page = cache->pages[address / MEMORY_PAGE_SIZE];
+    page->blocks[address % MEMORY_PAGE_SIZE] = block;
+}
+
+/**
+ * Marks a byte of memory as part of a translated block.
+ *
+ * The page of the address must already be allocated.
+ *
+ * @param cache The native code containing the block.
+ * @param address The address of the byte.
+ */
+static void mark_translated(struct dynarec_cache *cache, uint16_t address)
+{
+    struct dynarec_page *page = cache->pages[address / MEMORY_PAGE_SIZE];
+    page->translated[address % MEMORY_PAGE_SIZE] = true;
+}
+
+/**
+ * Allocates the pages of translations covering a range of memory.
+ *
+ * @param cache The native code to allocate the pages for.
+ * @param first The first address of the range.
+ * @param last The last address of the range, inclusive.
+ * @return If all of the pages could be allocated.
+ */
+static bool allocate_pages(
+    struct dynarec_cache *cache,
+    uint16_t first,
+    uint16_t last)
+{
+    for (uint8_t i = first / MEMORY_PAGE_SIZE; i <= last / MEMORY_PAGE_SIZE;
+         i++) {
+        if (cache->pages[i] == NULL) {
+            cache->pages[i] = calloc(1, sizeof(struct dynarec_page));
+            if (cache->pages[i] == NULL) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// MARK: Code emission
+
+static void emit8(struct dynarec_cache *cache, uint8_t byte)
+{
+    cache->code[cache->code_used++] = byte;
+}
+
+static void emit16(struct dynarec_cache *cache, uint16_t value)
+{
+    emit8(cache, value);
+    emit8(cache, value >> 8);
+}
+
+static void emit32(struct dynarec_cache *cache, uint32_t value)
+{
+    emit16(cache, value);
+    emit16(cache, value >> 16);
+}
+
+static void patch32(struct dynarec_cache *cache, uint32_t site, uint32_t value)
+{
+    memcpy(&cache->code[site], &value, sizeof(value));
+}
+
+// Points the rel32 operand of a jump at a target offset.
+static void patch_jump(
+    struct dynarec_cache *cache,
+    uint32_t site,
+    uint32_t target)
+{
+    patch32(cache, site, target - (site + 4));
+}
+
+// op byte [rbx + register], with the ModRM reg field as an opcode extension.
+static void emit_rbx_byte(
+    struct dynarec_cache *cache,
+    uint8_t opcode,
+    uint8_t extension,
+    uint8_t reg)
+{
+    emit8(cache, opcode);
+    emit8(cache, 0x43 | extension << 3);
+    emit8(cache, reg);
+}
+
+// movzx eax, byte [rbx + register]
+static void emit_load(struct dynarec_cache *cache, uint8_t reg)
+{
+    emit8(cache, 0x0F);
+    emit8(cache, 0xB6);
+    emit8(cache, 0x43);
+    emit8(cache, reg);
+}
+
+// op al, byte [rbx + register] or op byte [rbx + register], al
+static void emit_al_op(struct dynarec_cache *cache, uint8_t opcode, uint8_t reg)
+{
+    emit8(cache, opcode);
+    emit8(cache, 0x43);
+    emit8(cache, reg);
+}
+
+// setcc cl, followed by mov byte [rbx + 0xF], cl
+static void emit_set_vf(struct dynarec_cache *cache, uint8_t condition)
+{
+    emit8(cache, 0x0F);
+    emit8(cache, condition);
+    emit8(cache, 0xC1);
+    emit8(cache, 0x88);
+    emit8(cache, 0x4B);
+    emit8(cache, 0xF);
+}
+
+// mov byte [rbx + 0xF], 0
+static void emit_clear_vf(struct dynarec_cache *cache)
+{
+    emit_rbx_byte(cache, 0xC6, 0, 0xF);
+    emit8(cache, 0x00);
+}
+
+/**
+ * Emits a return to the dispatcher, continuing at an address.
+ *
+ * Stores the address in the program counter, then jumps to the exit stub.
+ * Always emits exactly 12 bytes.
+ *
+ * @param cache The native code to emit into.
+ * @param target The address of the next instruction to run.
+ * @return The offset of the rel32 operand of the jump.
+ */
+static uint32_t emit_return(struct dynarec_cache *cache, uint16_t target)
+{
+    // mov word [r13], target
+    emit8(cache, 0x66);
+    emit8(cache, 0x41);
+    emit8(cache, 0xC7);
+    emit8(cache, 0x45);
+    emit8(cache, 0x00);
+    emit16(cache, target);
+
+    // jmp rel32
+    emit8(cache, 0xE9);
+    uint32_t site = cache->code_used;
+    emit32(cache, 0);
+    patch_jump(cache, site, EXIT_STUB);
+    return site;
+}
+
+/**
+ * Emits an exit of a block towards the instruction at an address.
+ *
+ * Jumps straight to the block at that address if it is already translated,
+ * or returns to the dispatcher otherwise. Exits returning to the dispatcher
+ * are linked to their target once it is translated. Always emits exactly 12
+ * bytes.
+ *
+ * @param cache The native code to emit into.
+ * @param target The address of the next instruction to run.
+ */
+static void emit_exit(struct dynarec_cache *cache, uint16_t target)
+{
+    uint32_t site = emit_return(cache, target);
+
+    uint32_t block = find_block(cache, target);
+    if (block != NO_BLOCK && block != INTERPRETED) {
+        patch_jump(cache, site, block);
+    } else if (cache->pending_count < MAX_PENDING_LINKS) {
+        struct pending_link *link = &cache->pending_links[cache->pending_count];
+        link->target = target;
+        link->site = site;
+        cache->pending_count++;
+    }
+}
+
+/**
+ * Measures the instruction a skip at an address would skip.
+ *
+ * The skipped instruction becomes part of the block, so rewriting it into or
+ * out of F000 NNNN discards the skip's translation.
+ *
+ * @param vm The machine to translate for.
+ * @param address The address of the skip instruction.
+ * @param fetch The function providing decoded instructions to translate.
+ * @return The amount of bytes of the instruction that is skipped.
+ */
+static uint8_t skipped_length(
+    struct chip8_vm *vm,
+    uint16_t address,
+    dynarec_fetch fetch)
+{
+    uint16_t next = address + 2;
+    if (next > MEMORY_SIZE - 2) {
+        return 2;
+    }
+
+    mark_translated(vm->dynarec, next);
+    mark_translated(vm->dynarec, next + 1);
+    return fetch(vm, next)->op == OP_LD_I_LONG ? 4 : 2;
+}
+
+/**
+ * Emits a conditional skip, ending the block.
+ *
+ * Must directly follow an instruction setting the flags to compare.
+ *
+ * @param vm The machine to translate for.
+ * @param jump The short conditional jump opcode that is taken to skip.
+ * @param address The address of the skip instruction.
+ * @param fetch The function providing decoded instructions to translate.
+ */
+static void emit_skip(
+    struct chip8_vm *vm,
+    uint8_t jump,
+    uint16_t address,
+    dynarec_fetch fetch)
+{
+    struct dynarec_cache *cache = vm->dynarec;
+    uint8_t length = skipped_length(vm, address, fetch);
+    emit8(cache, jump);
+    emit8(cache, 12);  // Jump over the exit that does not skip.
+    emit_exit(cache, address + 2);
+    emit_exit(cache, address + 2 + length);
+}
+
+// MARK: Translation
+
+/**
+ * Allocates the executable memory and emits the shared stubs into it.
+ *
+ * @param cache The native code to allocate the memory for.
+ * @return If the memory could be allocated.
+ */
+static bool init_code(struct dynarec_cache *cache)
+{
+    void *memory = mmap(
+        NULL,
+        CODE_SIZE,
+        PROT_READ | PROT_WRITE | PROT_EXEC,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+    cache->code = memory;
+    cache->code_used = 0;
+
+    // The entry trampoline, matching entry_function.
+    emit8(cache, 0x53);  // push rbx
+    emit8(cache, 0x41);  // push r12
+    emit8(cache, 0x54);
+    emit8(cache, 0x41);  // push r13
+    emit8(cache, 0x55);
+    emit8(cache, 0x41);  // push r14
+    emit8(cache, 0x56);
+    emit8(cache, 0x48);  // mov rbx, rdi
+    emit8(cache, 0x89);
+    emit8(cache, 0xFB);
+    emit8(cache, 0x49);  // mov r13, rsi
+    emit8(cache, 0x89);
+    emit8(cache, 0xF5);
+    emit8(cache, 0x49);  // mov r14, rdx
+    emit8(cache, 0x89);
+    emit8(cache, 0xD6);
+    emit8(cache, 0x49);  // mov r12, rcx
+    emit8(cache, 0x89);
+    emit8(cache, 0xCC);
+    emit8(cache, 0x41);  // jmp r8
+    emit8(cache, 0xFF);
+    emit8(cache, 0xE0);
+
+    // The exit stub, returning the remaining budget.
+    emit8(cache, 0x4C);  // mov rax, r12
+    emit8(cache, 0x89);
+    emit8(cache, 0xE0);
+    emit8(cache, 0x41);  // pop r14
+    emit8(cache, 0x5E);
+    emit8(cache, 0x41);  // pop r13
+    emit8(cache, 0x5D);
+    emit8(cache, 0x41);  // pop r12
+    emit8(cache, 0x5C);
+    emit8(cache, 0x5B);  // pop rbx
+    emit8(cache, 0xC3);  // ret
+
+    return true;
+}
+
+/**
+ * Allocates the native code of a machine.
+ *
+ * @param vm The machine to allocate the native code for.
+ * @return If the native code could be allocated.
+ */
+static bool init_cache(struct chip8_vm *vm)
+{
+    struct dynarec_cache *cache = calloc(1, sizeof(struct dynarec_cache));
+    if (cache == NULL) {
+        return false;
+    }
+    if (!init_code(cache)) {
+        free(cache);
+        return false;
+    }
+
+    vm->dynarec = cache;
+    return true;
+}
+
+/**
+ * Discards all translated blocks.
+ *
+ * @param cache The native code to discard.
+ */
+static void flush(struct dynarec_cache *cache)
+{
+    cache->code_used = STUBS_SIZE;
+    cache->pending_count = 0;
+    for (uint8_t i = 0; i < MEMORY_PAGES; i++) {
+        if (cache->pages[i] != NULL) {
+            memset(cache->pages[i], 0, sizeof(struct dynarec_page));
+        }
+    }
+}
+
+/**
+ * Links the exits of other blocks waiting for a newly translated block.
+ *
+ * @param cache The native code containing the block.
+ * @param address The address of the translated block.
+ * @param block The offset of the translated block.
+ */
+static void link_pending(
+    struct dynarec_cache *cache,
+    uint16_t address,
+    uint32_t block)
+{
+    for (uint16_t i = 0; i < cache->pending_count;) {
+        if (cache->pending_links[i].target == address) {
+            patch_jump(cache, cache->pending_links[i].site, block);
+            uint16_t last = --cache->pending_count;
+            cache->pending_links[i] = cache->pending_links[last];
+        } else {
+            i++;
+        }
+    }
+}
+
+/**
+ * Translates the block of instructions starting at an address.
+ *
+ * @param vm The machine whose memory to translate.
+ * @param address The address of the first instruction of the block.
+ * @param fetch The function providing decoded instructions to translate.
+ * @return The offset of the block, or INTERPRETED if the first instruction has
+ * no native translation.
+ */
+static uint32_t translate(
+    struct chip8_vm *vm,
+    uint16_t address,
+    dynarec_fetch fetch)
+{
+    struct dynarec_cache *cache = vm->dynarec;
+    if (CODE_SIZE - cache->code_used < MAX_BLOCK_CODE) {
+        flush(cache);
+    }
+
+    // Every page the block could mark is allocated up front, so translating
+    // never fails halfway through it.
+    uint32_t end = (uint32_t)address + MAX_BLOCK_SPAN;
+    if (!allocate_pages(
+            cache, address, end < MEMORY_SIZE ? end - 1 : MEMORY_SIZE - 1)) {
+        return INTERPRETED;
+    }
+
+    uint32_t block = cache->code_used;
+
+    // Bail out to the interpreter if the block does not fit in the budget.
+    // The instruction count is filled in once the block is complete.
+    emit8(cache, 0x49);  // cmp r12, imm32
+    emit8(cache, 0x81);
+    emit8(cache, 0xFC);
+    uint32_t count_check = cache->code_used;
+    emit32(cache, 0);
+    emit8(cache, 0x73);  // jae rel8
+    emit8(cache, 12);
+    emit_return(cache, address);
+    emit8(cache, 0x49);  // sub r12, imm32
+    emit8(cache, 0x81);
+    emit8(cache, 0xEC);
+    uint32_t count_subtract = cache->code_used;
+    emit32(cache, 0);
+
+    uint32_t count = 0;
+    uint16_t pc = address;
+    bool ended = false;
+
+    while (!ended) {
+        // Stop at instructions the block can not hold, and let the dispatcher
+        // continue from there.
+        if (count == MAX_BLOCK_INSTRUCTIONS || pc > MEMORY_SIZE - 2) {
+            emit_exit(cache, pc);
+            break;
+        }
+
+        struct decoded_instruction *d = fetch(vm, pc);
+        uint8_t x = d->x;
+        uint8_t y = d->y;
+
+        switch (d->op) {
+            case OP_LD_VX_NN:  // mov byte [rbx + x], nn
+                emit_rbx_byte(cache, 0xC6, 0, x);
+                emit8(cache, d->nn);
+                break;
+            case OP_ADD_VX_NN:  // add byte [rbx + x], nn
+                emit_rbx_byte(cache, 0x80, 0, x);
+                emit8(cache, d->nn);
+                break;
+            case OP_LD_VX_VY:
+                emit_load(cache, y);
+                emit_al_op(cache, 0x88, x);  // mov [rbx + x], al
+                break;
+            case OP_OR:
+                emit_load(cache, y);
+                emit_al_op(cache, 0x08, x);  // or [rbx + x], al
+                break;
+            case OP_OR_VF_RESET:
+                emit_load(cache, y);
+                emit_al_op(cache, 0x08, x);  // or [rbx + x], al
+                emit_clear_vf(cache);
+                break;
+            case OP_AND:
+                emit_load(cache, y);
+                emit_al_op(cache, 0x20, x);  // and [rbx + x], al
+                break;
+            case OP_AND_VF_RESET:
+                emit_load(cache, y);
+                emit_al_op(cache, 0x20, x);  // and [rbx + x], al
+                emit_clear_vf(cache);
+                break;
+            case OP_XOR:
+                emit_load(cache, y);
+                emit_al_op(cache, 0x30, x);  // xor [rbx + x], al
+                break;
+            case OP_XOR_VF_RESET:
+                emit_load(cache, y);
+                emit_al_op(cache, 0x30, x);  // xor [rbx + x], al
+                emit_clear_vf(cache);
+                break;
+            case OP_ADD_VX_VY:
+                emit_load(cache, x);
+                emit_al_op(cache, 0x02, y);  // add al, [rbx + y]
+                emit_al_op(cache, 0x88, x);  // mov [rbx + x], al
+                emit_al_op(cache, 0x3A, y);  // cmp al, [rbx + y]
+                emit_set_vf(cache, 0x96);    // setbe
+                break;
+            case OP_SUB_VY_VX:
+                emit_load(cache, y);
+                emit_al_op(cache, 0x3A, x);  // cmp al, [rbx + x]
+                emit_set_vf(cache, 0x97);    // seta
+                emit_load(cache, y);
+                emit_al_op(cache, 0x2A, x);  // sub al, [rbx + x]
+                emit_al_op(cache, 0x88, x);  // mov [rbx + x], al
+                break;
+            case OP_SUB_VX_VY:
+                emit_load(cache, x);
+                emit_al_op(cache, 0x3A, y);  // cmp al, [rbx + y]
+                emit_set_vf(cache, 0x97);    // seta
+                emit_load(cache, x);
+                emit_al_op(cache, 0x2A, y);  // sub al, [rbx + y]
+                emit_al_op(cache, 0x88, x);  // mov [rbx + x], al
+                break;
+            case OP_SHR_VY:
+                emit_load(cache, y);
+                emit_al_op(cache, 0x88, x);  // mov [rbx + x], al
+                // Fall through - the copy is shifted in place.
+            case OP_SHR:
+                emit_load(cache, x);
+                emit8(cache, 0x24);  // and al, 1
+                emit8(cache, 0x01);
+                emit_al_op(cache, 0x88, 0xF);      // mov [rbx + 0xF], al
+                emit_rbx_byte(cache, 0xD0, 5, x);  // shr byte [rbx + x], 1
+                break;
+            case OP_SHL_VY:
+                emit_load(cache, y);
+                emit_al_op(cache, 0x88, x);  // mov [rbx + x], al
+                // Fall through - the copy is shifted in place.
+            case OP_SHL:
+                emit_load(cache, x);
+                emit8(cache, 0xC0);  // shr al, 7
+                emit8(cache, 0xE8);
+                emit8(cache, 0x07);
+                emit_al_op(cache, 0x88, 0xF);      // mov [rbx + 0xF], al
+                emit_rbx_byte(cache, 0xD0, 4, x);  // shl byte [rbx + x], 1
+                break;
+            case OP_LD_I:  // mov word [r14], nnn
+                emit8(cache, 0x66);
+                emit8(cache, 0x41);
+                emit8(cache, 0xC7);
+                emit8(cache, 0x06);
+                emit16(cache, d->nnn);
+                break;
+            case OP_JP:
+                emit_exit(cache, d->nnn);
+                ended = true;
+                break;
+            case OP_SE_VX_NN:  // cmp byte [rbx + x], nn
+                emit_rbx_byte(cache, 0x80, 7, x);
+                emit8(cache, d->nn);
+                emit_skip(vm, 0x74, pc, fetch);  // je
+                ended = true;
+                break;
+            case OP_SNE_VX_NN:  // cmp byte [rbx + x], nn
+                emit_rbx_byte(cache, 0x80, 7, x);
+                emit8(cache, d->nn);
+                emit_skip(vm, 0x75, pc, fetch);  // jne
+                ended = true;
+                break;
+            case OP_SE_VX_VY:
+                emit_load(cache, x);
+                emit_al_op(cache, 0x3A, y);  // cmp al, [rbx + y]
+                emit_skip(vm, 0x74, pc, fetch);  // je
+                ended = true;
+                break;
+            case OP_SNE_VX_VY:
+                emit_load(cache, x);
+                emit_al_op(cache, 0x3A, y);  // cmp al, [rbx + y]
+                emit_skip(vm, 0x75, pc, fetch);  // jne
+                ended = true;
+                break;
+            default:
+                // Everything else is left to the interpreter. Blocks too short
+                // to make up for entering native code are discarded, so the
+                // interpreter runs their instructions instead.
+                if (count < MIN_BLOCK_INSTRUCTIONS) {
+                    cache->code_used = block;
+                    set_block(cache, address, INTERPRETED);
+                    return INTERPRETED;
+                }
+                emit_exit(cache, pc);
+                ended = true;
+                continue;
+        }
+
+        mark_translated(cache, pc);
+        mark_translated(cache, pc + 1);
+        count++;
+        pc += 2;
+    }
+
+    patch32(cache, count_check, count);
+    patch32(cache, count_subtract, count);
+
+    set_block(cache, address, block);
+    link_pending(cache, address, block);
+    return block;
+}
+
+bool run_dynarec(
+    struct chip8_vm *vm,
+    uint16_t address,
+    uint64_t *budget,
+    dynarec_fetch fetch)
+{
+    if (vm->dynarec == NULL && !init_cache(vm)) {
+        return false;
+    }
+
+    struct dynarec_cache *cache = vm->dynarec;
+    uint32_t block = find_block(cache, address);
+    if (block == NO_BLOCK) {
+        block = translate(vm, address, fetch);
+    }
+    if (block == INTERPRETED) {
+        return false;
+    }
+
+    entry_function enter = (entry_function)cache->code;
+    *budget = enter(vm->V, &vm->PC, &vm->I, *budget, cache->code + block);
+    return true;
+}
+
+void invalidate_dynarec(
+    struct chip8_vm *vm,
+    uint16_t address,
+    uint32_t length)
+{
+    struct dynarec_cache *cache = vm->dynarec;
+    if (cache == NULL) {
+        return;
+    }
+
+    // Instructions starting just before the range also read from it.
+    uint16_t first = address > 0 ? address - 1 : 0;
+    uint32_t last = (uint32_t)address + length;
+    if (last > MEMORY_SIZE) {
+        last = MEMORY_SIZE;
+    }
+
+    // Pages nothing was translated from yet hold nothing to invalidate.
+    for (uint32_t i = first; i < last; i++) {
+        struct dynarec_page *page = cache->pages[i / MEMORY_PAGE_SIZE];
+        if (page == NULL) {
+            i |= MEMORY_PAGE_SIZE - 1;
+        } else if (page->blocks[i % MEMORY_PAGE_SIZE] == INTERPRETED) {
+            page->blocks[i % MEMORY_PAGE_SIZE] = NO_BLOCK;
+        }
+    }
+
+    for (uint32_t i = address; i < last; i++) {
+        struct dynarec_page *page = cache->pages[i / MEMORY_PAGE_SIZE];
+        if (page == NULL) {
+            i |= MEMORY_PAGE_SIZE - 1;
+        } else if (page->translated[i % MEMORY_PAGE_SIZE]) {
+            flush(cache);
+            return;
+        }
+    }
+}
+
+void free_dynarec(struct chip8_vm *vm)
+{
+    struct dynarec_cache *cache = vm->dynarec;
+    if (cache == NULL) {
+        return;
+    }
+
+    munmap(cache->code, CODE_SIZE);
+    for (uint8_t i = 0; i < MEMORY_PAGES; i++) {
+        free(cache->pages[i]);
+    }
+    free(cache);
+    vm->dynarec = NULL;
+}
+#endif  // HAS_DYNAREC
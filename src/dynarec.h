@@ -0,0 +1,115 @@
+#ifndef DYNAREC_H_
+#define DYNAREC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "memory.h"
+
+// Native code is only generated for x86-64 hosts using the System V calling
+// convention, with mmap available to allocate executable memory. Profiled
+// builds leave it out, as native code would bypass the counters, so the
+// dynarec core falls back to the table core.
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__)) && \
+    !defined(CHIP8_PROFILE)
+#define HAS_DYNAREC
+#endif  // __x86_64__ && (__linux__ || __APPLE__) && !CHIP8_PROFILE
+
+#define MAX_BLOCK_INSTRUCTIONS 64  // Longest run of instructions per block
+#define MAX_PENDING_LINKS 1024  // Exits waiting for their target's translation
+
+struct chip8_vm;
+
+/**
+ * A function providing the decoded instruction at an address of memory.
+ *
+ * @param vm The machine to decode from.
+ * @param address The memory address of the instruction.
+ * @return The decoded instruction.
+ */
+typedef struct decoded_instruction *(*dynarec_fetch)(
+    struct chip8_vm *vm,
+    uint16_t address);
+
+#ifdef HAS_DYNAREC
+// An exit of a block which can be linked once its target is translated.
+struct pending_link {
+    uint16_t target;  // The address the exit jumps to
+    uint32_t site;    // The offset of the rel32 operand of the exit's jump
+};
+
+// The translations of a single page of memory.
+struct dynarec_page {
+    // Offsets of translated blocks in the executable memory, by their address.
+    uint32_t blocks[MEMORY_PAGE_SIZE];
+    // Which addresses of memory are part of any translated block.
+    bool translated[MEMORY_PAGE_SIZE];
+};
+
+// The native code translated from the memory of a single machine.
+struct dynarec_cache {
+    uint8_t *code;       // The executable memory, starting with the stubs
+    uint32_t code_used;  // The amount of bytes of it used so far
+
+    // The translations by page of memory, allocated as blocks are translated
+    // from them.
+    struct dynarec_page *pages[MEMORY_PAGES];
+
+    struct pending_link pending_links[MAX_PENDING_LINKS];
+    uint16_t pending_count;
+};
+
+/**
+ * Runs native code for the block of instructions starting at an address.
+ *
+ * Allocates the native code of the machine on first use, and translates the
+ * block first if it was not yet translated. Blocks end at any
+ * instruction that changes control flow, or that has no native translation,
+ * after which the next block is jumped to directly if it is already
+ * translated. Execution continues until a block without a translated
+ * successor is exited, or the next block does not fit in the cycle budget.
+ *
+ * Nothing is run if the instruction at the address has no native
+ * translation, if its block does not fit in the budget, or if memory for its
+ * translation ran out, in which case it has to be run by the interpreter
+ * instead.
+ *
+ * @param vm The machine to run.
+ * @param address The memory address of the first instruction to run.
+ * @param budget The maximum amount of CPU cycles to run, reduced by the amount
+ * of cycles that were run.
+ * @param fetch The function providing decoded instructions to translate.
+ * @return If the instruction at the address has a native translation.
+ */
+bool run_dynarec(
+    struct chip8_vm *vm,
+    uint16_t address,
+    uint64_t *budget,
+    dynarec_fetch fetch);
+
+/**
+ * Invalidates any native code translated from a range of memory.
+ *
+ * As blocks jump into each other directly, invalidating a single block would
+ * require unlinking all of its predecessors, so all native code is discarded
+ * when the range overlaps any of it.
+ *
+ * @param vm The machine whose memory was written to.
+ * @param address The first memory address that was written to.
+ * @param length The amount of consecutive bytes that were written.
+ */
+void invalidate_dynarec(
+    struct chip8_vm *vm,
+    uint16_t address,
+    uint32_t length);
+
+/**
+ * Releases the native code of a machine, along with its executable memory.
+ *
+ * @param vm The machine whose native code to release.
+ */
+void free_dynarec(struct chip8_vm *vm);
+#endif  // HAS_DYNAREC
+
+#endif  // !DYNAREC_H_
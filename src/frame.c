@@ -0,0 +1,63 @@
+#include "frame.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "keypad.h"
+
+#define FRESH_FRAME 0x80  // Set in the middle slot until the renderer takes it
+#define SLOT_MASK 0x03
+
+void init_frame_buffer(struct frame_buffer *buffer)
+{
+    memset(buffer->frames, 0, sizeof(buffer->frames));
+    buffer->back = 0;
+    atomic_init(&buffer->middle, 1);
+    buffer->front = 2;
+    buffer->version = 0;
+}
+
+void publish_frame(struct frame_buffer *buffer, struct chip8_vm *vm)
+{
+    if (vm->display_dirty) {
+        buffer->version++;
+        vm->display_dirty = false;
+    }
+
+    struct frame *frame = &buffer->frames[buffer->back];
+    memcpy(frame->display, vm->display, sizeof(frame->display));
+    frame->version = buffer->version;
+    frame->keys = vm->keypad.keys;
+    frame->hires = vm->hires;
+    frame->idle = is_blocked_on_keys(vm);
+
+    // Releasing the frame makes it visible to the renderer in full, and
+    // acquiring the old middle slot ensures the renderer is done with it.
+    uint8_t middle = atomic_exchange_explicit(
+        &buffer->middle,
+        buffer->back | FRESH_FRAME,
+        memory_order_acq_rel);
+    buffer->back = middle & SLOT_MASK;
+}
+
+const struct frame *take_frame(struct frame_buffer *buffer, bool *fresh)
+{
+    bool swapped = false;
+    if (atomic_load_explicit(&buffer->middle, memory_order_relaxed) &
+        FRESH_FRAME) {
+        uint8_t middle = atomic_exchange_explicit(
+            &buffer->middle,
+            buffer->front,
+            memory_order_acq_rel);
+        buffer->front = middle & SLOT_MASK;
+        swapped = true;
+    }
+
+    if (fresh != NULL) {
+        *fresh = swapped;
+    }
+    return &buffer->frames[buffer->front];
+}
@@ -0,0 +1,71 @@
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "display.h"
+
+#define FRAME_SLOTS 3  // Back, middle and front, see struct frame_buffer
+
+struct chip8_vm;
+
+// A completed emulated frame, as much of the machine as it takes to present.
+struct frame {
+    uint64_t display[PLANE_COUNT][HIRES_SCREEN_HEIGHT][ROW_WORDS];
+    uint64_t version;  // Counts up whenever the display changed
+    uint16_t keys;     // The keys held down as of the frame
+    bool hires;        // If the display is in high resolution
+    bool idle;         // If the CPU waits for a key, with no timer running
+};
+
+// Hands completed frames from the emulation thread to the render thread
+// without either of them ever waiting for the other.
+//
+// The emulation writes into the back slot, which only it touches, and swaps
+// it with the middle slot once complete. The renderer swaps the middle slot
+// with its front slot whenever it holds a newer frame, and reads the front
+// slot at its leisure. Frames the renderer did not get to in between are
+// simply overwritten, so it always presents the newest one.
+struct frame_buffer {
+    struct frame frames[FRAME_SLOTS];
+    _Atomic uint8_t middle;  // The middle slot, and if it holds a new frame
+    uint8_t back;            // Only touched by the emulation thread
+    uint8_t front;           // Only touched by the render thread
+    uint64_t version;        // The version of the last published display
+};
+
+/**
+ * Initializes a frame buffer with a blank frame.
+ *
+ * @param buffer The frame buffer to initialize.
+ */
+void init_frame_buffer(struct frame_buffer *buffer);
+
+/**
+ * Publishes the display of a machine as the newest frame, on the emulation
+ * thread.
+ *
+ * Copies the display into the back slot, and swaps it into the middle, which
+ * never blocks. The display version only counts up if the CPU changed the
+ * display since the last frame was published.
+ *
+ * @param buffer The frame buffer to publish to.
+ * @param vm The machine whose display to publish.
+ */
+void publish_frame(struct frame_buffer *buffer, struct chip8_vm *vm);
+
+/**
+ * Takes the newest published frame, on the render thread.
+ *
+ * Never blocks. The frame stays valid and unchanged until the next call.
+ *
+ * @param buffer The frame buffer to take from.
+ * @param fresh If a frame was published since the last call, otherwise the
+ * same frame is returned again. May be NULL.
+ * @return The newest frame.
+ */
+const struct frame *take_frame(struct frame_buffer *buffer, bool *fresh);
+
+#endif  // !FRAME_H_
@@ -0,0 +1,82 @@
+#include "headless.h"
+
+#include <stdint.h>
+
+#include "chip8.h"
+#include "clock.h"
+#include "cpu.h"
+#include "display.h"
+#include "keypad.h"
+#include "movie.h"
+#include "profile.h"
+#include "scheduler.h"
+
+// How many cycles to run between checks of the wall-clock budget, as reading
+// the clock is much more expensive than a CPU cycle.
+#define CLOCK_CHECK_INTERVAL 4096
+
+struct headless_result run_headless(
+    struct chip8_vm *vm,
+    struct headless_budget budget)
+{
+    struct headless_result result = {.cycles = 0, .seconds = 0};
+    result.status.code = SUCCESS;
+    result.status.instruction = 0x0000;
+
+    // Convert the frame budget to cycles, as frames are an emulated concept
+    // without a host frame to pace them.
+    uint64_t max_cycles = budget.cycles;
+    if (budget.frames) {
+        uint64_t frame_cycles = frames_to_cycles(vm, budget.frames);
+        if (!max_cycles || frame_cycles < max_cycles) {
+            max_cycles = frame_cycles;
+        }
+    }
+
+    double start = read_clock();
+    double deadline = start + budget.seconds;
+
+    while (!max_cycles || result.cycles < max_cycles) {
+        uint64_t chunk = CLOCK_CHECK_INTERVAL;
+        if (max_cycles && max_cycles - result.cycles < chunk) {
+            chunk = max_cycles - result.cycles;
+        }
+
+        result.cycles += run_scheduled(vm, chunk, &result.status);
+        PROFILE_POLL(vm);
+        if (result.status.code) {
+            break;
+        }
+
+        if (budget.seconds && read_clock() >= deadline) {
+            break;
+        }
+    }
+
+    result.seconds = read_clock() - start;
+    return result;
+}
+
+struct headless_result play_headless(
+    struct chip8_vm *vm,
+    struct movie *movie)
+{
+    struct headless_result result = {.cycles = 0, .seconds = 0};
+    result.status.code = SUCCESS;
+    result.status.instruction = 0x0000;
+
+    double start = read_clock();
+    uint16_t keys;
+    while (next_keys(movie, &keys)) {
+        struct cpu_status status;
+        set_keys(vm, keys);
+        result.cycles += run_frame(vm, &status);
+        PROFILE_POLL(vm);
+        if (status.code) {
+            result.status = status;
+        }
+    }
+
+    result.seconds = read_clock() - start;
+    return result;
+}
@@ -0,0 +1,53 @@
+#ifndef HEADLESS_H_
+#define HEADLESS_H_
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+struct chip8_vm;
+struct movie;
+
+struct headless_budget {
+    uint64_t cycles;  // The maximum amount of CPU cycles, or 0 for none.
+    uint64_t frames;  // The maximum amount of emulated frames, or 0 for none.
+    double seconds;   // The maximum wall-clock time, or 0 for none.
+};
+
+struct headless_result {
+    uint64_t cycles;           // The amount of CPU cycles that were executed.
+    double seconds;            // The wall-clock time spent executing them.
+    struct cpu_status status;  // The status of the last executed CPU cycle.
+};
+
+/**
+ * Runs the loaded program without presenting it, as fast as the host allows.
+ *
+ * Execution stops as soon as any of the limits of the budget is reached, or
+ * the CPU reports an error. At least one limit must be set, as the program
+ * would otherwise never stop.
+ *
+ * @param vm The machine to run, with a program already loaded.
+ * @param budget The limits after which execution should stop.
+ * @return Meta information about the run, used to report the throughput.
+ */
+struct headless_result run_headless(
+    struct chip8_vm *vm,
+    struct headless_budget budget);
+
+/**
+ * Plays a movie back into the loaded program, as fast as the host allows.
+ *
+ * Every frame of the movie runs, even past CPU errors, as the recording kept
+ * running through them as well.
+ *
+ * @param vm The machine to play back into, with playback already started.
+ * @param movie The movie to play back.
+ * @return Meta information about the run, with the status of the last CPU
+ * error, if any.
+ */
+struct headless_result play_headless(
+    struct chip8_vm *vm,
+    struct movie *movie);
+
+#endif  // !HEADLESS_H_
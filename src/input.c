@@ -0,0 +1,39 @@
+#include "input.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "keypad.h"
+#include "raylib.h"
+
+// The Raylib key of every keypad key. Raylib numbers the letter and digit
+// keys by their uppercase ASCII characters.
+static int keys[KEYPAD_KEYS];
+
+bool set_key_layout(const char *layout)
+{
+    if (strlen(layout) != KEYPAD_KEYS) {
+        return false;
+    }
+    for (uint8_t i = 0; i < KEYPAD_KEYS; i++) {
+        if (!isalnum((unsigned char)layout[i])) {
+            return false;
+        }
+    }
+
+    for (uint8_t i = 0; i < KEYPAD_KEYS; i++) {
+        keys[i] = toupper((unsigned char)layout[i]);
+    }
+    return true;
+}
+
+uint16_t poll_keypad()
+{
+    uint16_t mask = 0;
+    for (uint8_t i = 0; i < KEYPAD_KEYS; i++) {
+        mask |= (uint16_t)IsKeyDown(keys[i]) << i;
+    }
+    return mask;
+}
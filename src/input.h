@@ -0,0 +1,36 @@
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The host keys of the keypad keys 0 through F, in order. Maps the left side
+// of a QWERTY keyboard onto the layout of the COSMAC VIP's keypad:
+//
+//   1 2 3 4        1 2 3 C
+//   Q W E R   ->   4 5 6 D
+//   A S D F        7 8 9 E
+//   Z X C V        A 0 B F
+#define DEFAULT_KEY_LAYOUT "X123QWEASDZC4RFV"
+
+/**
+ * Selects the host keys the keypad is mapped to.
+ *
+ * @param layout The letters or digits of the host keys of the keypad keys 0
+ * through F, in order, such as DEFAULT_KEY_LAYOUT.
+ * @return If the layout named 16 letters or digits, otherwise the previous
+ * layout is kept.
+ */
+bool set_key_layout(const char *layout);
+
+/**
+ * Samples which keypad keys the host holds down.
+ *
+ * Should be called exactly once per host frame, on the thread owning the
+ * window, so the CPU never queries Raylib itself.
+ *
+ * @return The keys held down, with bit N set for key N, as set_keys() takes.
+ */
+uint16_t poll_keypad();
+
+#endif  // !INPUT_H_
@@ -0,0 +1,51 @@
+#include "keypad.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "memory.h"
+
+void set_keys(struct chip8_vm *vm, uint16_t keys)
+{
+    // Releases accumulate, as a host frame does not always run a timer tick.
+    vm->keypad.released |= vm->keypad.keys & ~keys;
+    vm->keypad.keys = keys;
+}
+
+bool is_key_down(const struct chip8_vm *vm, uint8_t key)
+{
+    return (vm->keypad.keys >> (key & 0x0F)) & 1;
+}
+
+bool take_released_key(struct chip8_vm *vm, uint8_t *key)
+{
+    uint16_t released = vm->keypad.released;
+    if (released == 0) {
+        return false;
+    }
+
+    uint8_t lowest = 0;
+    while (!(released & 1)) {
+        released >>= 1;
+        lowest++;
+    }
+    *key = lowest;
+    vm->keypad.released = 0;
+    return true;
+}
+
+bool is_waiting_for_key(const struct chip8_vm *vm)
+{
+    uint16_t pc = vm->PC;
+    if (vm->keypad.released != 0 || pc > MEMORY_SIZE - 2) {
+        return false;
+    }
+    return (vm->memory[pc] & 0xF0) == 0xF0 && vm->memory[pc + 1] == 0x0A;
+}
+
+bool is_blocked_on_keys(const struct chip8_vm *vm)
+{
+    return is_waiting_for_key(vm) && vm->delay_timer == 0 &&
+           vm->sound_timer == 0;
+}
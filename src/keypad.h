@@ -0,0 +1,77 @@
+#ifndef KEYPAD_H_
+#define KEYPAD_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define KEYPAD_KEYS 16  // The hexadecimal keys 0 through F
+
+struct chip8_vm;
+
+// The hexadecimal keypad, as bit masks with a bit per key.
+//
+// The host samples its input into the keypad once per host frame, so the CPU
+// only ever tests bits rather than querying the host per instruction. Neither
+// mask is part of save states, as they hold host input rather than state of
+// the machine.
+struct keypad {
+    uint16_t keys;      // The keys held down as of the last sample
+    uint16_t released;  // The keys released since the last timer tick
+};
+
+/**
+ * Samples the keys the host holds down.
+ *
+ * Should be called once per host frame, before the CPU cycles of that frame
+ * run. Keys released since the last sample wake a CPU blocked on 0xFX0A, up
+ * until the next timer tick.
+ *
+ * @param vm The machine whose keypad to update.
+ * @param keys The keys held down, with bit N set for key N.
+ */
+void set_keys(struct chip8_vm *vm, uint16_t keys);
+
+/**
+ * Checks if a key is held down.
+ *
+ * @param vm The machine whose keypad to check.
+ * @param key The key to check, of which only the lowest nibble is used.
+ * @return If the key was held down as of the last sample.
+ */
+bool is_key_down(const struct chip8_vm *vm, uint8_t key);
+
+/**
+ * Takes the lowest key released since the last timer tick.
+ *
+ * Every other release is dropped along with it, so a single release never
+ * satisfies two waits for a key.
+ *
+ * @param vm The machine whose keypad to check.
+ * @param key The key that was released.
+ * @return If any key was released.
+ */
+bool take_released_key(struct chip8_vm *vm, uint8_t *key);
+
+/**
+ * Checks if the CPU is blocked on 0xFX0A without a key to wake it.
+ *
+ * Nothing but the next sample of the keypad can unblock the CPU, so running
+ * it before then only spends host time.
+ *
+ * @param vm The machine to inspect.
+ * @return If the program counter points at 0xFX0A, and no key was released.
+ */
+bool is_waiting_for_key(const struct chip8_vm *vm);
+
+/**
+ * Checks if nothing but a change of the keys can change the machine any more.
+ *
+ * Holds while the CPU waits for a key with both timers stopped, as every tick
+ * then leaves the machine as it was.
+ *
+ * @param vm The machine to inspect.
+ * @return If the CPU waits for a key, and neither timer runs.
+ */
+bool is_blocked_on_keys(const struct chip8_vm *vm);
+
+#endif  // !KEYPAD_H_
@@ -1,40 +1,721 @@
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "chip8.h"
 #include "cpu.h"
 #include "display.h"
+#include "frame.h"
+#include "headless.h"
+#include "input.h"
+#include "keypad.h"
+#include "movie.h"
+#include "profile.h"
+#include "quirks.h"
+#include "rewind.h"
+#include "rng.h"
+#include "scheduler.h"
+#include "sound.h"
+#include "state.h"
+#include "window.h"
+
+#ifndef HEADLESS
+#include <pthread.h>
+
 #include "raylib.h"
+#endif  // !HEADLESS
 
-int main(int argc, char **argv)
+// The most host time to catch up on at once, so a stalled emulation thread,
+// such as after the host was suspended, skips ahead instead of running a burst
+// of ticks.
+#define MAX_PENDING_SECONDS 0.25
+
+#define FAST_FORWARD_KEY KEY_TAB  // Toggles fast-forwarding
+#define REWIND_KEY KEY_BACKSPACE  // Steps back while held
+#define REPORT_INTERVAL 0.5       // Seconds between speed-up reports
+
+// How the windowed front end runs ahead of real time.
+struct fast_forward {
+    bool active;      // If emulation currently runs ahead of real time
+    uint32_t speed;   // How many times as fast, or 0 for as fast as possible
+    uint64_t first;   // Emulated frames run before fast-forwarding started
+    double started;   // Host time at which fast-forwarding started
+    double reported;  // Host time at which the speed-up was last reported
+};
+
+// What the emulation does with its movie.
+enum movie_mode {
+    MOVIE_NONE,       // There is no movie, or it is over
+    MOVIE_RECORDING,  // The keys of every frame are recorded
+    MOVIE_PLAYING,    // The keys of every frame are played back
+};
+
+#ifndef HEADLESS
+// What the window shares with the emulation thread.
+//
+// The machine and its history belong to the emulation thread until it is
+// joined. Everything else passes between the two threads without locks, so
+// neither ever waits for the other, except for the emulation thread parking
+// while only a key can change the machine, until the window's input changes.
+struct emulation {
+    struct chip8_vm *vm;          // The machine to run
+    struct rewind *r;             // The history to record frames into
+    struct movie *movie;          // The movie to record or play back
+    enum movie_mode mode;         // What is done with the movie
+    struct frame_buffer frames;   // Completed frames, for the window
+    _Atomic uint16_t keys;        // The keys the window holds down
+    _Atomic uint32_t speed;       // Times real time, or 0 for uncapped
+    _Atomic bool rewinding;       // If the window holds the rewind key
+    _Atomic bool running;         // Cleared to stop the emulation thread
+    _Atomic uint64_t frames_run;  // Emulated frames run so far
+    pthread_mutex_t lock;         // Held to park or wake the emulation
+    pthread_cond_t woken;         // Signaled when the window's input changes
+};
+#endif  // !HEADLESS
+
+#ifdef CHIP8_PROFILE
+#define PROFILE_USAGE "  --profile FILE  Write the execution profile to FILE.\n"
+#else
+#define PROFILE_USAGE ""
+#endif  // CHIP8_PROFILE
+
+// Options of the window, which headless builds have no use for.
+#ifdef HEADLESS
+#define WINDOW_USAGE ""
+#else
+#define WINDOW_USAGE                                                           \
+    "  --fast-forward  Start fast-forwarded, which Tab toggles at any time.\n" \
+    "  --ff-speed N    Fast-forward N times as fast, or uncapped if 0.\n"      \
+    "  --rewind-mb N   Keep N MB of history to rewind with Backspace.\n"       \
+    "  --rewind-gap N  Frames between rewind snapshots (default 1).\n"         \
+    "  --scale N       Open the window at N times the screen size.\n"          \
+    "  --fit           Fill the window instead of scaling by whole steps.\n"   \
+    "  --fg RRGGBB     Color of active pixels.\n"                              \
+    "  --bg RRGGBB     Color of inactive pixels.\n"                            \
+    "  --fg2 RRGGBB    Color of pixels only in the second XO-CHIP plane.\n"    \
+    "  --blend RRGGBB  Color of pixels in both XO-CHIP planes.\n"              \
+    "  --keys KEYS     Host keys of the keypad keys 0 to F, as 16 letters.\n"  \
+    "  --mute          Run without sound.\n"
+#endif  // HEADLESS
+
+#define USAGE                                                                  \
+    "Usage: %s [options] ROM\n"                                                \
+    "\n"                                                                       \
+    "  --headless      Run without a window, as fast as possible.\n"           \
+    "  --cycles N      Stop a headless run after N CPU cycles.\n"              \
+    "  --frames N      Stop a headless run after N emulated frames.\n"         \
+    "  --seconds S     Stop a headless run after S seconds of wall time.\n"    \
+    "  --core NAME     Interpreter core to use: table, threaded or dynarec.\n" \
+    "  --ips N         Run N instructions per second (default 700).\n"         \
+    "  --seed N        Seed the random numbers drawn by CXNN.\n"               \
+    "  --quirks NAME   Quirk profile: vip, chip48, schip or modern.\n"         \
+    WINDOW_USAGE                                                               \
+    "  --record FILE   Record the keys of every frame into a movie.\n"         \
+    "  --play FILE     Play a movie back, and verify where it ends.\n"         \
+    PROFILE_USAGE
+
+/**
+ * Reports if a movie that was played back in full ended up where its
+ * recording did.
+ *
+ * @param movie The movie that was played back.
+ * @param vm The machine it was played back into.
+ * @return If the machine ended up in the recorded state.
+ */
+static bool report_playback(const struct movie *movie, struct chip8_vm *vm)
+{
+    if (!verify_movie(movie, vm)) {
+        printf(
+            "WARNING: Playback of %lu frames ended in state %016llX, but the "
+            "recording in %016llX.\n",
+            (unsigned long)movie->frames,
+            (unsigned long long)hash_vm(vm),
+            (unsigned long long)movie->final_hash);
+        return false;
+    }
+
+    printf(
+        "Played back %lu frames, ending in the recorded state %016llX.\n",
+        (unsigned long)movie->frames,
+        (unsigned long long)movie->final_hash);
+    return true;
+}
+
+/**
+ * Runs the loaded program without a window and reports its throughput.
+ *
+ * @param vm The machine to run.
+ * @param budget The limits after which execution should stop.
+ * @param movie The movie to play back instead of running within the budget,
+ * or NULL.
+ * @return The exit code of the emulator.
+ */
+static int headless(
+    struct chip8_vm *vm,
+    struct headless_budget budget,
+    struct movie *movie)
 {
-    if (argc < 2) {
-        printf("No ROM path provided!");
+    if (movie == NULL && !budget.cycles && !budget.frames && !budget.seconds) {
+        printf("A headless run needs --cycles, --frames or --seconds!\n");
         return 1;
     }
 
-    InitWindow(
-        SCREEN_WIDTH * SCALING_FACTOR,
-        SCREEN_HEIGHT * SCALING_FACTOR,
-        "CHIP-8");
-    SetTargetFPS(TARGET_FRAMERATE);
+    struct headless_result result =
+        movie ? play_headless(vm, movie) : run_headless(vm, budget);
+    if (result.status.code) {
+        printf(
+            "WARNING: CPU error %d while executing instruction %04X.\n",
+            result.status.code,
+            result.status.instruction);
+    }
+
+    double speed = result.seconds > 0 ? result.cycles / result.seconds : 0;
+    printf(
+        "Executed %llu cycles in %.3f s (%.0f cycles/s).\n",
+        (unsigned long long)result.cycles,
+        result.seconds,
+        speed);
 
-    startup(argv[1]);
-    const int instructionsPerFrame = INSTRUCTIONS_PER_SECOND / TARGET_FRAMERATE;
-
-    while (!WindowShouldClose()) {
-        for (uint8_t i = 0; i < instructionsPerFrame; i++) {
-            struct cpu_status status = run_cycle();
-            if (status.code) {
-                printf(
-                    "WARNING: CPU error %d while executing instruction %04X.\n",
-                    status.code,
-                    status.instruction);
-                break;
+    if (movie != NULL) {
+        return report_playback(movie, vm) ? 0 : 1;
+    }
+    return result.status.code ? 1 : 0;
+}
+
+#ifndef HEADLESS
+/**
+ * Runs the CPU cycles of a single emulated frame, and reports any error.
+ *
+ * The keys of the frame are played back from the movie, or recorded into it,
+ * until the movie is over.
+ *
+ * @param e The emulation whose machine to run, and record the frame of.
+ */
+static void step_frame(struct emulation *e)
+{
+    uint16_t keys;
+    if (e->mode == MOVIE_PLAYING) {
+        if (next_keys(e->movie, &keys)) {
+            set_keys(e->vm, keys);
+        } else {
+            // The window's keys take over from here.
+            report_playback(e->movie, e->vm);
+            e->mode = MOVIE_NONE;
+        }
+    } else if (e->mode == MOVIE_RECORDING &&
+               !record_keys(e->movie, e->vm->keypad.keys)) {
+        printf("WARNING: Out of memory, the movie ends here.\n");
+        finish_recording(e->movie, e->vm);
+        e->mode = MOVIE_NONE;
+    }
+
+    struct cpu_status status;
+    run_frame(e->vm, &status);
+    record_frame(e->r, e->vm);
+    atomic_fetch_add_explicit(&e->frames_run, 1, memory_order_relaxed);
+    if (status.code) {
+        printf(
+            "WARNING: CPU error %d while executing instruction %04X.\n",
+            status.code,
+            status.instruction);
+    }
+}
+
+/**
+ * Parks the emulation thread for as long as only a key can change the machine.
+ *
+ * Ticks of a machine waiting for a key with both timers stopped leave it as it
+ * was, so rather than running them, the thread sleeps until the window holds
+ * other keys than the machine last sampled, starts rewinding or stops the
+ * emulation. The ticks slept through are never run, so a movie being recorded
+ * skips them as well, and plays back to the same state.
+ *
+ * @param e The emulation to park.
+ * @return If the thread slept at all.
+ */
+static bool park_emulation(struct emulation *e)
+{
+    // A movie playing back releases keys of its own.
+    if (e->mode == MOVIE_PLAYING || !is_blocked_on_keys(e->vm)) {
+        return false;
+    }
+
+    bool slept = false;
+    pthread_mutex_lock(&e->lock);
+    while (atomic_load(&e->running) && !atomic_load(&e->rewinding) &&
+           atomic_load(&e->keys) == e->vm->keypad.keys) {
+        pthread_cond_wait(&e->woken, &e->lock);
+        slept = true;
+    }
+    pthread_mutex_unlock(&e->lock);
+    return slept;
+}
+
+/**
+ * Wakes the emulation thread if it is parked, on the window's thread.
+ *
+ * Must follow the change of input it is woken for, which the emulation thread
+ * checks while holding the lock, so the signal can never slip in between its
+ * check and its sleep.
+ *
+ * @param e The emulation to wake.
+ */
+static void wake_emulation(struct emulation *e)
+{
+    pthread_mutex_lock(&e->lock);
+    pthread_cond_signal(&e->woken);
+    pthread_mutex_unlock(&e->lock);
+}
+
+/**
+ * Runs a machine on its own thread, until the window stops it.
+ *
+ * Emulated time advances in whole timer ticks, one per 60th of a second of
+ * host time, so the emulation runs the exact same instructions between ticks
+ * whatever the host does. Every tick publishes a frame, which the window
+ * picks up whenever it gets to it, so a stalled window never holds back the
+ * CPU.
+ *
+ * @param arg The emulation to run.
+ * @return Nothing.
+ */
+static void *emulate(void *arg)
+{
+    struct emulation *e = arg;
+    const double tick = 1.0 / TIMER_FREQUENCY;
+    double next = GetTime();
+
+    while (atomic_load(&e->running)) {
+        // Sample the keypad once per tick, as the window last saw it, unless
+        // a movie plays back the keys instead.
+        if (e->mode != MOVIE_PLAYING) {
+            set_keys(e->vm, atomic_load(&e->keys));
+        }
+        uint32_t speed = atomic_load(&e->speed);
+
+        if (atomic_load(&e->rewinding)) {
+            rewind_frame(e->r, e->vm);
+        } else if (speed == 0) {
+            // Emulate for a whole tick of host time, and only publish the
+            // last emulated frame.
+            double deadline = GetTime() + tick;
+            do {
+                step_frame(e);
+            } while (GetTime() < deadline);
+        } else {
+            // Fast-forwarding by a multiplier only runs more frames per tick,
+            // so the frames in between are never published.
+            for (uint32_t i = 0; i < speed; i++) {
+                step_frame(e);
             }
         }
+
+        publish_frame(&e->frames, e->vm);
+        PROFILE_POLL(e->vm);
+
+        // The input that woke the thread is sampled right away, and the time
+        // it slept is never caught up on.
+        if (park_emulation(e)) {
+            next = GetTime();
+            continue;
+        }
+
+        // Ticks fallen behind on run back to back until caught up.
+        next += tick;
+        double now = GetTime();
+        if (now - next > MAX_PENDING_SECONDS) {
+            next = now;
+        } else if (next > now) {
+            WaitTime(next - now);
+        }
+    }
+
+    if (e->mode == MOVIE_RECORDING) {
+        finish_recording(e->movie, e->vm);
+    }
+    return NULL;
+}
+
+/**
+ * Calculates how many times as fast as real time fast-forwarding ran so far.
+ *
+ * @param ff The state of fast-forwarding.
+ * @param e The emulation being fast-forwarded.
+ * @return The speed-up factor over real time.
+ */
+static double measure_speedup(struct fast_forward *ff, struct emulation *e)
+{
+    double elapsed = GetTime() - ff->started;
+    uint64_t frames = atomic_load(&e->frames_run) - ff->first;
+    double emulated = (double)frames / TIMER_FREQUENCY;
+    return elapsed > 0 ? emulated / elapsed : 0;
+}
+
+/**
+ * Starts or stops fast-forwarding.
+ *
+ * Stopping reports the achieved speed-up.
+ *
+ * @param ff The state of fast-forwarding.
+ * @param active If fast-forwarding should be active.
+ * @param e The emulation to fast-forward.
+ */
+static void set_fast_forward(
+    struct fast_forward *ff,
+    bool active,
+    struct emulation *e)
+{
+    if (ff->active && !active) {
+        printf(
+            "Fast-forwarded %llu frames at %.1fx speed.\n",
+            (unsigned long long)(atomic_load(&e->frames_run) - ff->first),
+            measure_speedup(ff, e));
+        SetWindowTitle("CHIP-8");
     }
 
+    ff->active = active;
+    ff->first = atomic_load(&e->frames_run);
+    ff->started = GetTime();
+    ff->reported = ff->started;
+    atomic_store(&e->speed, active ? ff->speed : 1);
+}
+
+/**
+ * Runs the loaded program in a window at the standard CHIP-8 speed.
+ *
+ * The machine runs on a thread of its own, while this thread only services
+ * the window and presents the newest frame, so window drags, vsync or a slow
+ * driver never stall the emulation.
+ *
+ * @param vm The machine to run.
+ * @param scale The initial scale of the window.
+ * @param options The colors and scaling with which to present the display.
+ * @param ff The state of fast-forwarding to start with.
+ * @param r The history to rewind through.
+ * @param muted If the machine should run without sound.
+ * @param movie The movie to record or play back, which disables rewinding.
+ * @param mode What to do with the movie.
+ * @return The exit code of the emulator.
+ */
+static int windowed(
+    struct chip8_vm *vm,
+    int scale,
+    struct display_options options,
+    struct fast_forward ff,
+    struct rewind *r,
+    bool muted,
+    struct movie *movie,
+    enum movie_mode mode)
+{
+    SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+    InitWindow(SCREEN_WIDTH * scale, SCREEN_HEIGHT * scale, "CHIP-8");
+    SetTargetFPS(TARGET_FRAMERATE);
+    init_display(options);
+    if (!muted && !init_sound(vm)) {
+        printf("WARNING: Could not open the audio device, running muted.\n");
+    }
+
+    // Holds three whole frames, so it is kept off the stack like the machine.
+    static struct emulation e;
+    e.vm = vm;
+    e.r = r;
+    e.movie = movie;
+    e.mode = mode;
+    init_frame_buffer(&e.frames);
+    atomic_init(&e.keys, 0);
+    atomic_init(&e.speed, 1);
+    atomic_init(&e.rewinding, false);
+    atomic_init(&e.running, true);
+    atomic_init(&e.frames_run, 0);
+    pthread_mutex_init(&e.lock, NULL);
+    pthread_cond_init(&e.woken, NULL);
+    set_fast_forward(&ff, ff.active, &e);
+
+    pthread_t thread;
+    int exit_code = 0;
+    if (pthread_create(&thread, NULL, emulate, &e) != 0) {
+        printf("Could not start the emulation thread!\n");
+        exit_code = 1;
+    }
+
+    while (exit_code == 0 && !WindowShouldClose()) {
+        // Sample the keypad once per host frame, for every tick until the
+        // next one.
+        uint16_t keys = poll_keypad();
+        bool changed = atomic_exchange(&e.keys, keys) != keys;
+        // Rewinding would leave the movie behind.
+        bool rewinding = IsKeyDown(REWIND_KEY) && mode == MOVIE_NONE;
+        changed |= atomic_exchange(&e.rewinding, rewinding) != rewinding;
+        if (changed) {
+            wake_emulation(&e);
+        }
+
+        if (IsKeyPressed(FAST_FORWARD_KEY)) {
+            set_fast_forward(&ff, !ff.active, &e);
+        }
+
+        if (ff.active && GetTime() - ff.reported >= REPORT_INTERVAL) {
+            char title[64];
+            snprintf(
+                title,
+                sizeof(title),
+                "CHIP-8 (fast-forward %.1fx)",
+                measure_speedup(&ff, &e));
+            SetWindowTitle(title);
+            ff.reported = GetTime();
+        }
+
+        // Present the newest frame, however many the emulation published
+        // since the last host frame.
+        const struct frame *frame = take_frame(&e.frames, NULL);
+
+        // A program waiting for a key without a timer running can not change
+        // before a key is released, so the window sleeps until the next input
+        // event instead of presenting the same frame over and over. The frame
+        // has to have seen the current keys, or it may predate a release, and
+        // a movie playing back releases keys of its own.
+        bool asleep = frame->idle && frame->keys == keys && !ff.active &&
+                      !rewinding && mode != MOVIE_PLAYING;
+        if (asleep) {
+            EnableEventWaiting();
+        } else {
+            DisableEventWaiting();
+        }
+
+        present_display(frame);
+    }
+
+    if (exit_code == 0) {
+        atomic_store(&e.running, false);
+        wake_emulation(&e);
+        pthread_join(thread, NULL);
+        set_fast_forward(&ff, false, &e);
+    }
+    pthread_cond_destroy(&e.woken);
+    pthread_mutex_destroy(&e.lock);
+    unload_sound(vm);
+    unload_display();
     CloseWindow();
 
-    return 0;
+    return exit_code;
+}
+#endif  // !HEADLESS
+
+int main(int argc, char **argv)
+{
+    // The machine is too large to comfortably live on the stack.
+    static struct chip8_vm vm;
+    init_vm(&vm);
+
+    char *path = NULL;
+#ifdef HEADLESS
+    bool is_headless = true;  // There is no window to fall back on.
+#else
+    bool is_headless = false;
+#endif  // HEADLESS
+    struct headless_budget budget = {.cycles = 0, .frames = 0, .seconds = 0};
+    const char *load_path = NULL;
+    const char *save_path = NULL;
+    const char *record_path = NULL;
+    const char *play_path = NULL;
+#ifndef HEADLESS
+    int scale = DEFAULT_SCALE;
+    struct display_options options = {
+        .foreground = DEFAULT_FOREGROUND,
+        .background = DEFAULT_BACKGROUND,
+        .second = DEFAULT_SECOND,
+        .blend = DEFAULT_BLEND,
+        .scaling = SCALE_INTEGER,
+    };
+    struct fast_forward ff = {.active = false, .speed = 0};
+    size_t rewind_budget = DEFAULT_REWIND_BUDGET;
+    uint32_t rewind_interval = DEFAULT_REWIND_INTERVAL;
+    const char *layout = DEFAULT_KEY_LAYOUT;
+    bool muted = false;
+#endif  // !HEADLESS
+#ifdef CHIP8_PROFILE
+    const char *profile_path = DEFAULT_PROFILE_PATH;
+#endif  // CHIP8_PROFILE
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--headless") == 0) {
+            is_headless = true;
+        } else if (strcmp(argv[i], "--cycles") == 0 && has_value) {
+            budget.cycles = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--frames") == 0 && has_value) {
+            budget.frames = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seconds") == 0 && has_value) {
+            budget.seconds = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--core") == 0 && has_value) {
+            i++;
+            if (strcmp(argv[i], "table") == 0) {
+                set_cpu_core(&vm, CORE_TABLE);
+            } else if (strcmp(argv[i], "threaded") == 0) {
+                set_cpu_core(&vm, CORE_THREADED);
+            } else if (strcmp(argv[i], "dynarec") == 0) {
+                set_cpu_core(&vm, CORE_DYNAREC);
+            } else {
+                printf(USAGE, argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--ips") == 0 && has_value) {
+            set_instructions_per_second(&vm, strtoul(argv[++i], NULL, 10));
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            seed_rng(&vm, strtoull(argv[++i], NULL, 10));
+        } else if (strcmp(argv[i], "--quirks") == 0 && has_value) {
+            enum quirk_profile profile;
+            if (!find_quirk_profile(argv[++i], &profile)) {
+                printf(USAGE, argv[0]);
+                return 1;
+            }
+            set_quirks(&vm, QUIRK_PROFILES[profile]);
+#ifndef HEADLESS
+        } else if (strcmp(argv[i], "--fast-forward") == 0) {
+            ff.active = true;
+        } else if (strcmp(argv[i], "--ff-speed") == 0 && has_value) {
+            ff.speed = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--rewind-mb") == 0 && has_value) {
+            rewind_budget = strtoull(argv[++i], NULL, 10) * 1024 * 1024;
+        } else if (strcmp(argv[i], "--rewind-gap") == 0 && has_value) {
+            rewind_interval = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--scale") == 0 && has_value) {
+            scale = atoi(argv[++i]);
+            scale = scale > 0 ? scale : DEFAULT_SCALE;
+        } else if (strcmp(argv[i], "--fit") == 0) {
+            options.scaling = SCALE_FIT;
+        } else if (strcmp(argv[i], "--fg") == 0 && has_value) {
+            options.foreground = strtoul(argv[++i], NULL, 16) & 0xFFFFFF;
+        } else if (strcmp(argv[i], "--bg") == 0 && has_value) {
+            options.background = strtoul(argv[++i], NULL, 16) & 0xFFFFFF;
+        } else if (strcmp(argv[i], "--fg2") == 0 && has_value) {
+            options.second = strtoul(argv[++i], NULL, 16) & 0xFFFFFF;
+        } else if (strcmp(argv[i], "--blend") == 0 && has_value) {
+            options.blend = strtoul(argv[++i], NULL, 16) & 0xFFFFFF;
+        } else if (strcmp(argv[i], "--keys") == 0 && has_value) {
+            layout = argv[++i];
+        } else if (strcmp(argv[i], "--mute") == 0) {
+            muted = true;
+#endif  // !HEADLESS
+        } else if (strcmp(argv[i], "--record") == 0 && has_value) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--play") == 0 && has_value) {
+            play_path = argv[++i];
+        } else if (strcmp(argv[i], "--load-state") == 0 && has_value) {
+            load_path = argv[++i];
+        } else if (strcmp(argv[i], "--save-state") == 0 && has_value) {
+            save_path = argv[++i];
+#ifdef CHIP8_PROFILE
+        } else if (strcmp(argv[i], "--profile") == 0 && has_value) {
+            profile_path = argv[++i];
+#endif  // CHIP8_PROFILE
+        } else if (argv[i][0] == '-') {
+            printf(USAGE, argv[0]);
+            return 1;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (path == NULL) {
+        printf("No ROM path provided!\n");
+        return 1;
+    }
+
+    // Movies start from the beginning of their program, and headless runs
+    // have no keys to record.
+    if ((record_path != NULL || play_path != NULL) && load_path != NULL) {
+        printf("Movies can not start from a save state!\n");
+        return 1;
+    }
+    if (record_path != NULL && (play_path != NULL || is_headless)) {
+        printf("Movies can only be recorded in a window!\n");
+        return 1;
+    }
+
+    if (!startup(&vm, path)) {
+        printf("Could not read a ROM from %s!\n", path);
+        return 1;
+    }
+    if (load_path != NULL && !load_state_file(&vm, load_path)) {
+        printf("Could not load a save state from %s!\n", load_path);
+        return 1;
+    }
+
+    // Movies hold a few bytes per key press, so they are kept off the stack
+    // like the machine.
+    static struct movie movie;
+    init_movie(&movie);
+    enum movie_mode mode = MOVIE_NONE;
+    if (play_path != NULL) {
+        if (!load_movie_file(&movie, play_path)) {
+            printf("Could not load a movie from %s!\n", play_path);
+            return 1;
+        }
+        if (!start_playback(&movie, &vm)) {
+            printf("The movie %s was recorded with another ROM!\n", play_path);
+            free_movie(&movie);
+            return 1;
+        }
+        mode = MOVIE_PLAYING;
+    } else if (record_path != NULL) {
+        start_recording(&movie, &vm);
+        mode = MOVIE_RECORDING;
+    }
+#ifdef CHIP8_PROFILE
+    init_profile(profile_path);
+#endif  // CHIP8_PROFILE
+
+    int exit_code = 0;
+#ifndef HEADLESS
+    if (!is_headless) {
+        if (!set_key_layout(layout)) {
+            printf("Invalid key layout %s!\n", layout);
+            return 1;
+        }
+
+        // The history holds a few snapshots in full, so it is kept off the
+        // stack like the machine.
+        static struct rewind r;
+        if (!init_rewind(&r, rewind_budget, rewind_interval)) {
+            printf("Could not allocate the rewind history!\n");
+            return 1;
+        }
+        exit_code =
+            windowed(&vm, scale, options, ff, &r, muted, &movie, mode);
+        free_rewind(&r);
+    }
+#endif  // !HEADLESS
+    if (is_headless) {
+        exit_code =
+            headless(&vm, budget, mode == MOVIE_PLAYING ? &movie : NULL);
+    }
+
+    if (record_path != NULL) {
+        if (save_movie_file(&movie, record_path)) {
+            printf(
+                "Recorded %lu frames into %s.\n",
+                (unsigned long)movie.frames,
+                record_path);
+        } else {
+            printf("Could not write a movie to %s!\n", record_path);
+            exit_code = 1;
+        }
+    }
+    free_movie(&movie);
+
+    if (save_path != NULL && !save_state_file(&vm, save_path)) {
+        printf("Could not write a save state to %s!\n", save_path);
+        exit_code = 1;
+    }
+
+#ifdef CHIP8_PROFILE
+    dump_profile(&vm);
+#endif  // CHIP8_PROFILE
+
+    free_vm(&vm);
+    return exit_code;
 }
@@ -1,8 +1,15 @@
 #include "memory.h"
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "macros.h"
+
+#define FONTS_END (LARGE_FONT_START + LARGE_FONT_SIZE)
 
 const uint8_t FONT[FONT_SIZE] = {
     0xF0, 0x90, 0x90, 0x90, 0xF0,  // 0
@@ -23,39 +30,113 @@ const uint8_t FONT[FONT_SIZE] = {
     0xF0, 0x80, 0xF0, 0x80, 0x80,  // F
 };
 
-static uint8_t memory[MEMORY_SIZE];
+const uint8_t LARGE_FONT[LARGE_FONT_SIZE] = {
+    0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C,  // 0
+    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C,  // 1
+    0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF,  // 2
+    0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C,  // 3
+    0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06,  // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C,  // 5
+    0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C,  // 6
+    0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60,  // 7
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C,  // 8
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C,  // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3,  // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC,  // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C,  // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC,  // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,  // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0,  // F
+};
+
+void set_memory_write_hook(struct chip8_vm *vm, memory_write_hook hook)
+{
+    vm->write_hook = hook;
+}
 
-void init_memory()
+void init_memory(struct chip8_vm *vm)
 {
     // Clear the usable memory space.
-    for (uint16_t i = 0; i < MEMORY_SIZE; i++) {
-        memory[i] = 0;
+    memset(vm->memory, 0, sizeof(vm->memory));
+    load_fonts(vm);
+    mark_memory_written(vm, 0x000, MEMORY_SIZE);
+
+    // This is the state resets restore, so nothing counts as written yet.
+    memset(vm->dirty_lines, 0, sizeof(vm->dirty_lines));
+}
+
+void reset_memory(struct chip8_vm *vm)
+{
+    bool fonts_written = false;
+    for (uint16_t word = 0; word < len(vm->dirty_lines); word++) {
+        uint64_t lines = vm->dirty_lines[word];
+        vm->dirty_lines[word] = 0;
+
+        for (uint8_t bit = 0; lines != 0; bit++, lines >>= 1) {
+            if (!(lines & 1)) {
+                continue;
+            }
+
+            // The hook is notified directly, as the line is blank again.
+            uint16_t address = (word * 64 + bit) * MEMORY_LINE_SIZE;
+            memset(&vm->memory[address], 0, MEMORY_LINE_SIZE);
+            if (vm->write_hook != NULL) {
+                vm->write_hook(vm, address, MEMORY_LINE_SIZE);
+            }
+            fonts_written |= address < FONTS_END;
+        }
     }
 
-    // Load the font into the memory.
-    for (uint16_t i = 0; i < sizeof(FONT); i++) {
-        memory[FONT_START + i] = FONT[i];
+    if (fonts_written) {
+        load_fonts(vm);
     }
 }
 
-void load_program(uint8_t *program)
+void load_program(struct chip8_vm *vm, const uint8_t *program, uint16_t size)
 {
-    for (uint16_t offset = 0; offset < MEMORY_SIZE - PROGRAM_START; offset++) {
-        memory[PROGRAM_START + offset] = program[offset];
-    }
+    assert(size <= MEMORY_SIZE - PROGRAM_START);
+    memcpy(&vm->memory[PROGRAM_START], program, size);
+    mark_memory_written(vm, PROGRAM_START, size);
+}
+
+void write_memory(struct chip8_vm *vm, uint16_t address, uint8_t value)
+{
+    vm->memory[address] = value;
+    mark_memory_written(vm, address, 1);
 }
 
-void write_memory(uint16_t address, uint8_t value)
+uint8_t read_memory(struct chip8_vm *vm, uint16_t address)
 {
-    memory[address] = value;
+    return vm->memory[address];
 }
 
-uint8_t read_memory(uint16_t address)
+uint8_t *get_memory_pointer(struct chip8_vm *vm, uint16_t address)
 {
-    return memory[address];
+    return &vm->memory[address];
+}
+
+void mark_memory_written(
+    struct chip8_vm *vm,
+    uint16_t address,
+    uint32_t length)
+{
+    if (length > 0) {
+        uint32_t last = ((uint32_t)address + length - 1) / MEMORY_LINE_SIZE;
+        if (last >= MEMORY_LINES) {
+            last = MEMORY_LINES - 1;
+        }
+        for (uint32_t line = address / MEMORY_LINE_SIZE; line <= last; line++) {
+            vm->dirty_lines[line / 64] |= (uint64_t)1 << (line % 64);
+        }
+    }
+
+    if (vm->write_hook != NULL) {
+        vm->write_hook(vm, address, length);
+    }
 }
 
-uint8_t *get_memory_pointer(uint16_t address)
+static void load_fonts(struct chip8_vm *vm)
 {
-    return &memory[address];
+    memcpy(&vm->memory[FONT_START], FONT, sizeof(FONT));
+    memcpy(&vm->memory[LARGE_FONT_START], LARGE_FONT, sizeof(LARGE_FONT));
 }
@@ -4,10 +4,49 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-#define FONT_START 0x50         // General convention around CHIP-8
-#define PROGRAM_START 0x200     // General convention around CHIP-8
-#define MEMORY_SIZE (4 * 1024)  // 4KB
-#define FONT_SIZE (16 * 5)      // 16 characters of 5 bytes
+#define FONT_START 0x50          // General convention around CHIP-8
+#define PROGRAM_START 0x200      // General convention around CHIP-8
+#define MEMORY_SIZE (64 * 1024)  // 64KB, as on the XO-CHIP
+#define FONT_SIZE (16 * 5)       // 16 characters of 5 bytes
+
+// The large font of the SUPER-CHIP, right after the small one.
+#define LARGE_FONT_START (FONT_START + FONT_SIZE)
+#define LARGE_FONT_SIZE (16 * 10)  // 16 characters of 10 bytes
+
+// Writes are tracked in lines of memory, so resetting it only has to restore
+// the lines a program wrote to.
+#define MEMORY_LINE_SIZE 64
+#define MEMORY_LINES (MEMORY_SIZE / MEMORY_LINE_SIZE)
+
+// Caches derived from memory are allocated in pages of it, so only the pages a
+// program actually runs from take up any space.
+#define MEMORY_PAGE_SIZE 4096
+#define MEMORY_PAGES (MEMORY_SIZE / MEMORY_PAGE_SIZE)
+
+struct chip8_vm;
+
+/**
+ * A function notified whenever a range of memory is written to.
+ *
+ * @param vm The machine whose memory was written to.
+ * @param address The first memory address that was written to.
+ * @param length The amount of consecutive bytes that were written.
+ */
+typedef void (*memory_write_hook)(
+    struct chip8_vm *vm,
+    uint16_t address,
+    uint32_t length);
+
+/**
+ * Registers the function to notify of any writes to memory.
+ *
+ * Allows other modules to keep state derived from memory, such as decoded
+ * instructions, in sync with it. Only a single hook is kept at a time.
+ *
+ * @param vm The machine whose memory to observe.
+ * @param hook The function to notify, or NULL to stop notifying.
+ */
+void set_memory_write_hook(struct chip8_vm *vm, memory_write_hook hook);
 
 /**
  * Initializes the memory array to zero.
@@ -15,49 +54,94 @@
  * This function must be called before any read or write operations to ensure
  * that the memory is properly initialized in a consistent state.
  *
+ * @param vm The machine whose memory to initialize.
  * @return void
  */
-void init_memory();
+void init_memory(struct chip8_vm *vm);
+
+/**
+ * Returns the memory to the state init_memory() leaves it in.
+ *
+ * Only restores the lines written to since the memory was last initialized or
+ * reset, which is a small part of it for most programs, so machines can be
+ * reset far more cheaply than initialized.
+ *
+ * @param vm The machine whose memory to reset.
+ */
+void reset_memory(struct chip8_vm *vm);
 
 /**
  * Loads the provided program into memory.
  *
- * @param program An array describing the program.
+ * The rest of the program space is left as it is, so it has to be blank, as
+ * after init_memory() or reset_memory().
+ *
+ * @param vm The machine to load the program into.
+ * @param program The bytes of the program.
+ * @param size The amount of bytes of the program, at most the program space.
  */
-void load_program(uint8_t *program);
+void load_program(struct chip8_vm *vm, const uint8_t *program, uint16_t size);
 
 /**
  * Reads a value from memory at the specified address.
  *
- * The function assumes that the provided address fits within the 12-bit memory
+ * The function assumes that the provided address fits within the 16-bit memory
  * space, and out-of-bounds access should be validated by the CPU.
  *
- * @param address The 12-bit memory address to read from.
+ * @param vm The machine to read from.
+ * @param address The 16-bit memory address to read from.
  * @return The 8-bit value stored at the specified address.
  */
-uint8_t read_memory(uint16_t address);
+uint8_t read_memory(struct chip8_vm *vm, uint16_t address);
 
 /**
  * Gets a pointer to memory at the current address.
  *
  * Allows for passing around several bytes of data stored in memory to other
- * modules without having to manually index across results.
+ * modules without having to manually index across results. Any writes made
+ * through the pointer must be followed by a call to mark_memory_written().
  *
- * @param address The 12-bit memory address to read from.
+ * @param vm The machine to read from.
+ * @param address The 16-bit memory address to read from.
  * @return A pointer to the requested memory address.
  */
-uint8_t *get_memory_pointer(uint16_t address);
+uint8_t *get_memory_pointer(struct chip8_vm *vm, uint16_t address);
 
 /**
  * Writes a value to memory at the specified address.
  *
- * The function assumes that the provided address fits within the 12-bit memory
+ * The function assumes that the provided address fits within the 16-bit memory
  * space, and out-of-bounds access should be validated by the CPU.
  *
- * @param address The 12-bit memory address to write to.
+ * @param vm The machine to write to.
+ * @param address The 16-bit memory address to write to.
  * @param value The 8-bit value to store at the specified address.
  * @return void
  */
-void write_memory(uint16_t address, uint8_t value);
+void write_memory(struct chip8_vm *vm, uint16_t address, uint8_t value);
+
+/**
+ * Marks a range of memory as written to, notifying the memory write hook.
+ *
+ * Must be called after writing to memory through get_memory_pointer(), as
+ * those writes can not be observed otherwise. Also notes the lines written to,
+ * so reset_memory() restores them.
+ *
+ * @param vm The machine that was written to.
+ * @param address The first memory address that was written to.
+ * @param length The amount of consecutive bytes that were written.
+ * @return void
+ */
+void mark_memory_written(
+    struct chip8_vm *vm,
+    uint16_t address,
+    uint32_t length);
+
+/**
+ * Copies both fonts into their place in memory.
+ *
+ * @param vm The machine to load the fonts into.
+ */
+static void load_fonts(struct chip8_vm *vm);
 
 #endif  // !MEMORY_H_
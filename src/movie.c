@@ -0,0 +1,262 @@
+#include "movie.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytes.h"
+#include "chip8.h"
+#include "cpu.h"
+#include "quirks.h"
+#include "rng.h"
+#include "scheduler.h"
+
+#define INITIAL_RUNS 64  // Runs allocated by the first key recorded
+
+void init_movie(struct movie *movie)
+{
+    memset(movie, 0, sizeof(*movie));
+}
+
+void free_movie(struct movie *movie)
+{
+    free(movie->runs);
+    init_movie(movie);
+}
+
+void start_recording(struct movie *movie, const struct chip8_vm *vm)
+{
+    movie->program_hash = hash_program(vm);
+    movie->seed = vm->rng.seed;
+    movie->speed = vm->scheduler.instructions_per_second;
+    movie->quirks = vm->quirks;
+    movie->frames = 0;
+    movie->final_hash = 0;
+    movie->run_count = 0;
+    movie->run = 0;
+    movie->played = 0;
+}
+
+bool record_keys(struct movie *movie, uint16_t keys)
+{
+    struct movie_run *last =
+        movie->run_count ? &movie->runs[movie->run_count - 1] : NULL;
+    if (last != NULL && last->keys == keys && last->frames < UINT16_MAX) {
+        last->frames++;
+        movie->frames++;
+        return true;
+    }
+
+    if (movie->run_count == movie->run_capacity) {
+        uint32_t capacity =
+            movie->run_capacity ? movie->run_capacity * 2 : INITIAL_RUNS;
+        struct movie_run *runs =
+            realloc(movie->runs, capacity * sizeof(*runs));
+        if (runs == NULL) {
+            return false;
+        }
+        movie->runs = runs;
+        movie->run_capacity = capacity;
+    }
+
+    movie->runs[movie->run_count++] = (struct movie_run){keys, 1};
+    movie->frames++;
+    return true;
+}
+
+void finish_recording(struct movie *movie, const struct chip8_vm *vm)
+{
+    movie->final_hash = hash_vm(vm);
+}
+
+bool start_playback(struct movie *movie, struct chip8_vm *vm)
+{
+    if (hash_program(vm) != movie->program_hash) {
+        return false;
+    }
+
+    set_quirks(vm, movie->quirks);
+    set_instructions_per_second(vm, movie->speed);
+    reset_scheduler(vm);
+    seed_rng(vm, movie->seed);
+    movie->run = 0;
+    movie->played = 0;
+    return true;
+}
+
+bool next_keys(struct movie *movie, uint16_t *keys)
+{
+    if (movie->run >= movie->run_count) {
+        return false;
+    }
+
+    const struct movie_run *run = &movie->runs[movie->run];
+    *keys = run->keys;
+    if (++movie->played == run->frames) {
+        movie->run++;
+        movie->played = 0;
+    }
+    return true;
+}
+
+bool verify_movie(const struct movie *movie, const struct chip8_vm *vm)
+{
+    return hash_vm(vm) == movie->final_hash;
+}
+
+size_t movie_size(const struct movie *movie)
+{
+    return MOVIE_HEADER_SIZE + (size_t)movie->run_count * MOVIE_RUN_SIZE;
+}
+
+size_t save_movie(const struct movie *movie, uint8_t *buffer, size_t size)
+{
+    if (size < movie_size(movie)) {
+        return 0;
+    }
+
+    uint8_t *out = buffer;
+    memcpy(out, MOVIE_MAGIC, 4);
+    out += 4;
+    put_u16(&out, MOVIE_VERSION);
+
+    put_u64(&out, movie->program_hash);
+    put_u64(&out, movie->seed);
+    put_u32(&out, movie->speed);
+    *out++ = movie->quirks.vf_reset;
+    *out++ = movie->quirks.shift_vy;
+    *out++ = movie->quirks.jump_vx;
+    *out++ = movie->quirks.wrap;
+    *out++ = movie->quirks.index;
+
+    put_u32(&out, movie->frames);
+    put_u64(&out, movie->final_hash);
+    put_u32(&out, movie->run_count);
+    for (uint32_t i = 0; i < movie->run_count; i++) {
+        put_u16(&out, movie->runs[i].keys);
+        put_u16(&out, movie->runs[i].frames);
+    }
+
+    return out - buffer;
+}
+
+bool load_movie(struct movie *movie, const uint8_t *buffer, size_t size)
+{
+    if (size < MOVIE_HEADER_SIZE || memcmp(buffer, MOVIE_MAGIC, 4) != 0) {
+        return false;
+    }
+
+    const uint8_t *in = buffer + 4;
+    if (get_u16(&in) != MOVIE_VERSION) {
+        return false;
+    }
+
+    // Validate everything playback relies on before touching the movie.
+    uint64_t program_hash = get_u64(&in);
+    uint64_t seed = get_u64(&in);
+    uint32_t speed = get_u32(&in);
+    const uint8_t *quirks = in;
+    in += 5;
+    uint32_t frames = get_u32(&in);
+    uint64_t final_hash = get_u64(&in);
+    uint32_t run_count = get_u32(&in);
+    if (speed < MIN_INSTRUCTIONS_PER_SECOND || quirks[0] > 1 ||
+        quirks[1] > 1 || quirks[2] > 1 || quirks[3] > 1 ||
+        quirks[4] > INDEX_PLUS_X_1 ||
+        (size - MOVIE_HEADER_SIZE) / MOVIE_RUN_SIZE != run_count ||
+        (size - MOVIE_HEADER_SIZE) % MOVIE_RUN_SIZE != 0) {
+        return false;
+    }
+
+    // Every run has to hold a frame, and all of them the recorded frames.
+    const uint8_t *runs = in;
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < run_count; i++) {
+        get_u16(&in);
+        uint16_t length = get_u16(&in);
+        if (length == 0) {
+            return false;
+        }
+        total += length;
+    }
+    if (total != frames) {
+        return false;
+    }
+
+    struct movie_run *loaded = malloc(
+        (run_count ? run_count : 1) * sizeof(*loaded));
+    if (loaded == NULL) {
+        return false;
+    }
+    for (uint32_t i = 0; i < run_count; i++) {
+        loaded[i].keys = get_u16(&runs);
+        loaded[i].frames = get_u16(&runs);
+    }
+
+    free(movie->runs);
+    movie->program_hash = program_hash;
+    movie->seed = seed;
+    movie->speed = speed;
+    movie->quirks = (struct quirks){
+        .vf_reset = quirks[0],
+        .shift_vy = quirks[1],
+        .jump_vx = quirks[2],
+        .wrap = quirks[3],
+        .index = quirks[4],
+    };
+    movie->frames = frames;
+    movie->final_hash = final_hash;
+    movie->runs = loaded;
+    movie->run_count = run_count;
+    movie->run_capacity = run_count ? run_count : 1;
+    movie->run = 0;
+    movie->played = 0;
+    return true;
+}
+
+bool save_movie_file(const struct movie *movie, const char *path)
+{
+    size_t size = movie_size(movie);
+    uint8_t *buffer = malloc(size);
+    if (buffer == NULL) {
+        return false;
+    }
+    save_movie(movie, buffer, size);
+
+    FILE *f = fopen(path, "wb");
+    bool written = f != NULL && fwrite(buffer, 1, size, f) == size;
+    if (f != NULL && fclose(f) != 0) {
+        written = false;
+    }
+    free(buffer);
+    return written;
+}
+
+bool load_movie_file(struct movie *movie, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+
+    // The size decides how many runs there are, so read the whole file.
+    bool loaded = false;
+    uint8_t *buffer = NULL;
+    long size = -1;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        size = ftell(f);
+    }
+    if (size >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+        buffer = malloc(size ? size : 1);
+    }
+    if (buffer != NULL && fread(buffer, 1, size, f) == (size_t)size) {
+        loaded = load_movie(movie, buffer, size);
+    }
+
+    free(buffer);
+    fclose(f);
+    return loaded;
+}
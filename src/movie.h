@@ -0,0 +1,182 @@
+#ifndef MOVIE_H_
+#define MOVIE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "quirks.h"
+
+#define MOVIE_MAGIC "CH8M"  // Identifies movies, without a terminator
+#define MOVIE_VERSION 1     // Bumped whenever the layout below changes
+
+// The size of a movie without any runs of keys, which the current version
+// lays out as follows, with all values in little-endian byte order:
+//
+// - The magic bytes and the version.
+// - The hash of the program, the seed of the random numbers and the CPU speed.
+// - The VF reset, shift VY, BXNN and wrap quirks, and how FX55 and FX65
+//   advance I.
+// - The amount of frames, the hash of the machine after the last one, and the
+//   amount of runs.
+//
+// Every run follows as the keys held down throughout it, and its length in
+// frames, both as 16-bit values.
+#define MOVIE_HEADER_SIZE (4 + 2 + 8 + 8 + 4 + 5 + 4 + 8 + 4)
+#define MOVIE_RUN_SIZE (2 + 2)
+
+struct chip8_vm;
+
+// Consecutive frames throughout which the same keys were held down.
+struct movie_run {
+    uint16_t keys;    // The keys held down, as set_keys() takes them
+    uint16_t frames;  // How many frames in a row, at least 1
+};
+
+// The input of a run of a program, frame by frame, along with everything else
+// that decides how the program behaves.
+//
+// Machines only depend on their program, settings and keys, so playing the
+// keys back into the same program with the same settings ends up in the exact
+// same state, on every core and host. Keys change rarely compared to the frame
+// rate, so they are kept as runs, which take a few bytes per key press.
+struct movie {
+    uint64_t program_hash;     // hash_program() of the program played
+    uint64_t seed;             // The seed of the random numbers
+    uint32_t speed;            // The instructions run per second
+    struct quirks quirks;      // The behavior of quirky instructions
+    uint32_t frames;           // The frames recorded
+    uint64_t final_hash;       // hash_vm() after the last frame
+    struct movie_run *runs;    // The keys of every frame, as runs
+    uint32_t run_count;        // The runs in use
+    uint32_t run_capacity;     // The runs allocated
+    uint32_t run;              // The run playback is in
+    uint16_t played;           // Frames played back of that run
+};
+
+/**
+ * Initializes an empty movie.
+ *
+ * @param movie The movie to initialize.
+ */
+void init_movie(struct movie *movie);
+
+/**
+ * Releases the runs of a movie, which is left empty.
+ *
+ * @param movie The movie to release.
+ */
+void free_movie(struct movie *movie);
+
+/**
+ * Starts recording a machine into a movie, dropping anything recorded before.
+ *
+ * Must be called right after the program was loaded, before running any
+ * frame, as movies always start from the beginning of their program.
+ *
+ * @param movie The movie to record into.
+ * @param vm The machine to record, with a program just loaded.
+ */
+void start_recording(struct movie *movie, const struct chip8_vm *vm);
+
+/**
+ * Records the keys of another frame.
+ *
+ * @param movie The movie to record into.
+ * @param keys The keys held down throughout the frame.
+ * @return If there was memory left to record the frame.
+ */
+bool record_keys(struct movie *movie, uint16_t keys);
+
+/**
+ * Finishes recording a movie, noting the state the machine ended up in.
+ *
+ * @param movie The movie to finish.
+ * @param vm The machine that was recorded.
+ */
+void finish_recording(struct movie *movie, const struct chip8_vm *vm);
+
+/**
+ * Starts playing a movie back into a machine.
+ *
+ * Must be called right after the program was loaded, before running any
+ * frame. Applies the seed, CPU speed and quirks of the movie, so the machine
+ * runs the way it did while recording.
+ *
+ * @param movie The movie to play back.
+ * @param vm The machine to play back into, with a program just loaded.
+ * @return If the loaded program is the one the movie was recorded with,
+ * otherwise the machine is left as it was.
+ */
+bool start_playback(struct movie *movie, struct chip8_vm *vm);
+
+/**
+ * Takes the keys of the next frame played back.
+ *
+ * The keys are meant for set_keys() right before the frame runs.
+ *
+ * @param movie The movie to play back.
+ * @param keys The keys held down throughout the frame.
+ * @return If there was another frame, otherwise the movie is over.
+ */
+bool next_keys(struct movie *movie, uint16_t *keys);
+
+/**
+ * Checks if a machine ended up where the movie did while recording.
+ *
+ * @param movie The movie that was played back in full.
+ * @param vm The machine it was played back into.
+ * @return If the machine hashes the same as after recording.
+ */
+bool verify_movie(const struct movie *movie, const struct chip8_vm *vm);
+
+/**
+ * Calculates the size of a movie once saved.
+ *
+ * @param movie The movie to measure.
+ * @return The size in bytes.
+ */
+size_t movie_size(const struct movie *movie);
+
+/**
+ * Writes a movie into a buffer.
+ *
+ * @param movie The movie to write.
+ * @param buffer The buffer to write to.
+ * @param size The size of the buffer, at least movie_size().
+ * @return The amount of bytes written, or 0 if the buffer is too small.
+ */
+size_t save_movie(const struct movie *movie, uint8_t *buffer, size_t size);
+
+/**
+ * Reads a movie from a buffer, replacing whatever the movie held.
+ *
+ * The movie is validated in full before it is touched, so a rejected buffer
+ * leaves it as it was.
+ *
+ * @param movie The movie to read into, initialized with init_movie().
+ * @param buffer The saved movie.
+ * @param size The size of the saved movie.
+ * @return If the movie was valid, and there was memory left to read it.
+ */
+bool load_movie(struct movie *movie, const uint8_t *buffer, size_t size);
+
+/**
+ * Writes a movie into a file.
+ *
+ * @param movie The movie to write.
+ * @param path The path of the file to write.
+ * @return If the file could be written.
+ */
+bool save_movie_file(const struct movie *movie, const char *path);
+
+/**
+ * Reads a movie from a file.
+ *
+ * @param movie The movie to read into, initialized with init_movie().
+ * @param path The path of the file to read.
+ * @return If the file could be read and held a valid movie.
+ */
+bool load_movie_file(struct movie *movie, const char *path);
+
+#endif  // !MOVIE_H_
@@ -0,0 +1,134 @@
+#include "profile.h"
+
+#ifdef CHIP8_PROFILE
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip8.h"
+
+// The names of opcodes and status codes, by their value.
+static const char *const opcode_names[OPCODE_COUNT] = {
+    [OP_UNDECODED] = "undecoded",
+#define X(opcode, handler) [opcode] = #handler + 3,  // Without the op_ prefix
+    OPCODES(X)
+#undef X
+};
+static const char *const status_names[STATUS_CODE_COUNT] = {
+#define X(code) [code] = #code,
+    STATUS_CODES(X)
+#undef X
+};
+
+static const char *output_path = DEFAULT_PROFILE_PATH;
+static volatile sig_atomic_t dump_requested = 0;
+
+#ifdef SIGUSR1
+/**
+ * Requests a profile to be written by the next call to poll_profile().
+ *
+ * @param signal The signal that arrived.
+ */
+static void request_dump(int signal)
+{
+    (void)signal;
+    dump_requested = 1;
+}
+#endif  // SIGUSR1
+
+void init_profile(const char *path)
+{
+    output_path = path;
+#ifdef SIGUSR1
+    signal(SIGUSR1, request_dump);
+#endif  // SIGUSR1
+}
+
+void poll_profile(struct chip8_vm *vm)
+{
+    if (dump_requested) {
+        dump_requested = 0;
+        dump_profile(vm);
+    }
+}
+
+bool dump_profile(struct chip8_vm *vm)
+{
+    FILE *f = fopen(output_path, "w");
+    if (f == NULL) {
+        printf("Could not write the profile to %s!\n", output_path);
+        return false;
+    }
+
+    write_profile(vm, f);
+    fclose(f);
+    return true;
+}
+
+void write_profile(struct chip8_vm *vm, FILE *out)
+{
+    struct profile *profile = &vm->profile;
+
+    uint64_t instructions = 0;
+    for (uint8_t op = 0; op < OPCODE_COUNT; op++) {
+        instructions += profile->opcodes[op];
+    }
+
+    fprintf(out, "{\n");
+    fprintf(
+        out,
+        "  \"instructions\": %llu,\n",
+        (unsigned long long)instructions);
+    fprintf(out, "  \"draws\": %llu,\n", (unsigned long long)profile->draws);
+    fprintf(out, "  \"clears\": %llu,\n", (unsigned long long)profile->clears);
+    fprintf(
+        out,
+        "  \"resolution_switches\": %llu,\n",
+        (unsigned long long)profile->resolution_switches);
+    fprintf(
+        out,
+        "  \"idle_cycles\": %llu,\n",
+        (unsigned long long)profile->idle_cycles);
+
+    // Every handler decodes before running, so OP_UNDECODED never executes.
+    fprintf(out, "  \"opcodes\": {");
+    for (uint8_t op = OP_UNDECODED + 1; op < OPCODE_COUNT; op++) {
+        fprintf(
+            out,
+            "%s\n    \"%s\": %llu",
+            op > OP_UNDECODED + 1 ? "," : "",
+            opcode_names[op],
+            (unsigned long long)profile->opcodes[op]);
+    }
+    fprintf(out, "\n  },\n");
+
+    fprintf(out, "  \"statuses\": {");
+    for (uint8_t code = 0; code < STATUS_CODE_COUNT; code++) {
+        fprintf(
+            out,
+            "%s\n    \"%s\": %llu",
+            code > 0 ? "," : "",
+            status_names[code],
+            (unsigned long long)profile->statuses[code]);
+    }
+    fprintf(out, "\n  },\n");
+
+    fprintf(out, "  \"addresses\": {");
+    bool first = true;
+    for (uint32_t address = 0; address < MEMORY_SIZE; address++) {
+        if (!profile->addresses[address]) {
+            continue;
+        }
+        fprintf(
+            out,
+            "%s\n    \"0x%03X\": %llu",
+            first ? "" : ",",
+            address,
+            (unsigned long long)profile->addresses[address]);
+        first = false;
+    }
+    fprintf(out, "\n  }\n");
+    fprintf(out, "}\n");
+}
+#endif  // CHIP8_PROFILE
@@ -0,0 +1,88 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cpu.h"
+#include "memory.h"
+
+// Execution counters, compiled in with -DCHIP8_PROFILE=ON.
+//
+// Every counter is updated through the PROFILE_ macros below, which expand to
+// nothing in regular builds, so the instrumented code paths are identical to
+// uninstrumented ones unless profiling is enabled.
+
+struct chip8_vm;
+
+#ifdef CHIP8_PROFILE
+#define DEFAULT_PROFILE_PATH "chip8-profile.json"
+
+// What a machine spent its cycles on.
+struct profile {
+    uint64_t opcodes[OPCODE_COUNT];        // Executions by opcode
+    uint64_t addresses[MEMORY_SIZE];       // Fetches by memory address
+    uint64_t statuses[STATUS_CODE_COUNT];  // CPU cycles by status code
+    uint64_t draws;                        // Calls to draw_sprite()
+    uint64_t clears;                       // Calls to clear_display()
+    uint64_t resolution_switches;          // Calls to set_resolution()
+    uint64_t idle_cycles;                  // Cycles skipped in idle loops
+};
+
+#define PROFILE_FETCH(vm, address) ((vm)->profile.addresses[address]++)
+#define PROFILE_EXECUTE(vm, op) ((vm)->profile.opcodes[op]++)
+#define PROFILE_STATUS(vm, code) ((vm)->profile.statuses[code]++)
+#define PROFILE_DRAW(vm) ((vm)->profile.draws++)
+#define PROFILE_CLEAR(vm) ((vm)->profile.clears++)
+#define PROFILE_RESOLUTION(vm) ((vm)->profile.resolution_switches++)
+#define PROFILE_IDLE(vm, cycles) ((vm)->profile.idle_cycles += (cycles))
+#define PROFILE_POLL(vm) poll_profile(vm)
+
+/**
+ * Sets where profiles are written, and writes one whenever SIGUSR1 arrives.
+ *
+ * The signal only raises a flag, and the profile is written by the next call
+ * to poll_profile(), as writing files is not safe within a signal handler.
+ *
+ * @param path The path of the JSON file to write profiles to.
+ */
+void init_profile(const char *path);
+
+/**
+ * Writes the profile of a machine if it was requested through a signal.
+ *
+ * @param vm The machine to profile.
+ */
+void poll_profile(struct chip8_vm *vm);
+
+/**
+ * Writes the profile of a machine to the path set by init_profile().
+ *
+ * @param vm The machine to profile.
+ * @return If the profile could be written.
+ */
+bool dump_profile(struct chip8_vm *vm);
+
+/**
+ * Writes the profile of a machine as JSON.
+ *
+ * Opcodes and status codes are always listed, even if they never occurred,
+ * while addresses are only listed if they were fetched from at least once.
+ *
+ * @param vm The machine to profile.
+ * @param out The stream to write to.
+ */
+void write_profile(struct chip8_vm *vm, FILE *out);
+#else
+#define PROFILE_FETCH(vm, address) ((void)0)
+#define PROFILE_EXECUTE(vm, op) ((void)0)
+#define PROFILE_STATUS(vm, code) ((void)0)
+#define PROFILE_DRAW(vm) ((void)0)
+#define PROFILE_CLEAR(vm) ((void)0)
+#define PROFILE_RESOLUTION(vm) ((void)0)
+#define PROFILE_IDLE(vm, cycles) ((void)0)
+#define PROFILE_POLL(vm) ((void)0)
+#endif  // CHIP8_PROFILE
+
+#endif  // !PROFILE_H_
@@ -0,0 +1,54 @@
+#include "quirks.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+const struct quirks QUIRK_PROFILES[QUIRK_PROFILE_COUNT] = {
+    [QUIRKS_VIP] = {
+        .vf_reset = true,
+        .shift_vy = true,
+        .jump_vx = false,
+        .index = INDEX_PLUS_X_1,
+        .wrap = false,
+    },
+    [QUIRKS_CHIP48] = {
+        .vf_reset = false,
+        .shift_vy = false,
+        .jump_vx = true,
+        .index = INDEX_PLUS_X,
+        .wrap = false,
+    },
+    [QUIRKS_SCHIP] = {
+        .vf_reset = false,
+        .shift_vy = false,
+        .jump_vx = true,
+        .index = INDEX_KEPT,
+        .wrap = false,
+    },
+    [QUIRKS_MODERN] = {
+        .vf_reset = false,
+        .shift_vy = false,
+        .jump_vx = false,
+        .index = INDEX_KEPT,
+        .wrap = false,
+    },
+};
+
+static const char *const profile_names[QUIRK_PROFILE_COUNT] = {
+    [QUIRKS_VIP] = "vip",
+    [QUIRKS_CHIP48] = "chip48",
+    [QUIRKS_SCHIP] = "schip",
+    [QUIRKS_MODERN] = "modern",
+};
+
+bool find_quirk_profile(const char *name, enum quirk_profile *profile)
+{
+    for (uint8_t i = 0; i < QUIRK_PROFILE_COUNT; i++) {
+        if (strcmp(name, profile_names[i]) == 0) {
+            *profile = i;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,46 @@
+#ifndef QUIRKS_H_
+#define QUIRKS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// How far FX55 and FX65 advance the index register.
+enum index_quirk {
+    INDEX_KEPT,      // I is left unchanged
+    INDEX_PLUS_X,    // I ends on the last register, as on the CHIP-48
+    INDEX_PLUS_X_1,  // I ends past the last register, as on the COSMAC VIP
+};
+
+// The instructions whose behavior differs between interpreters, so ROMs
+// written for one of them only run correctly with its quirks.
+struct quirks {
+    bool vf_reset;           // 8XY1, 8XY2 and 8XY3 reset VF to 0
+    bool shift_vy;           // 8XY6 and 8XYE shift VY into VX
+    bool jump_vx;            // BXNN jumps to XNN + VX instead of NNN + V0
+    enum index_quirk index;  // How far FX55 and FX65 advance I
+    bool wrap;               // Sprites wrap around the screen edges
+};
+
+// The quirks of well-known interpreters.
+enum quirk_profile {
+    QUIRKS_VIP,     // The original COSMAC VIP interpreter
+    QUIRKS_CHIP48,  // CHIP-48 on the HP-48 calculators
+    QUIRKS_SCHIP,   // SUPER-CHIP 1.1, which most 90s ROMs target
+    QUIRKS_MODERN,  // What most modern interpreters do
+    QUIRK_PROFILE_COUNT,
+};
+
+#define DEFAULT_QUIRK_PROFILE QUIRKS_MODERN
+
+extern const struct quirks QUIRK_PROFILES[QUIRK_PROFILE_COUNT];
+
+/**
+ * Looks up a quirk profile by its name.
+ *
+ * @param name The name of the profile: vip, chip48, schip or modern.
+ * @param profile The profile with that name.
+ * @return If a profile with that name exists.
+ */
+bool find_quirk_profile(const char *name, enum quirk_profile *profile);
+
+#endif  // !QUIRKS_H_
@@ -0,0 +1,253 @@
+#include "rewind.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "macros.h"
+#include "memory.h"
+#include "state.h"
+
+#define FRAME_SIZE (2 * sizeof(uint32_t))  // The lengths around every delta
+
+bool init_rewind(struct rewind *r, size_t budget, uint32_t interval)
+{
+    r->ring = malloc(budget);
+    r->capacity = budget;
+    r->start = 0;
+    r->used = 0;
+    r->count = 0;
+    r->interval = interval > 0 ? interval : 1;
+    r->frames = 0;
+    r->has_latest = false;
+    return r->ring != NULL || budget == 0;
+}
+
+void free_rewind(struct rewind *r)
+{
+    free(r->ring);
+    r->ring = NULL;
+    r->capacity = 0;
+}
+
+void record_frame(struct rewind *r, const struct chip8_vm *vm)
+{
+    if (r->has_latest && ++r->frames < r->interval) {
+        return;
+    }
+    r->frames = 0;
+
+    if (!r->has_latest) {
+        save_state(vm, r->latest, sizeof(r->latest));
+        memcpy(r->snapshot, r->latest, STATE_SIZE);
+        memcpy(r->lines, vm->dirty_lines, sizeof(r->lines));
+        r->has_latest = true;
+        return;
+    }
+
+    // The snapshot being captured still equals the latest one, so only what
+    // may have changed since has to be captured, compared and copied over.
+    uint64_t lines[len(r->lines)];
+    for (uint8_t i = 0; i < len(lines); i++) {
+        lines[i] = r->lines[i] | vm->dirty_lines[i];
+    }
+    memcpy(r->lines, vm->dirty_lines, sizeof(r->lines));
+    update_state(vm, r->snapshot, lines);
+
+    // The delta leads from the new snapshot back to the latest one.
+    uint32_t size = encode_delta(r->snapshot, r->latest, lines, r->delta);
+    copy_changes(r->latest, r->snapshot, lines);
+
+    // Make room by dropping the oldest deltas, unless it would never fit.
+    if (size + FRAME_SIZE > r->capacity) {
+        r->start = r->used = r->count = 0;
+        return;
+    }
+    while (r->used + size + FRAME_SIZE > r->capacity) {
+        uint32_t oldest;
+        read_ring(r, r->start, &oldest, sizeof(oldest));
+        r->start = (r->start + oldest + FRAME_SIZE) % r->capacity;
+        r->used -= oldest + FRAME_SIZE;
+        r->count--;
+    }
+
+    size_t end = r->start + r->used;
+    write_ring(r, end, &size, sizeof(size));
+    write_ring(r, end + sizeof(size), r->delta, size);
+    write_ring(r, end + sizeof(size) + size, &size, sizeof(size));
+    r->used += size + FRAME_SIZE;
+    r->count++;
+}
+
+bool rewind_frame(struct rewind *r, struct chip8_vm *vm)
+{
+    if (!r->has_latest) {
+        return false;
+    }
+
+    bool stepped = r->count > 0;
+    if (stepped) {
+        uint32_t size;
+        size_t end = r->start + r->used;
+        read_ring(r, end - sizeof(size), &size, sizeof(size));
+        read_ring(r, end - sizeof(size) - size, r->delta, size);
+        apply_delta(r->latest, r->delta);
+        r->used -= size + FRAME_SIZE;
+        r->count--;
+    }
+
+    r->frames = 0;
+    load_state(vm, r->latest, STATE_SIZE);
+    memcpy(r->snapshot, r->latest, STATE_SIZE);
+    memcpy(r->lines, vm->dirty_lines, sizeof(r->lines));
+    return stepped;
+}
+
+static size_t encode_delta(
+    const uint8_t *from,
+    const uint8_t *to,
+    const uint64_t *lines,
+    uint8_t *out)
+{
+    uint8_t *start = out;
+    size_t zeroes = 0;
+    out = encode_range(from, to, 0, STATE_MEMORY_OFFSET, &zeroes, out);
+
+    // Lines of memory that can not differ count as zeroes without comparing.
+    for (uint16_t line = 0; line < MEMORY_LINES; line++) {
+        size_t offset = STATE_MEMORY_OFFSET + line * MEMORY_LINE_SIZE;
+        if (lines[line / 64] & (uint64_t)1 << (line % 64)) {
+            out = encode_range(
+                from, to, offset, offset + MEMORY_LINE_SIZE, &zeroes, out);
+        } else {
+            zeroes += MEMORY_LINE_SIZE;
+        }
+    }
+
+    size_t display = STATE_MEMORY_OFFSET + MEMORY_SIZE;
+    out = encode_range(from, to, display, STATE_SIZE, &zeroes, out);
+    if (zeroes > 0) {
+        out = put_length(out, zeroes);
+        out = put_length(out, 0);
+    }
+    return out - start;
+}
+
+static uint8_t *encode_range(
+    const uint8_t *from,
+    const uint8_t *to,
+    size_t start,
+    size_t end,
+    size_t *zeroes,
+    uint8_t *out)
+{
+    size_t i = start;
+    while (i < end) {
+        // Most of the snapshot is unchanged, so skip over whole words first.
+        while (i + sizeof(uint64_t) <= end &&
+               memcmp(&from[i], &to[i], sizeof(uint64_t)) == 0) {
+            i += sizeof(uint64_t);
+            *zeroes += sizeof(uint64_t);
+        }
+        while (i < end && from[i] == to[i]) {
+            i++;
+            (*zeroes)++;
+        }
+
+        size_t literals = 0;
+        while (i + literals < end && from[i + literals] != to[i + literals]) {
+            literals++;
+        }
+        if (literals == 0) {
+            break;
+        }
+
+        out = put_length(out, *zeroes);
+        out = put_length(out, literals);
+        for (size_t n = 0; n < literals; n++, i++) {
+            *out++ = from[i] ^ to[i];
+        }
+        *zeroes = 0;
+    }
+    return out;
+}
+
+static void copy_changes(
+    uint8_t *to,
+    const uint8_t *from,
+    const uint64_t *lines)
+{
+    memcpy(to, from, STATE_MEMORY_OFFSET);
+    for (uint16_t word = 0; word < MEMORY_LINES / 64; word++) {
+        uint64_t bits = lines[word];
+        for (uint8_t bit = 0; bits != 0; bit++, bits >>= 1) {
+            if (bits & 1) {
+                size_t offset = STATE_MEMORY_OFFSET +
+                                (word * 64 + bit) * MEMORY_LINE_SIZE;
+                memcpy(&to[offset], &from[offset], MEMORY_LINE_SIZE);
+            }
+        }
+    }
+
+    size_t display = STATE_MEMORY_OFFSET + MEMORY_SIZE;
+    memcpy(&to[display], &from[display], STATE_DISPLAY_SIZE);
+}
+
+static void apply_delta(uint8_t *snapshot, const uint8_t *delta)
+{
+    size_t i = 0;
+    while (i < STATE_SIZE) {
+        size_t zeroes = get_length(&delta);
+        size_t literals = get_length(&delta);
+
+        i += zeroes;
+        for (size_t n = 0; n < literals; n++, i++) {
+            snapshot[i] ^= *delta++;
+        }
+    }
+}
+
+static uint8_t *put_length(uint8_t *out, size_t length)
+{
+    while (length > 0x7F) {
+        *out++ = (length & 0x7F) | 0x80;
+        length >>= 7;
+    }
+    *out++ = length;
+    return out;
+}
+
+static size_t get_length(const uint8_t **in)
+{
+    size_t length = 0;
+    for (uint8_t shift = 0; true; shift += 7) {
+        uint8_t byte = *(*in)++;
+        length |= (size_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return length;
+        }
+    }
+}
+
+static void write_ring(
+    struct rewind *r,
+    size_t offset,
+    const void *data,
+    size_t size)
+{
+    offset %= r->capacity;
+    size_t head = r->capacity - offset < size ? r->capacity - offset : size;
+    memcpy(&r->ring[offset], data, head);
+    memcpy(r->ring, (const uint8_t *)data + head, size - head);
+}
+
+static void read_ring(struct rewind *r, size_t offset, void *data, size_t size)
+{
+    offset %= r->capacity;
+    size_t head = r->capacity - offset < size ? r->capacity - offset : size;
+    memcpy(data, &r->ring[offset], head);
+    memcpy((uint8_t *)data + head, r->ring, size - head);
+}
@@ -0,0 +1,192 @@
+#ifndef REWIND_H_
+#define REWIND_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "state.h"
+
+#define DEFAULT_REWIND_BUDGET (4 * 1024 * 1024)  // Bytes of deltas to keep
+#define DEFAULT_REWIND_INTERVAL 1                // Frames between snapshots
+
+// The largest a single encoded delta can get, when every other byte changed.
+#define MAX_DELTA_SIZE (STATE_SIZE * 2)
+
+struct chip8_vm;
+
+// Snapshots of a machine to step back through, newest first.
+//
+// Only the latest snapshot is kept in full. Every older one is stored as the
+// XOR of it and the snapshot after it, run-length encoded, as little of the
+// machine changes between frames and the XOR is mostly zeroes. Stepping back
+// applies the newest delta to the latest snapshot, and the oldest delta is
+// dropped whenever a new one does not fit, so the history always covers as
+// much time as the budget allows.
+//
+// Only the lines of memory the machine wrote to by either of two snapshots can
+// differ between them, as every other line still holds what it did when the
+// machine was initialized or last reset, so only those lines are captured and
+// compared. Capturing thus costs about as much as the machine's registers and
+// display, plus the memory it wrote to, which is about 4 µs a frame.
+//
+// Every delta is framed by its length on both sides in the ring, so it can be
+// found from either end.
+struct rewind {
+    uint8_t *ring;                  // The encoded deltas, oldest first
+    size_t capacity;                // The size of the ring in bytes
+    size_t start;                   // Offset of the oldest delta in the ring
+    size_t used;                    // Bytes of the ring taken by deltas
+    uint32_t count;                 // Deltas in the ring
+    uint32_t interval;              // Frames between snapshots
+    uint32_t frames;                // Frames since the latest snapshot
+    bool has_latest;                // If a snapshot was captured at all
+    uint8_t latest[STATE_SIZE];     // The latest snapshot, in full
+    uint8_t snapshot[STATE_SIZE];   // The snapshot being captured
+    uint8_t delta[MAX_DELTA_SIZE];  // The delta being encoded or decoded
+
+    // The machine's dirty lines of memory as of the latest snapshot.
+    uint64_t lines[MEMORY_LINES / 64];
+};
+
+/**
+ * Allocates the history of snapshots.
+ *
+ * @param r The history to initialize.
+ * @param budget The bytes to hold deltas in, besides the latest snapshot.
+ * @param interval The amount of frames between snapshots, at least 1.
+ * @return If the history could be allocated.
+ */
+bool init_rewind(struct rewind *r, size_t budget, uint32_t interval);
+
+/**
+ * Releases the history of snapshots.
+ *
+ * @param r The history to release.
+ */
+void free_rewind(struct rewind *r);
+
+/**
+ * Notes that a machine ran another frame, capturing a snapshot of it once
+ * every interval.
+ *
+ * @param r The history to capture into.
+ * @param vm The machine that ran the frame.
+ */
+void record_frame(struct rewind *r, const struct chip8_vm *vm);
+
+/**
+ * Steps back to the previous snapshot, and restores a machine to it.
+ *
+ * Once the history is exhausted, the machine is restored to the oldest
+ * snapshot left instead, so holding the rewind key stays on it.
+ *
+ * @param r The history to step back through.
+ * @param vm The machine to restore.
+ * @return If there was an earlier snapshot to step back to.
+ */
+bool rewind_frame(struct rewind *r, struct chip8_vm *vm);
+
+/**
+ * Encodes the difference between two snapshots.
+ *
+ * The XOR of both is stored as alternating runs of zeroes and literal bytes,
+ * each preceded by its length as a LEB128 number.
+ *
+ * @param from The snapshot to encode against.
+ * @param to The snapshot to encode.
+ * @param lines The lines of memory that may differ, as a bit per line.
+ * @param out The buffer for the delta, at least MAX_DELTA_SIZE bytes.
+ * @return The size of the delta.
+ */
+static size_t encode_delta(
+    const uint8_t *from,
+    const uint8_t *to,
+    const uint64_t *lines,
+    uint8_t *out);
+
+/**
+ * Encodes the difference between a range of two snapshots.
+ *
+ * Runs of zeroes carry over from one range to the next, but runs of literals
+ * end with their range.
+ *
+ * @param from The snapshot to encode against.
+ * @param to The snapshot to encode.
+ * @param start The offset of the range.
+ * @param end The offset just past the range.
+ * @param zeroes The length of the run of zeroes so far, updated for the next
+ * range.
+ * @param out The position to write the delta to.
+ * @return The position after the delta of the range.
+ */
+static uint8_t *encode_range(
+    const uint8_t *from,
+    const uint8_t *to,
+    size_t start,
+    size_t end,
+    size_t *zeroes,
+    uint8_t *out);
+
+/**
+ * Copies the parts of a snapshot that may have changed into another.
+ *
+ * @param to The snapshot to copy into.
+ * @param from The snapshot to copy from.
+ * @param lines The lines of memory that may differ, as a bit per line.
+ */
+static void copy_changes(
+    uint8_t *to,
+    const uint8_t *from,
+    const uint64_t *lines);
+
+/**
+ * Applies a delta to a snapshot, XORing it in place.
+ *
+ * @param snapshot The snapshot to apply the delta to.
+ * @param delta The delta to apply.
+ */
+static void apply_delta(uint8_t *snapshot, const uint8_t *delta);
+
+/**
+ * Writes the length of a run as a LEB128 number.
+ *
+ * @param out The position to write to.
+ * @param length The length to write.
+ * @return The position after the length.
+ */
+static uint8_t *put_length(uint8_t *out, size_t length);
+
+/**
+ * Reads the length of a run as a LEB128 number.
+ *
+ * @param in The position to read from, advanced past the length.
+ * @return The length that was read.
+ */
+static size_t get_length(const uint8_t **in);
+
+/**
+ * Writes bytes into the ring, wrapping around its end.
+ *
+ * @param r The history whose ring to write.
+ * @param offset The offset to write at, which may be past the end.
+ * @param data The bytes to write.
+ * @param size The amount of bytes to write.
+ */
+static void write_ring(
+    struct rewind *r,
+    size_t offset,
+    const void *data,
+    size_t size);
+
+/**
+ * Reads bytes from the ring, wrapping around its end.
+ *
+ * @param r The history whose ring to read.
+ * @param offset The offset to read at, which may be past the end.
+ * @param data The buffer to read into.
+ * @param size The amount of bytes to read.
+ */
+static void read_ring(struct rewind *r, size_t offset, void *data, size_t size);
+
+#endif  // !REWIND_H_
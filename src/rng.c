@@ -0,0 +1,35 @@
+#include "rng.h"
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define PCG_MULTIPLIER 6364136223846793005ULL
+#define PCG_INCREMENT 1442695040888963407ULL
+
+void seed_rng(struct chip8_vm *vm, uint64_t seed)
+{
+    vm->rng.seed = seed;
+    reset_rng(vm);
+}
+
+void reset_rng(struct chip8_vm *vm)
+{
+    // Mix the seed in as the reference implementation does, so neighbouring
+    // seeds start out far apart.
+    vm->rng.state = 0;
+    next_random(vm);
+    vm->rng.state += vm->rng.seed;
+    next_random(vm);
+}
+
+uint32_t next_random(struct chip8_vm *vm)
+{
+    uint64_t state = vm->rng.state;
+    vm->rng.state = state * PCG_MULTIPLIER + PCG_INCREMENT;
+
+    // XSH RR: xorshift the high bits down, then rotate by the top five.
+    uint32_t shifted = ((state >> 18) ^ state) >> 27;
+    uint32_t rotation = state >> 59;
+    return (shifted >> rotation) | (shifted << (-rotation & 31));
+}
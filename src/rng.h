@@ -0,0 +1,46 @@
+#ifndef RNG_H_
+#define RNG_H_
+
+#include <stdint.h>
+
+#define DEFAULT_SEED 0x43484950  // "CHIP", so every run is reproducible
+
+struct chip8_vm;
+
+// A PCG32 random number generator, one per machine.
+//
+// The C library's rand() is shared by every thread, takes a lock on some
+// libcs, and produces different numbers on each of them, so machines running
+// the same program with the same seed would not stay in sync.
+struct rng {
+    uint64_t state;  // Advanced by every number drawn
+    uint64_t seed;   // Restored by every program that is loaded
+};
+
+/**
+ * Seeds the random number generator of a machine.
+ *
+ * The seed persists across loaded programs, so every run of a program draws
+ * the same numbers.
+ *
+ * @param vm The machine to seed.
+ * @param seed The seed to draw numbers from.
+ */
+void seed_rng(struct chip8_vm *vm, uint64_t seed);
+
+/**
+ * Restarts the random number generator from its seed.
+ *
+ * @param vm The machine whose generator to restart.
+ */
+void reset_rng(struct chip8_vm *vm);
+
+/**
+ * Draws the next random number.
+ *
+ * @param vm The machine to draw from.
+ * @return A uniformly distributed 32-bit number.
+ */
+uint32_t next_random(struct chip8_vm *vm);
+
+#endif  // !RNG_H_
@@ -0,0 +1,120 @@
+#include "scheduler.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio.h"
+#include "chip8.h"
+#include "cpu.h"
+#include "profile.h"
+
+void reset_scheduler(struct chip8_vm *vm)
+{
+    vm->delay_timer = 0;
+    vm->sound_timer = 0;
+    vm->scheduler.remainder = 0;
+    start_tick(vm);
+}
+
+void set_instructions_per_second(struct chip8_vm *vm, uint32_t ips)
+{
+    if (ips < MIN_INSTRUCTIONS_PER_SECOND) {
+        ips = MIN_INSTRUCTIONS_PER_SECOND;
+    }
+    vm->scheduler.instructions_per_second = ips;
+    if (vm->scheduler.tick_cycles > MAX_TICK_CYCLES(ips)) {
+        vm->scheduler.tick_cycles = MAX_TICK_CYCLES(ips);
+    }
+}
+
+void set_idle_skipping(struct chip8_vm *vm, bool skip)
+{
+    vm->scheduler.skip_idle = skip;
+}
+
+uint64_t run_scheduled(
+    struct chip8_vm *vm,
+    uint64_t count,
+    struct cpu_status *status)
+{
+    status->code = SUCCESS;
+    status->instruction = 0x0000;
+
+    uint64_t executed = 0;
+    while (executed < count) {
+        uint64_t chunk = count - executed;
+        if (chunk > vm->scheduler.tick_cycles) {
+            chunk = vm->scheduler.tick_cycles;
+        }
+
+        // An idle loop is usually entered within a tick, and then skipped
+        // from the start of the next one onwards.
+        uint64_t ran = 0;
+        if (vm->scheduler.skip_idle) {
+            ran = skip_idle_loop(vm, chunk);
+        }
+        if (ran < chunk) {
+            ran += run_cycles(vm, chunk - ran, status);
+        }
+
+        // A wait for a key idles until the next sample of the keypad, so the
+        // rest of the chunk passes without running anything.
+        if (status->code == WAITING_FOR_KEY) {
+            PROFILE_IDLE(vm, chunk - ran);
+            ran = chunk;
+            status->code = SUCCESS;
+        }
+        executed += ran;
+        vm->scheduler.tick_cycles -= ran;
+
+        // Tick even if the last cycle failed, as the tick was still completed.
+        if (vm->scheduler.tick_cycles == 0) {
+            tick_timers(vm);
+        }
+        if (status->code) {
+            break;
+        }
+    }
+
+    return executed;
+}
+
+uint64_t run_frame(struct chip8_vm *vm, struct cpu_status *status)
+{
+    return run_scheduled(vm, vm->scheduler.tick_cycles, status);
+}
+
+uint64_t frames_to_cycles(struct chip8_vm *vm, uint64_t frames)
+{
+    return frames * vm->scheduler.instructions_per_second / TIMER_FREQUENCY;
+}
+
+static void tick_timers(struct chip8_vm *vm)
+{
+    // The tick sounds as long as the timer ran throughout it.
+    if (vm->audio_out != NULL) {
+        play_tick(vm);
+    }
+
+    if (vm->delay_timer > 0) {
+        vm->delay_timer--;
+    }
+    if (vm->sound_timer > 0) {
+        vm->sound_timer--;
+    }
+
+    // Keys released before the tick no longer end a wait for a key.
+    vm->keypad.released = 0;
+
+    start_tick(vm);
+}
+
+static void start_tick(struct chip8_vm *vm)
+{
+    // Tick k ends after floor(k * ips / 60) cycles in total, so the lengths of
+    // the ticks only differ by a single cycle and never drift.
+    uint32_t total = vm->scheduler.remainder +
+                     vm->scheduler.instructions_per_second;
+    vm->scheduler.tick_cycles = total / TIMER_FREQUENCY;
+    vm->scheduler.remainder = total % TIMER_FREQUENCY;
+}
@@ -0,0 +1,119 @@
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+#define TIMER_FREQUENCY 60  // The delay and sound timers tick at 60 Hz
+
+// Every timer tick runs at least one instruction, so ticks never pass without
+// the CPU getting a chance to observe them.
+#define MIN_INSTRUCTIONS_PER_SECOND TIMER_FREQUENCY
+
+// The most cycles a tick at a rate takes, as the fractions of a cycle carried
+// over from earlier ticks add up to less than one.
+#define MAX_TICK_CYCLES(ips) ((ips) / TIMER_FREQUENCY + 1)
+
+struct chip8_vm;
+
+// Tracks emulated time in CPU cycles, and when the timers tick next.
+//
+// The cycles of every tick are distributed with an exact rational
+// accumulator, so any amount of ticks runs exactly as many instructions as
+// the rate prescribes, even if it does not divide by the timer frequency.
+struct scheduler {
+    uint32_t instructions_per_second;  // The emulated CPU speed
+    uint32_t remainder;                // Fractions of a cycle carried over
+    uint32_t tick_cycles;              // Cycles left until the next tick
+    bool skip_idle;                    // If idle loops skip to the next tick
+};
+
+/**
+ * Resets the timers and the progress towards their next tick.
+ *
+ * Keeps the emulated CPU speed, so it persists across loaded programs.
+ *
+ * @param vm The machine to reset.
+ */
+void reset_scheduler(struct chip8_vm *vm);
+
+/**
+ * Sets the emulated CPU speed.
+ *
+ * Takes effect from the next timer tick onwards, so the current tick keeps its
+ * length, unless it is longer than any tick at the new speed.
+ *
+ * @param vm The machine to configure.
+ * @param ips The amount of instructions to run per second, raised to at least
+ * MIN_INSTRUCTIONS_PER_SECOND.
+ */
+void set_instructions_per_second(struct chip8_vm *vm, uint32_t ips);
+
+/**
+ * Sets if idle loops skip ahead to the next timer tick.
+ *
+ * Enabled by default. Skipping leaves the exact same state behind as running
+ * the idle loops, so this only affects how much host time they take.
+ *
+ * @param vm The machine to configure.
+ * @param skip If idle loops should be skipped.
+ */
+void set_idle_skipping(struct chip8_vm *vm, bool skip);
+
+/**
+ * Runs CPU cycles, ticking the timers whenever a tick's worth was run.
+ *
+ * Idle loops waiting for the timers are skipped up to the next tick rather
+ * than run, and still count towards the cycles that were run. Stops early if
+ * any cycle reports an error, in which case the next run picks up within the
+ * same tick. A wait for a key idles the rest of its tick, and once no timer
+ * runs either, see is_blocked_on_keys(), ticks leave the machine as it was
+ * until the keys change, so callers may stop running it until then.
+ *
+ * @param vm The machine to run.
+ * @param count The maximum amount of CPU cycles to run.
+ * @param status Meta information about the last CPU cycle that was run.
+ * @return The amount of CPU cycles that were run.
+ */
+uint64_t run_scheduled(
+    struct chip8_vm *vm,
+    uint64_t count,
+    struct cpu_status *status);
+
+/**
+ * Runs CPU cycles up to and including the next tick of the timers.
+ *
+ * @param vm The machine to run.
+ * @param status Meta information about the last CPU cycle that was run.
+ * @return The amount of CPU cycles that were run.
+ */
+uint64_t run_frame(struct chip8_vm *vm, struct cpu_status *status);
+
+/**
+ * Calculates the amount of CPU cycles of a number of timer ticks.
+ *
+ * Exact for any amount of ticks following a reset of the scheduler.
+ *
+ * @param vm The machine whose CPU speed to use.
+ * @param frames The amount of timer ticks.
+ * @return The amount of CPU cycles.
+ */
+uint64_t frames_to_cycles(struct chip8_vm *vm, uint64_t frames);
+
+/**
+ * Advances the scheduler to the next timer tick, and ticks the timers.
+ *
+ * @param vm The machine whose timers to tick.
+ */
+static void tick_timers(struct chip8_vm *vm);
+
+/**
+ * Starts a new timer tick, distributing the rate's cycles over the ticks.
+ *
+ * @param vm The machine whose scheduler to advance.
+ */
+static void start_tick(struct chip8_vm *vm);
+
+#endif  // !SCHEDULER_H_
@@ -0,0 +1,48 @@
+#include "sound.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio.h"
+#include "chip8.h"
+#include "raylib.h"
+
+// Raylib's stream callbacks take no context, so the single output played
+// through the window lives here, like the display's texture.
+static struct audio_output output;
+static AudioStream stream;
+static bool playing = false;
+
+bool init_sound(struct chip8_vm *vm)
+{
+    InitAudioDevice();
+    if (!IsAudioDeviceReady()) {
+        return false;
+    }
+
+    init_audio_output(&output);
+    stream = LoadAudioStream(SAMPLE_RATE, 16, 1);
+    SetAudioStreamCallback(stream, fill_stream);
+    set_audio_output(vm, &output);
+    PlayAudioStream(stream);
+    playing = true;
+    return true;
+}
+
+void unload_sound(struct chip8_vm *vm)
+{
+    if (!playing) {
+        return;
+    }
+
+    set_audio_output(vm, NULL);
+    StopAudioStream(stream);
+    UnloadAudioStream(stream);
+    CloseAudioDevice();
+    playing = false;
+}
+
+static void fill_stream(void *buffer, unsigned int frames)
+{
+    drain_audio(&output, buffer, frames);
+}
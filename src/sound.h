@@ -0,0 +1,38 @@
+#ifndef SOUND_H_
+#define SOUND_H_
+
+#include <stdbool.h>
+
+struct chip8_vm;
+
+/**
+ * Opens the Raylib audio device, and plays the sound of a machine on it.
+ *
+ * The machine renders its samples every timer tick, which a Raylib audio
+ * stream drains on the audio thread, so neither thread ever waits for the
+ * other.
+ *
+ * @param vm The machine whose sound to play.
+ * @return If the audio device could be opened, otherwise the machine stays
+ * silent.
+ */
+bool init_sound(struct chip8_vm *vm);
+
+/**
+ * Stops playing the sound of a machine, and closes the Raylib audio device.
+ *
+ * Does nothing if init_sound() failed or was never called.
+ *
+ * @param vm The machine whose sound to stop.
+ */
+void unload_sound(struct chip8_vm *vm);
+
+/**
+ * Fills a buffer of the Raylib audio stream, on the audio thread.
+ *
+ * @param buffer The 16-bit mono samples to fill in.
+ * @param frames The amount of samples to fill in.
+ */
+static void fill_stream(void *buffer, unsigned int frames);
+
+#endif  // !SOUND_H_
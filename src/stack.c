@@ -1,7 +1,6 @@
 #include "stack.h"
 
 #include <stdint.h>
-#include <stdio.h>
 
 void init_stack(stack *s)
 {
@@ -14,7 +13,6 @@ void init_stack(stack *s)
 bool push(stack *s, uint16_t address)
 {
     if (s->pointer == STACK_SIZE - 1) {
-        printf("Stack overflow!");
         return false;
     }
 
@@ -25,7 +23,6 @@ bool push(stack *s, uint16_t address)
 bool pop(stack *s, uint16_t *address)
 {
     if (s->pointer == -1) {
-        printf("Stack underflow!");
         return false;
     }
 
@@ -36,7 +33,6 @@ bool pop(stack *s, uint16_t *address)
 bool peek(stack *s, uint16_t *address)
 {
     if (s->pointer == -1) {
-        printf("Stack underflow!");
         return false;
     }
 
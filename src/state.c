@@ -0,0 +1,204 @@
+#include "state.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio.h"
+#include "bytes.h"
+#include "chip8.h"
+#include "memory.h"
+#include "scheduler.h"
+
+// The words of all planes of the display, which are stored back to back.
+#define DISPLAY_WORDS (STATE_DISPLAY_SIZE / sizeof(uint64_t))
+
+size_t save_state(const struct chip8_vm *vm, uint8_t *buffer, size_t size)
+{
+    if (size < STATE_SIZE) {
+        return 0;
+    }
+
+    uint8_t *out = save_registers(vm, buffer);
+    memcpy(out, vm->memory, MEMORY_SIZE);
+    out += MEMORY_SIZE;
+    put_u64_array(&out, &vm->display[0][0][0], DISPLAY_WORDS);
+
+    return out - buffer;
+}
+
+void update_state(
+    const struct chip8_vm *vm,
+    uint8_t *buffer,
+    const uint64_t *lines)
+{
+    uint8_t *out = save_registers(vm, buffer);
+    for (uint16_t word = 0; word < MEMORY_LINES / 64; word++) {
+        uint64_t bits = lines[word];
+        for (uint8_t bit = 0; bits != 0; bit++, bits >>= 1) {
+            if (bits & 1) {
+                uint32_t address = (word * 64 + bit) * MEMORY_LINE_SIZE;
+                memcpy(&out[address], &vm->memory[address], MEMORY_LINE_SIZE);
+            }
+        }
+    }
+    out += MEMORY_SIZE;
+    put_u64_array(&out, &vm->display[0][0][0], DISPLAY_WORDS);
+}
+
+bool load_state(struct chip8_vm *vm, const uint8_t *buffer, size_t size)
+{
+    if (size != STATE_SIZE || memcmp(buffer, STATE_MAGIC, 4) != 0) {
+        return false;
+    }
+
+    const uint8_t *in = buffer + 4;
+    if (get_u16(&in) != STATE_VERSION) {
+        return false;
+    }
+
+    // Validate everything the CPU relies on before touching the machine.
+    const uint8_t *registers = in;
+    in += 2 + 2 + sizeof(vm->V) + 1 + 1;
+    int8_t pointer = (int8_t)*in++;
+    const uint8_t *addresses = in;
+    in += STACK_SIZE * 2;
+    uint32_t ips = get_u32(&in);
+    uint32_t remainder = get_u32(&in);
+    uint32_t tick_cycles = get_u32(&in);
+    uint64_t rng_state = get_u64(&in);
+    const uint8_t *flags = in;
+    in += sizeof(vm->flags);
+    uint8_t hires = *in++;
+    uint8_t planes = *in++;
+    const uint8_t *audio = in;
+    in += AUDIO_PATTERN_SIZE + 1;
+    if (pointer < -1 || pointer >= STACK_SIZE ||
+        ips < MIN_INSTRUCTIONS_PER_SECOND || remainder >= TIMER_FREQUENCY ||
+        tick_cycles == 0 || tick_cycles > MAX_TICK_CYCLES(ips) ||
+        hires > 1 || planes >= 1 << PLANE_COUNT) {
+        return false;
+    }
+
+    vm->PC = get_u16(&registers);
+    vm->I = get_u16(&registers);
+    memcpy(vm->V, registers, sizeof(vm->V));
+    registers += sizeof(vm->V);
+    vm->delay_timer = *registers++;
+    vm->sound_timer = *registers++;
+
+    vm->stack.pointer = pointer;
+    for (uint8_t i = 0; i < STACK_SIZE; i++) {
+        vm->stack.addresses[i] = get_u16(&addresses);
+    }
+
+    vm->scheduler.instructions_per_second = ips;
+    vm->scheduler.remainder = remainder;
+    vm->scheduler.tick_cycles = tick_cycles;
+    vm->rng.state = rng_state;
+    memcpy(vm->flags, flags, sizeof(vm->flags));
+    vm->hires = hires;
+    vm->planes = planes;
+    set_audio_pattern(vm, audio);
+    set_pitch(vm, audio[AUDIO_PATTERN_SIZE]);
+
+    // Keys released before the state was loaded must not end a wait in it.
+    vm->keypad.released = 0;
+
+    // Only invalidate the range of memory that actually changed, which is
+    // usually small when restoring a checkpoint of the running program.
+    if (memcmp(vm->memory, in, MEMORY_SIZE) != 0) {
+        uint16_t first = 0;
+        while (vm->memory[first] == in[first]) {
+            first++;
+        }
+        uint16_t last = MEMORY_SIZE - 1;
+        while (vm->memory[last] == in[last]) {
+            last--;
+        }
+        memcpy(&vm->memory[first], &in[first], last - first + 1);
+        mark_memory_written(vm, first, last - first + 1);
+    }
+    in += MEMORY_SIZE;
+
+    get_u64_array(&in, &vm->display[0][0][0], DISPLAY_WORDS);
+    vm->drawn_rows = UINT64_MAX;
+    vm->display_dirty = true;
+
+    return true;
+}
+
+bool save_state_file(const struct chip8_vm *vm, const char *path)
+{
+    // Save states are too large to comfortably live on the stack.
+    uint8_t *buffer = malloc(STATE_SIZE);
+    if (buffer == NULL) {
+        return false;
+    }
+    size_t size = save_state(vm, buffer, STATE_SIZE);
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        free(buffer);
+        return false;
+    }
+    bool written = fwrite(buffer, 1, size, f) == size;
+    free(buffer);
+    return fclose(f) == 0 && written;
+}
+
+bool load_state_file(struct chip8_vm *vm, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+
+    // Read a byte more than expected, so longer files are rejected too.
+    uint8_t *buffer = malloc(STATE_SIZE + 1);
+    if (buffer == NULL) {
+        fclose(f);
+        return false;
+    }
+    size_t size = fread(buffer, 1, STATE_SIZE + 1, f);
+    fclose(f);
+
+    bool loaded = load_state(vm, buffer, size);
+    free(buffer);
+    return loaded;
+}
+
+static uint8_t *save_registers(const struct chip8_vm *vm, uint8_t *out)
+{
+    memcpy(out, STATE_MAGIC, 4);
+    out += 4;
+    put_u16(&out, STATE_VERSION);
+
+    put_u16(&out, vm->PC);
+    put_u16(&out, vm->I);
+    memcpy(out, vm->V, sizeof(vm->V));
+    out += sizeof(vm->V);
+    *out++ = vm->delay_timer;
+    *out++ = vm->sound_timer;
+
+    *out++ = (uint8_t)vm->stack.pointer;
+    for (uint8_t i = 0; i < STACK_SIZE; i++) {
+        put_u16(&out, vm->stack.addresses[i]);
+    }
+
+    put_u32(&out, vm->scheduler.instructions_per_second);
+    put_u32(&out, vm->scheduler.remainder);
+    put_u32(&out, vm->scheduler.tick_cycles);
+    put_u64(&out, vm->rng.state);
+    memcpy(out, vm->flags, sizeof(vm->flags));
+    out += sizeof(vm->flags);
+    *out++ = vm->hires;
+    *out++ = vm->planes;
+    memcpy(out, vm->audio.pattern, AUDIO_PATTERN_SIZE);
+    out += AUDIO_PATTERN_SIZE;
+    *out++ = vm->audio.pitch;
+    return out;
+}
@@ -0,0 +1,114 @@
+#ifndef STATE_H_
+#define STATE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "audio.h"
+#include "cpu.h"
+#include "display.h"
+#include "memory.h"
+#include "stack.h"
+
+#define STATE_MAGIC "CH8S"  // Identifies save states, without a terminator
+#define STATE_VERSION 4     // Bumped whenever the layout below changes
+
+// The size of a save state, which the current version lays out as follows,
+// with all values in little-endian byte order:
+//
+// - The magic bytes and the version.
+// - PC, I, V0 through VF, and the delay and sound timers.
+// - The stack pointer and all stack entries, including popped ones.
+// - The CPU speed and the progress towards the next timer tick.
+// - The state of the random number generator, and the flag registers.
+// - If the display is in high resolution, and the selected planes.
+// - The audio pattern and the pitch.
+// - The whole memory, and every plane of the display as two 64-bit words per
+//   row.
+//
+// Anything derived from these, such as decoded instructions, is rebuilt after
+// loading, and host settings, such as the core, are kept as they are.
+#define STATE_SIZE                                                 \
+    (4 + 2 + 2 + 2 + 16 + 1 + 1 + 1 + STACK_SIZE * 2 + 4 + 4 + 4 + \
+     8 + FLAG_REGISTERS + 1 + 1 + AUDIO_PATTERN_SIZE + 1 +         \
+     MEMORY_SIZE + STATE_DISPLAY_SIZE)
+
+// Where the memory starts in a save state, and the size of the display after
+// it, which make up the end of the save state.
+#define STATE_MEMORY_OFFSET (STATE_SIZE - MEMORY_SIZE - STATE_DISPLAY_SIZE)
+#define STATE_DISPLAY_SIZE (PLANE_COUNT * HIRES_SCREEN_HEIGHT * ROW_WORDS * 8)
+
+struct chip8_vm;
+
+/**
+ * Captures the state of a machine into a buffer.
+ *
+ * @param vm The machine to capture.
+ * @param buffer The buffer to write the save state to.
+ * @param size The size of the buffer, at least STATE_SIZE.
+ * @return The amount of bytes written, or 0 if the buffer is too small.
+ */
+size_t save_state(const struct chip8_vm *vm, uint8_t *buffer, size_t size);
+
+/**
+ * Updates an earlier save state of a machine to its current state.
+ *
+ * Everything but the memory is captured in full, but of the memory, only the
+ * given lines are. The rest of the memory has to be unchanged since the save
+ * state was captured.
+ *
+ * @param vm The machine to capture.
+ * @param buffer The earlier save state, STATE_SIZE bytes.
+ * @param lines The lines of memory to capture, as a bit per line, like the
+ * dirty lines of the machine.
+ */
+void update_state(
+    const struct chip8_vm *vm,
+    uint8_t *buffer,
+    const uint64_t *lines);
+
+/**
+ * Restores the state of a machine from a buffer.
+ *
+ * The save state is validated in full before the machine is touched, so a
+ * rejected save state leaves the machine as it was. Only the memory that
+ * differs from the save state is invalidated, so restoring a checkpoint of the
+ * running program keeps most of its decoded instructions. The keys held down
+ * are kept, but pending releases are dropped.
+ *
+ * @param vm The machine to restore, initialized with init_vm().
+ * @param buffer The save state to restore.
+ * @param size The size of the save state.
+ * @return If the save state was valid and restored.
+ */
+bool load_state(struct chip8_vm *vm, const uint8_t *buffer, size_t size);
+
+/**
+ * Captures the state of a machine into a file.
+ *
+ * @param vm The machine to capture.
+ * @param path The path of the file to write.
+ * @return If the file could be written.
+ */
+bool save_state_file(const struct chip8_vm *vm, const char *path);
+
+/**
+ * Restores the state of a machine from a file.
+ *
+ * @param vm The machine to restore, initialized with init_vm().
+ * @param path The path of the file to read.
+ * @return If the file could be read and held a valid save state.
+ */
+bool load_state_file(struct chip8_vm *vm, const char *path);
+
+/**
+ * Captures everything of a machine that precedes its memory in a save state.
+ *
+ * @param vm The machine to capture.
+ * @param out The start of the save state to write.
+ * @return The position of the memory in the save state.
+ */
+static uint8_t *save_registers(const struct chip8_vm *vm, uint8_t *out);
+
+#endif  // !STATE_H_
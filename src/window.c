@@ -0,0 +1,110 @@
+#include "window.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "frame.h"
+#include "raylib.h"
+
+static struct display_options options;
+// Expanded display pixels, laid out for the high resolution. The low
+// resolution only fills in the top left corner.
+static Color pixels[HIRES_SCREEN_HEIGHT * HIRES_SCREEN_WIDTH];
+static Texture2D texture;  // The GPU copy of the expanded pixels.
+static uint64_t uploaded;   // The display version the texture holds.
+
+/**
+ * Converts a color of the display options into a Raylib color.
+ *
+ * @param rgb The color, as 0xRRGGBB.
+ * @return The opaque Raylib color.
+ */
+static Color to_color(uint32_t rgb)
+{
+    return (Color){rgb >> 16, rgb >> 8, rgb, 0xFF};
+}
+
+void init_display(struct display_options display_options)
+{
+    options = display_options;
+
+    Image image =
+        GenImageColor(HIRES_SCREEN_WIDTH, HIRES_SCREEN_HEIGHT, BLACK);
+    texture = LoadTextureFromImage(image);
+    UnloadImage(image);
+    SetTextureFilter(texture, TEXTURE_FILTER_POINT);
+
+    // No frame has this version, so the first one is always uploaded.
+    uploaded = UINT64_MAX;
+}
+
+void present_display(const struct frame *frame)
+{
+    // Only upload the pixels when the CPU changed them, otherwise the texture
+    // still holds the last frame and can be presented as is.
+    if (frame->version != uploaded) {
+        render(frame);
+        UpdateTexture(texture, pixels);
+        uploaded = frame->version;
+    }
+
+    // Scale the texture to the window, centering it within any leftover space.
+    float screen_width = frame->hires ? HIRES_SCREEN_WIDTH : SCREEN_WIDTH;
+    float screen_height = frame->hires ? HIRES_SCREEN_HEIGHT : SCREEN_HEIGHT;
+    float width = GetScreenWidth();
+    float height = GetScreenHeight();
+    float scale = width / screen_width < height / screen_height
+                      ? width / screen_width
+                      : height / screen_height;
+    if (options.scaling == SCALE_INTEGER && scale >= 1) {
+        scale = (int)scale;
+    }
+    Rectangle destination = {
+        (width - screen_width * scale) / 2,
+        (height - screen_height * scale) / 2,
+        screen_width * scale,
+        screen_height * scale,
+    };
+
+    BeginDrawing();
+    ClearBackground(to_color(options.background));
+    DrawTexturePro(
+        texture,
+        (Rectangle){0, 0, screen_width, screen_height},
+        destination,
+        (Vector2){0, 0},
+        0,
+        WHITE);
+    EndDrawing();
+}
+
+void unload_display()
+{
+    UnloadTexture(texture);
+}
+
+static void render(const struct frame *frame)
+{
+    // The planes a pixel is turned on in pick its color.
+    Color colors[1 << PLANE_COUNT] = {
+        to_color(options.background),
+        to_color(options.foreground),
+        to_color(options.second),
+        to_color(options.blend),
+    };
+
+    uint8_t width = frame->hires ? HIRES_SCREEN_WIDTH : SCREEN_WIDTH;
+    uint8_t height = frame->hires ? HIRES_SCREEN_HEIGHT : SCREEN_HEIGHT;
+    for (uint8_t y = 0; y < height; y++) {
+        Color *pixel = &pixels[y * HIRES_SCREEN_WIDTH];
+        for (uint8_t word = 0; word < width / 64; word++) {
+            uint64_t first = frame->display[0][y][word];
+            uint64_t second = frame->display[1][y][word];
+            for (uint8_t x = 0; x < 64; x++) {
+                *pixel++ = colors[(first >> 63) | (second >> 63) << 1];
+                first <<= 1;
+                second <<= 1;
+            }
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef WINDOW_H_
+#define WINDOW_H_
+
+#include <stdint.h>
+
+struct frame;
+
+#define DEFAULT_SCALE 10             // Initial scale of the window.
+#define DEFAULT_FOREGROUND 0xF5F5F5  // Color of active pixels, as 0xRRGGBB.
+#define DEFAULT_BACKGROUND 0x000000  // Color of inactive pixels, as 0xRRGGBB.
+#define DEFAULT_SECOND 0x9E9E9E      // Color of pixels in the second plane.
+#define DEFAULT_BLEND 0x5A5A5A       // Color of pixels in both planes.
+
+enum scaling_mode {
+    SCALE_INTEGER,  // Scale by the largest whole factor that fits the window.
+    SCALE_FIT,      // Scale to fill the window, keeping the aspect ratio.
+};
+
+struct display_options {
+    uint32_t foreground;        // Color of active pixels, as 0xRRGGBB.
+    uint32_t background;        // Color of inactive pixels, as 0xRRGGBB.
+    uint32_t second;            // Color of pixels only in the second plane.
+    uint32_t blend;             // Color of pixels in both planes.
+    enum scaling_mode scaling;  // How to scale the display to the window.
+};
+
+/**
+ * Prepares the Raylib resources used to present the display.
+ *
+ * Must be called after the Raylib window has been opened.
+ *
+ * @param options The colors and scaling with which to present the display.
+ */
+void init_display(struct display_options options);
+
+/**
+ * Presents an emulated frame onto the Raylib window.
+ *
+ * Should be called exactly once per host frame, with the newest frame the
+ * emulation published. The pixels are only uploaded if the CPU changed them
+ * since the last frame presented, after which the whole display is drawn as a
+ * single scaled texture.
+ *
+ * @param frame The frame to present.
+ */
+void present_display(const struct frame *frame);
+
+/**
+ * Releases the Raylib resources used to present the display.
+ *
+ * Must be called before the Raylib window is closed.
+ */
+void unload_display();
+
+/**
+ * An abstraction for CPU drawing functions onto Raylib.
+ *
+ * Expands the bit-packed display into a buffer of colored pixels, allowing the
+ * display functions to directly correspond to CPU instructions, without
+ * introducing additional complexity for dealing with Raylib.
+ *
+ * @param frame The frame whose display to expand.
+ */
+static void render(const struct frame *frame);
+
+#endif  // !WINDOW_H_
@@ -0,0 +1,151 @@
+#include <stdint.h>
+
+#include "audio.h"
+#include "chip8.h"
+#include "cpu.h"
+#include "scheduler.h"
+#include "unity.h"
+
+static struct chip8_vm vm;
+static struct audio_output output;
+static int16_t samples[AUDIO_RING_SIZE];
+
+void setUp()
+{
+    init_vm(&vm);
+    init_audio_output(&output);
+    set_audio_output(&vm, &output);
+}
+
+void tearDown()
+{
+    free_vm(&vm);
+}
+
+// MARK: Rendering
+
+void test_silent_tick_renders_silence()
+{
+    play_tick(&vm);
+
+    TEST_ASSERT_EQUAL_UINT32(TICK_SAMPLES, drain_audio(&output, samples, 1000));
+    for (uint32_t i = 0; i < TICK_SAMPLES; i++) {
+        TEST_ASSERT_EQUAL_INT16(0, samples[i]);
+    }
+}
+
+void test_default_pattern_is_square_wave()
+{
+    vm.sound_timer = 1;
+    play_tick(&vm);
+    drain_audio(&output, samples, TICK_SAMPLES);
+
+    // 4 bits on at 4000 bits per second last 1 ms, or 44.1 samples.
+    TEST_ASSERT_EQUAL_INT16(SAMPLE_VOLUME, samples[0]);
+    TEST_ASSERT_EQUAL_INT16(SAMPLE_VOLUME, samples[44]);
+    TEST_ASSERT_EQUAL_INT16(-SAMPLE_VOLUME, samples[45]);
+    TEST_ASSERT_EQUAL_INT16(-SAMPLE_VOLUME, samples[88]);
+    TEST_ASSERT_EQUAL_INT16(SAMPLE_VOLUME, samples[89]);
+}
+
+void test_pitch_doubles_rate_every_48_steps()
+{
+    vm.sound_timer = 1;
+    set_pitch(&vm, DEFAULT_PITCH + 48);
+    play_tick(&vm);
+    drain_audio(&output, samples, TICK_SAMPLES);
+    TEST_ASSERT_EQUAL_INT16(SAMPLE_VOLUME, samples[22]);
+    TEST_ASSERT_EQUAL_INT16(-SAMPLE_VOLUME, samples[23]);
+
+    init_audio_output(&output);
+    set_pitch(&vm, DEFAULT_PITCH - 48);
+    play_tick(&vm);
+    drain_audio(&output, samples, TICK_SAMPLES);
+    TEST_ASSERT_EQUAL_INT16(SAMPLE_VOLUME, samples[88]);
+    TEST_ASSERT_EQUAL_INT16(-SAMPLE_VOLUME, samples[89]);
+}
+
+void test_pattern_plays_bits_msb_first()
+{
+    uint8_t pattern[AUDIO_PATTERN_SIZE] = {0x7F};
+    set_audio_pattern(&vm, pattern);
+    vm.sound_timer = 1;
+    play_tick(&vm);
+    drain_audio(&output, samples, TICK_SAMPLES);
+
+    // A bit lasts 11.025 samples at the default pitch.
+    TEST_ASSERT_EQUAL_INT16(-SAMPLE_VOLUME, samples[11]);
+    TEST_ASSERT_EQUAL_INT16(SAMPLE_VOLUME, samples[12]);
+    TEST_ASSERT_EQUAL_INT16(-SAMPLE_VOLUME, samples[89]);
+}
+
+// MARK: Ring
+
+void test_drain_pads_with_silence()
+{
+    samples[0] = 1;
+    TEST_ASSERT_EQUAL_UINT32(0, drain_audio(&output, samples, 100));
+    TEST_ASSERT_EQUAL_INT16(0, samples[0]);
+}
+
+void test_full_output_drops_ticks()
+{
+    for (uint8_t i = 0; i < 8; i++) {
+        play_tick(&vm);
+    }
+
+    // Ticks are pushed until more than MAX_QUEUED_SAMPLES are waiting.
+    uint32_t queued = (MAX_QUEUED_SAMPLES / TICK_SAMPLES + 1) * TICK_SAMPLES;
+    uint32_t taken = drain_audio(&output, samples, AUDIO_RING_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(queued, taken);
+}
+
+void test_ring_wraps_around()
+{
+    vm.sound_timer = 1;
+    for (uint8_t i = 0; i < 20; i++) {
+        play_tick(&vm);
+        TEST_ASSERT_EQUAL_UINT32(
+            TICK_SAMPLES,
+            drain_audio(&output, samples, AUDIO_RING_SIZE));
+    }
+    TEST_ASSERT_EQUAL_INT16(SAMPLE_VOLUME, samples[0]);
+}
+
+// MARK: Scheduling
+
+void test_sound_timer_sounds_for_its_ticks()
+{
+    const uint8_t rom[] = {
+        0x60, 0x02,  // 0x200: V0 = 2
+        0xF0, 0x18,  // 0x202: Sound timer = V0
+        0x12, 0x04,  // 0x204: Jump to 0x204
+    };
+    startup_rom(&vm, rom, sizeof(rom));
+
+    struct cpu_status status;
+    for (uint8_t i = 0; i < 3; i++) {
+        run_frame(&vm, &status);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(
+        3 * TICK_SAMPLES,
+        drain_audio(&output, samples, AUDIO_RING_SIZE));
+    TEST_ASSERT_NOT_EQUAL(0, samples[0]);
+    TEST_ASSERT_NOT_EQUAL(0, samples[2 * TICK_SAMPLES - 1]);
+    TEST_ASSERT_EQUAL_INT16(0, samples[2 * TICK_SAMPLES]);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_silent_tick_renders_silence);
+    RUN_TEST(test_default_pattern_is_square_wave);
+    RUN_TEST(test_pitch_doubles_rate_every_48_steps);
+    RUN_TEST(test_pattern_plays_bits_msb_first);
+    RUN_TEST(test_drain_pads_with_silence);
+    RUN_TEST(test_full_output_drops_ticks);
+    RUN_TEST(test_ring_wraps_around);
+    RUN_TEST(test_sound_timer_sounds_for_its_ticks);
+    return UNITY_END();
+}
@@ -0,0 +1,43 @@
+# Runs a list of ROMs through chip8-batch on one and on several worker threads,
+# and fails unless both write the exact same results.
+#
+# Expects BATCH, the path of chip8-batch, and WORK_DIR, a scratch directory.
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+# One ROM saves V0 into the flag registers, and the other loads them back, so
+# the second one only ends up the same everywhere if no flags carry over from
+# the job that ran before it. Neither contains a zero byte, which CMake
+# strings can not hold.
+string(ASCII 96 42 240 117 18 4 SAVER)   # V0 = 42, save V0, spin
+string(ASCII 240 133 18 2 LOADER)        # Load V0, spin
+file(WRITE ${WORK_DIR}/saver.ch8 "${SAVER}")
+file(WRITE ${WORK_DIR}/loader.ch8 "${LOADER}")
+
+set(LIST "")
+foreach(i RANGE 7)
+    string(APPEND LIST "${WORK_DIR}/saver.ch8\n${WORK_DIR}/loader.ch8\n")
+endforeach()
+file(WRITE ${WORK_DIR}/roms.txt "${LIST}")
+
+foreach(threads 1 4)
+    execute_process(
+        COMMAND ${BATCH} --cycles 1000 --runs 2 --threads ${threads}
+            --list ${WORK_DIR}/roms.txt --output ${WORK_DIR}/${threads}.csv
+        RESULT_VARIABLE result
+        OUTPUT_QUIET
+    )
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "chip8-batch failed on ${threads} threads")
+    endif()
+endforeach()
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files
+        ${WORK_DIR}/1.csv ${WORK_DIR}/4.csv
+    RESULT_VARIABLE different
+)
+if (different)
+    message(FATAL_ERROR "The results depend on the amount of threads")
+endif()
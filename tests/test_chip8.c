@@ -0,0 +1,151 @@
+#include <stdint.h>
+
+#include "chip8.h"
+#include "cpu.h"
+#include "memory.h"
+#include "unity.h"
+
+static struct chip8_vm vm;
+
+// Counts V0 up forever, pushing and popping a subroutine along the way.
+static const uint8_t COUNTER[] = {
+    0x70, 0x01,  // 0x200: V0 += 1
+    0x22, 0x06,  // 0x202: Call 0x206
+    0x12, 0x00,  // 0x204: Jump to 0x200
+    0x00, 0xEE,  // 0x206: Return
+};
+
+// Writes over the font and the end of memory, and draws in high resolution.
+static const uint8_t SCRIBBLER[] = {
+    0xA0, 0x50,              // 0x200: I = 0x050
+    0x60, 0xFF,              // 0x202: V0 = 255
+    0xF0, 0x33,              // 0x204: Store the digits of V0 over the font
+    0xF0, 0x00, 0xFF, 0xF0,  // 0x206: I = 0xFFF0
+    0xF3, 0x55,              // 0x20A: Store V0 to V3
+    0x00, 0xFF,              // 0x20C: High resolution
+    0xA0, 0x00,              // 0x20E: I = 0x000
+    0xD0, 0x10,              // 0x210: Draw 16x16 at V0, V1
+    0x12, 0x12,              // 0x212: Jump to 0x212
+};
+
+void setUp()
+{
+    init_vm(&vm);
+}
+
+void tearDown()
+{
+    free_vm(&vm);
+}
+
+/**
+ * Runs the counter program from scratch, and hashes the state it leaves.
+ *
+ * @param core The core to run the program on.
+ * @param cycles The amount of CPU cycles to run.
+ * @return The hash of the machine state.
+ */
+static uint64_t hash_after(enum cpu_core core, uint64_t cycles)
+{
+    struct cpu_status status;
+    set_cpu_core(&vm, core);
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    run_cycles(&vm, cycles, &status);
+    return hash_vm(&vm);
+}
+
+// MARK: Hashing
+
+void test_hash_is_deterministic()
+{
+    TEST_ASSERT_EQUAL_HEX64(
+        hash_after(CORE_TABLE, 100),
+        hash_after(CORE_TABLE, 100));
+}
+
+void test_hash_changes_with_state()
+{
+    TEST_ASSERT_NOT_EQUAL(
+        hash_after(CORE_TABLE, 100),
+        hash_after(CORE_TABLE, 101));
+}
+
+void test_hash_ignores_popped_stack_entries()
+{
+    // Both points have an empty stack, but only the second one has a popped
+    // return address left behind.
+    uint64_t expected = hash_after(CORE_TABLE, 1);
+    hash_after(CORE_TABLE, 3);  // Through the call and return
+    vm.PC = 0x202;
+
+    TEST_ASSERT_EQUAL_HEX64(expected, hash_vm(&vm));
+}
+
+void test_hash_is_independent_of_core()
+{
+    uint64_t expected = hash_after(CORE_TABLE, 1000);
+    TEST_ASSERT_EQUAL_HEX64(expected, hash_after(CORE_THREADED, 1000));
+    TEST_ASSERT_EQUAL_HEX64(expected, hash_after(CORE_DYNAREC, 1000));
+}
+
+// MARK: Restarting
+
+void test_restart_matches_fresh_machine()
+{
+    uint64_t expected = hash_after(CORE_TABLE, 1000);
+
+    // Loading a program only restores what the last one changed, which has to
+    // include any instructions decoded or translated from it.
+    for (enum cpu_core core = CORE_TABLE; core <= CORE_DYNAREC; core++) {
+        struct cpu_status status;
+        set_cpu_core(&vm, core);
+        startup_rom(&vm, SCRIBBLER, sizeof(SCRIBBLER));
+        run_cycles(&vm, 100, &status);
+        TEST_ASSERT_EQUAL_HEX8(2, read_memory(&vm, FONT_START));
+        TEST_ASSERT_TRUE(vm.hires);
+
+        TEST_ASSERT_EQUAL_HEX64(expected, hash_after(core, 1000));
+    }
+}
+
+// MARK: Releasing
+
+void test_only_pages_run_from_are_decoded()
+{
+    hash_after(CORE_TABLE, 1000);
+    TEST_ASSERT_NOT_NULL(vm.decoded_pages[PROGRAM_START / MEMORY_PAGE_SIZE]);
+    for (uint8_t i = 1; i < MEMORY_PAGES; i++) {
+        TEST_ASSERT_NULL(vm.decoded_pages[i]);
+    }
+}
+
+void test_machine_runs_on_after_release()
+{
+    uint64_t expected = hash_after(CORE_TABLE, 1000);
+
+    // Released caches are allocated again as instructions execute.
+    for (enum cpu_core core = CORE_TABLE; core <= CORE_DYNAREC; core++) {
+        hash_after(core, 500);
+        free_vm(&vm);
+        for (uint8_t i = 0; i < MEMORY_PAGES; i++) {
+            TEST_ASSERT_NULL(vm.decoded_pages[i]);
+        }
+
+        struct cpu_status status;
+        run_cycles(&vm, 500, &status);
+        TEST_ASSERT_EQUAL_HEX64(expected, hash_vm(&vm));
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_hash_is_deterministic);
+    RUN_TEST(test_hash_changes_with_state);
+    RUN_TEST(test_hash_ignores_popped_stack_entries);
+    RUN_TEST(test_hash_is_independent_of_core);
+    RUN_TEST(test_restart_matches_fresh_machine);
+    RUN_TEST(test_only_pages_run_from_are_decoded);
+    RUN_TEST(test_machine_runs_on_after_release);
+    return UNITY_END();
+}
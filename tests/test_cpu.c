@@ -1,20 +1,27 @@
 #include <stdio.h>
 
+#include "audio.h"
+#include "chip8.h"
 #include "cpu.h"
 #include "display.h"
+#include "keypad.h"
+#include "macros.h"
 #include "memory.h"
 #include "unity.h"
 
 #define TEST_ROM "resources/roms/Test ROM.ch8"
 
+static struct chip8_vm vm;
+
 void setUp()
 {
-    startup(TEST_ROM);
+    init_vm(&vm);
+    startup(&vm, TEST_ROM);
 }
 
 void tearDown()
 {
-    return;
+    free_vm(&vm);
 }
 
 // MARK: Startup
@@ -28,7 +35,7 @@ void test_startup_loads_program()
     fread(program, 1, 0xFFF - 0x200, f);
     fclose(f);
 
-    uint8_t *memory = get_memory_pointer(PROGRAM_START);
+    uint8_t *memory = get_memory_pointer(&vm, PROGRAM_START);
     for (uint16_t offset = 0; offset < 16; offset++) {
         TEST_ASSERT_EQUAL_INT8(program[offset], memory[offset]);
     }
@@ -39,7 +46,7 @@ void test_startup_loads_program()
 // 0x0NNN
 void test_machine_language_routine_is_error()
 {
-    struct cpu_status status = debug_run_instruction(0x0000);
+    struct cpu_status status = debug_run_instruction(&vm, 0x0000);
     TEST_ASSERT_EQUAL_UINT8(INVALID_INSTRUCTION, status.code);
 }
 
@@ -48,17 +55,17 @@ void test_set_updates_variable_registers()
 {
     struct cpu_status status;
 
-    status = debug_run_instruction(0x6001);
+    status = debug_run_instruction(&vm, 0x6001);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT8(0x01, get_variable_registers()[0]);
+    TEST_ASSERT_EQUAL_INT8(0x01, get_variable_registers(&vm)[0]);
 
-    status = debug_run_instruction(0x6002);
+    status = debug_run_instruction(&vm, 0x6002);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT8(0x02, get_variable_registers()[0]);
+    TEST_ASSERT_EQUAL_INT8(0x02, get_variable_registers(&vm)[0]);
 
-    status = debug_run_instruction(0x6303);
+    status = debug_run_instruction(&vm, 0x6303);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT8(0x03, get_variable_registers()[3]);
+    TEST_ASSERT_EQUAL_INT8(0x03, get_variable_registers(&vm)[3]);
 }
 
 // 0x7XNN
@@ -66,17 +73,17 @@ void test_add_updates_variable_registers()
 {
     struct cpu_status status;
 
-    status = debug_run_instruction(0x7001);
+    status = debug_run_instruction(&vm, 0x7001);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT8(0x01, get_variable_registers()[0]);
+    TEST_ASSERT_EQUAL_INT8(0x01, get_variable_registers(&vm)[0]);
 
-    status = debug_run_instruction(0x7002);
+    status = debug_run_instruction(&vm, 0x7002);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT8(0x03, get_variable_registers()[0]);
+    TEST_ASSERT_EQUAL_INT8(0x03, get_variable_registers(&vm)[0]);
 
-    status = debug_run_instruction(0x7303);
+    status = debug_run_instruction(&vm, 0x7303);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT8(0x03, get_variable_registers()[3]);
+    TEST_ASSERT_EQUAL_INT8(0x03, get_variable_registers(&vm)[3]);
 }
 
 // 0x8XY0
@@ -84,11 +91,11 @@ void test_set_vx_to_vy()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x6101);
+    debug_run_instruction(&vm, 0x6101);
 
-    status = debug_run_instruction(0x8010);
+    status = debug_run_instruction(&vm, 0x8010);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_UINT8(0x01, get_variable_registers()[0x0]);
+    TEST_ASSERT_EQUAL_UINT8(0x01, get_variable_registers(&vm)[0x0]);
 }
 
 // 0x8XY4
@@ -96,26 +103,26 @@ void test_add_vy_to_vx()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x6001);
-    debug_run_instruction(0x6102);
+    debug_run_instruction(&vm, 0x6001);
+    debug_run_instruction(&vm, 0x6102);
 
-    status = debug_run_instruction(0x8014);
+    status = debug_run_instruction(&vm, 0x8014);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_UINT8(0x03, get_variable_registers()[0x0]);
-    TEST_ASSERT_FALSE(get_variable_registers()[0xF]);
+    TEST_ASSERT_EQUAL_UINT8(0x03, get_variable_registers(&vm)[0x0]);
+    TEST_ASSERT_FALSE(get_variable_registers(&vm)[0xF]);
 }
 
 void test_add_vy_to_vx_with_carry()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x60FF);
-    debug_run_instruction(0x6102);
+    debug_run_instruction(&vm, 0x60FF);
+    debug_run_instruction(&vm, 0x6102);
 
-    status = debug_run_instruction(0x8014);
+    status = debug_run_instruction(&vm, 0x8014);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_UINT8(0x01, get_variable_registers()[0x0]);
-    TEST_ASSERT_TRUE(get_variable_registers()[0xF]);
+    TEST_ASSERT_EQUAL_UINT8(0x01, get_variable_registers(&vm)[0x0]);
+    TEST_ASSERT_TRUE(get_variable_registers(&vm)[0xF]);
 }
 
 // 0x8XY5
@@ -123,26 +130,26 @@ void test_subtract_vy_from_vx()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x6002);
-    debug_run_instruction(0x6101);
+    debug_run_instruction(&vm, 0x6002);
+    debug_run_instruction(&vm, 0x6101);
 
-    status = debug_run_instruction(0x8015);
+    status = debug_run_instruction(&vm, 0x8015);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_UINT8(0xFF, get_variable_registers()[0x0]);
-    TEST_ASSERT_FALSE(get_variable_registers()[0xF]);
+    TEST_ASSERT_EQUAL_UINT8(0xFF, get_variable_registers(&vm)[0x0]);
+    TEST_ASSERT_FALSE(get_variable_registers(&vm)[0xF]);
 }
 
 void test_subtract_vy_from_vx_with_carry()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x6001);
-    debug_run_instruction(0x6102);
+    debug_run_instruction(&vm, 0x6001);
+    debug_run_instruction(&vm, 0x6102);
 
-    status = debug_run_instruction(0x8015);
+    status = debug_run_instruction(&vm, 0x8015);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_UINT8(0x01, get_variable_registers()[0x0]);
-    TEST_ASSERT_TRUE(get_variable_registers()[0xF]);
+    TEST_ASSERT_EQUAL_UINT8(0x01, get_variable_registers(&vm)[0x0]);
+    TEST_ASSERT_TRUE(get_variable_registers(&vm)[0xF]);
 }
 
 // 0x8XY7
@@ -150,26 +157,26 @@ void test_subtract_vx_from_vy()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x6001);
-    debug_run_instruction(0x6102);
+    debug_run_instruction(&vm, 0x6001);
+    debug_run_instruction(&vm, 0x6102);
 
-    status = debug_run_instruction(0x8017);
+    status = debug_run_instruction(&vm, 0x8017);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_UINT8(0xFF, get_variable_registers()[0x0]);
-    TEST_ASSERT_FALSE(get_variable_registers()[0xF]);
+    TEST_ASSERT_EQUAL_UINT8(0xFF, get_variable_registers(&vm)[0x0]);
+    TEST_ASSERT_FALSE(get_variable_registers(&vm)[0xF]);
 }
 
 void test_subtract_vx_from_vy_with_carry()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x6002);
-    debug_run_instruction(0x6101);
+    debug_run_instruction(&vm, 0x6002);
+    debug_run_instruction(&vm, 0x6101);
 
-    status = debug_run_instruction(0x8017);
+    status = debug_run_instruction(&vm, 0x8017);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_UINT8(0x01, get_variable_registers()[0x0]);
-    TEST_ASSERT_TRUE(get_variable_registers()[0xF]);
+    TEST_ASSERT_EQUAL_UINT8(0x01, get_variable_registers(&vm)[0x0]);
+    TEST_ASSERT_TRUE(get_variable_registers(&vm)[0xF]);
 }
 
 // 0x8XYE
@@ -177,24 +184,24 @@ void test_shift_left()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x6003);  // Set V0 to 0b00000011
+    debug_run_instruction(&vm, 0x6003);  // Set V0 to 0b00000011
 
-    status = debug_run_instruction(0x800E);
+    status = debug_run_instruction(&vm, 0x800E);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_UINT8(0b00000110, get_variable_registers()[0x0]);
-    TEST_ASSERT_FALSE(get_variable_registers()[0xF]);
+    TEST_ASSERT_EQUAL_UINT8(0b00000110, get_variable_registers(&vm)[0x0]);
+    TEST_ASSERT_FALSE(get_variable_registers(&vm)[0xF]);
 }
 
 void test_shift_left_with_carry()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x60C0);  // Set V0 to 0b11000000
+    debug_run_instruction(&vm, 0x60C0);  // Set V0 to 0b11000000
 
-    status = debug_run_instruction(0x800E);
+    status = debug_run_instruction(&vm, 0x800E);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_UINT8(0b10000000, get_variable_registers()[0x0]);
-    TEST_ASSERT_TRUE(get_variable_registers()[0xF]);
+    TEST_ASSERT_EQUAL_UINT8(0b10000000, get_variable_registers(&vm)[0x0]);
+    TEST_ASSERT_TRUE(get_variable_registers(&vm)[0xF]);
 }
 
 // 0x8XY6
@@ -202,24 +209,24 @@ void test_shift_right()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x60C0);  // Set V0 to 0b11000000
+    debug_run_instruction(&vm, 0x60C0);  // Set V0 to 0b11000000
 
-    status = debug_run_instruction(0x8006);
+    status = debug_run_instruction(&vm, 0x8006);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_UINT8(0b01100000, get_variable_registers()[0x0]);
-    TEST_ASSERT_FALSE(get_variable_registers()[0xF]);
+    TEST_ASSERT_EQUAL_UINT8(0b01100000, get_variable_registers(&vm)[0x0]);
+    TEST_ASSERT_FALSE(get_variable_registers(&vm)[0xF]);
 }
 
 void test_shift_right_with_carry()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x6003);  // Set V0 to 0b00000011
+    debug_run_instruction(&vm, 0x6003);  // Set V0 to 0b00000011
 
-    status = debug_run_instruction(0x8006);
+    status = debug_run_instruction(&vm, 0x8006);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_UINT8(0b00000001, get_variable_registers()[0x0]);
-    TEST_ASSERT_TRUE(get_variable_registers()[0xF]);
+    TEST_ASSERT_EQUAL_UINT8(0b00000001, get_variable_registers(&vm)[0x0]);
+    TEST_ASSERT_TRUE(get_variable_registers(&vm)[0xF]);
 }
 
 // 0x8XY2
@@ -227,12 +234,12 @@ void test_and()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x60AC);  // Set V0 to 0b10101100
-    debug_run_instruction(0x6156);  // Set V1 to 0b01010110
+    debug_run_instruction(&vm, 0x60AC);  // Set V0 to 0b10101100
+    debug_run_instruction(&vm, 0x6156);  // Set V1 to 0b01010110
 
-    status = debug_run_instruction(0x8012);
+    status = debug_run_instruction(&vm, 0x8012);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_UINT8(0b00000100, get_variable_registers()[0x0]);
+    TEST_ASSERT_EQUAL_UINT8(0b00000100, get_variable_registers(&vm)[0x0]);
 }
 
 // 0x8XY1
@@ -240,12 +247,12 @@ void test_or()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x60AC);  // Set V0 to 0b10101100
-    debug_run_instruction(0x6156);  // Set V1 to 0b01010110
+    debug_run_instruction(&vm, 0x60AC);  // Set V0 to 0b10101100
+    debug_run_instruction(&vm, 0x6156);  // Set V1 to 0b01010110
 
-    status = debug_run_instruction(0x8011);
+    status = debug_run_instruction(&vm, 0x8011);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_UINT8(0b11111110, get_variable_registers()[0x0]);
+    TEST_ASSERT_EQUAL_UINT8(0b11111110, get_variable_registers(&vm)[0x0]);
 }
 
 // 0x8XY3
@@ -253,12 +260,12 @@ void test_xor()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x60AC);  // Set V0 to 0b10101100
-    debug_run_instruction(0x6156);  // Set V1 to 0b01010110
+    debug_run_instruction(&vm, 0x60AC);  // Set V0 to 0b10101100
+    debug_run_instruction(&vm, 0x6156);  // Set V1 to 0b01010110
 
-    status = debug_run_instruction(0x8013);
+    status = debug_run_instruction(&vm, 0x8013);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_UINT8(0b11111010, get_variable_registers()[0x0]);
+    TEST_ASSERT_EQUAL_UINT8(0b11111010, get_variable_registers(&vm)[0x0]);
 }
 
 // 0x1NNN
@@ -266,13 +273,13 @@ void test_jump_updates_program_counter()
 {
     struct cpu_status status;
 
-    status = debug_run_instruction(0x1000);
+    status = debug_run_instruction(&vm, 0x1000);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0x000, get_program_counter());
+    TEST_ASSERT_EQUAL_INT16(0x000, get_program_counter(&vm));
 
-    status = debug_run_instruction(0x1FFF);
+    status = debug_run_instruction(&vm, 0x1FFF);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0xFFF, get_program_counter());
+    TEST_ASSERT_EQUAL_INT16(0xFFF, get_program_counter(&vm));
 }
 
 // 0xBNNN
@@ -280,30 +287,45 @@ void test_jump_with_offset_updates_program_counter()
 {
     struct cpu_status status;
 
-    status = debug_run_instruction(0xB100);
+    status = debug_run_instruction(&vm, 0xB100);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0x100, get_program_counter());
+    TEST_ASSERT_EQUAL_INT16(0x100, get_program_counter(&vm));
 
-    debug_run_instruction(0x600F);
-    status = debug_run_instruction(0xB100);
+    debug_run_instruction(&vm, 0x600F);
+    status = debug_run_instruction(&vm, 0xB100);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0x10F, get_program_counter());
+    TEST_ASSERT_EQUAL_INT16(0x10F, get_program_counter(&vm));
 }
 
 // 0x3XNN
+void test_stack_overflow_and_underflow_are_errors()
+{
+    struct cpu_status status = debug_run_instruction(&vm, 0x00EE);
+    TEST_ASSERT_EQUAL_UINT8(INVALID_STACK_OPERATION, status.code);
+
+    for (uint8_t i = 0; i < STACK_SIZE; i++) {
+        status = debug_run_instruction(&vm, 0x2300);
+        TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    }
+    status = debug_run_instruction(&vm, 0x2400);
+    TEST_ASSERT_EQUAL_UINT8(INVALID_STACK_OPERATION, status.code);
+    TEST_ASSERT_EQUAL_INT8(STACK_SIZE - 1, vm.stack.pointer);
+    TEST_ASSERT_NOT_EQUAL(0x400, get_program_counter(&vm));
+}
+
 void test_skip_if_variable_equal_constant()
 {
     struct cpu_status status;
 
     // False
-    status = debug_run_instruction(0x3001);
+    status = debug_run_instruction(&vm, 0x3001);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0x200, get_program_counter());
+    TEST_ASSERT_EQUAL_INT16(0x200, get_program_counter(&vm));
 
     // True
-    status = debug_run_instruction(0x3000);
+    status = debug_run_instruction(&vm, 0x3000);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0x202, get_program_counter());
+    TEST_ASSERT_EQUAL_INT16(0x202, get_program_counter(&vm));
 }
 
 // 0x4XNN
@@ -312,14 +334,14 @@ void test_skip_if_variable_not_equal_constant()
     struct cpu_status status;
 
     // False
-    status = debug_run_instruction(0x4000);
+    status = debug_run_instruction(&vm, 0x4000);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0x200, get_program_counter());
+    TEST_ASSERT_EQUAL_INT16(0x200, get_program_counter(&vm));
 
     // True
-    status = debug_run_instruction(0x4001);
+    status = debug_run_instruction(&vm, 0x4001);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0x202, get_program_counter());
+    TEST_ASSERT_EQUAL_INT16(0x202, get_program_counter(&vm));
 }
 
 // 0x5XY0
@@ -328,16 +350,16 @@ void test_skip_if_variable_equal_variable()
     struct cpu_status status;
 
     // False
-    debug_run_instruction(0x6101);           // Set V1 to 1.
-    status = debug_run_instruction(0x5010);  // Compare V0 (0) to V1 (1).
+    debug_run_instruction(&vm, 0x6101);           // Set V1 to 1.
+    status = debug_run_instruction(&vm, 0x5010);  // Compare V0 (0) to V1 (1).
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0x200, get_program_counter());
+    TEST_ASSERT_EQUAL_INT16(0x200, get_program_counter(&vm));
 
     // True
-    debug_run_instruction(0x6100);           // Set V1 to 0.
-    status = debug_run_instruction(0x5010);  // Compare V0 (0) to V1 (0).
+    debug_run_instruction(&vm, 0x6100);           // Set V1 to 0.
+    status = debug_run_instruction(&vm, 0x5010);  // Compare V0 (0) to V1 (0).
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0x202, get_program_counter());
+    TEST_ASSERT_EQUAL_INT16(0x202, get_program_counter(&vm));
 }
 
 // 0x9XY0
@@ -346,15 +368,15 @@ void test_skip_if_variable_not_equal_variable()
     struct cpu_status status;
 
     // False
-    status = debug_run_instruction(0x9010);  // Compare V0 (0) to V1 (0).
+    status = debug_run_instruction(&vm, 0x9010);  // Compare V0 (0) to V1 (0).
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0x200, get_program_counter());
+    TEST_ASSERT_EQUAL_INT16(0x200, get_program_counter(&vm));
 
     // True
-    debug_run_instruction(0x6101);           // Set V1 to 1.
-    status = debug_run_instruction(0x9010);  // Compare V0 (0) to V1 (1).
+    debug_run_instruction(&vm, 0x6101);           // Set V1 to 1.
+    status = debug_run_instruction(&vm, 0x9010);  // Compare V0 (0) to V1 (1).
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0x202, get_program_counter());
+    TEST_ASSERT_EQUAL_INT16(0x202, get_program_counter(&vm));
 }
 
 // 0xANNN
@@ -362,9 +384,42 @@ void test_set_index_updates_index_register()
 {
     struct cpu_status status;
 
-    status = debug_run_instruction(0xA300);
+    status = debug_run_instruction(&vm, 0xA300);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0x300, get_index_register());
+    TEST_ASSERT_EQUAL_INT16(0x300, get_index_register(&vm));
+}
+
+// 0xFX07
+void test_read_delay_timer()
+{
+    struct cpu_status status;
+
+    vm.delay_timer = 0x2A;
+    status = debug_run_instruction(&vm, 0xF307);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_UINT8(0x2A, get_variable_registers(&vm)[3]);
+}
+
+// 0xFX15
+void test_set_delay_timer()
+{
+    struct cpu_status status;
+
+    debug_run_instruction(&vm, 0x6330);
+    status = debug_run_instruction(&vm, 0xF315);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_UINT8(0x30, vm.delay_timer);
+}
+
+// 0xFX18
+void test_set_sound_timer()
+{
+    struct cpu_status status;
+
+    debug_run_instruction(&vm, 0x6330);
+    status = debug_run_instruction(&vm, 0xF318);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_UINT8(0x30, vm.sound_timer);
 }
 
 // 0xFX1E
@@ -372,26 +427,26 @@ void test_add_index_updates_index_register()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x6002);
-    debug_run_instruction(0xA300);
+    debug_run_instruction(&vm, 0x6002);
+    debug_run_instruction(&vm, 0xA300);
 
-    status = debug_run_instruction(0xF01E);
+    status = debug_run_instruction(&vm, 0xF01E);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0x302, get_index_register());
-    TEST_ASSERT_FALSE(get_variable_registers()[0xF]);
+    TEST_ASSERT_EQUAL_INT16(0x302, get_index_register(&vm));
+    TEST_ASSERT_FALSE(get_variable_registers(&vm)[0xF]);
 }
 
-void test_add_index_updates_index_register_with_carry()
+void test_add_index_updates_index_register_past_12_bits()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x6002);
-    debug_run_instruction(0xAFFF);
+    debug_run_instruction(&vm, 0x6002);
+    debug_run_instruction(&vm, 0xAFFF);
 
-    status = debug_run_instruction(0xF01E);
+    status = debug_run_instruction(&vm, 0xF01E);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(0x001, get_index_register());
-    TEST_ASSERT_TRUE(get_variable_registers()[0xF]);
+    TEST_ASSERT_EQUAL_HEX16(0x1001, get_index_register(&vm));
+    TEST_ASSERT_FALSE(get_variable_registers(&vm)[0xF]);
 }
 
 // 0xFX29
@@ -399,15 +454,15 @@ void test_font_character()
 {
     struct cpu_status status;
 
-    debug_run_instruction(0x6001);
-    status = debug_run_instruction(0xF029);
+    debug_run_instruction(&vm, 0x6001);
+    status = debug_run_instruction(&vm, 0xF029);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(FONT_START + 5, get_index_register());
+    TEST_ASSERT_EQUAL_INT16(FONT_START + 5, get_index_register(&vm));
 
-    debug_run_instruction(0x6004);
-    status = debug_run_instruction(0xF029);
+    debug_run_instruction(&vm, 0x6004);
+    status = debug_run_instruction(&vm, 0xF029);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    TEST_ASSERT_EQUAL_INT16(FONT_START + 20, get_index_register());
+    TEST_ASSERT_EQUAL_INT16(FONT_START + 20, get_index_register(&vm));
 }
 
 // 0xDXYN
@@ -416,19 +471,19 @@ void test_draw_renders_sprite()
     struct cpu_status status;
 
     // Move the index register and insert the sprite there.
-    status = debug_run_instruction(0xA300);
+    status = debug_run_instruction(&vm, 0xA300);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
     uint8_t sprite[6] = {0x6C, 0xFE, 0xFE, 0x7C, 0x38, 0x10};
     for (uint8_t i = 0; i < 6; i++) {
-        write_memory(get_index_register() + i, sprite[i]);
+        write_memory(&vm, get_index_register(&vm) + i, sprite[i]);
     }
 
     // Move the variable registers and draw the sprite at them.
-    status = debug_run_instruction(0x601D);
+    status = debug_run_instruction(&vm, 0x601D);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    status = debug_run_instruction(0x610D);
+    status = debug_run_instruction(&vm, 0x610D);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    status = debug_run_instruction(0xD016);
+    status = debug_run_instruction(&vm, 0xD016);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
 
     // Validate that the sprite was drawn.
@@ -440,10 +495,9 @@ void test_draw_renders_sprite()
         {0, 0, 1, 1, 1, 0, 0, 0},
         {0, 0, 0, 1, 0, 0, 0, 0},
     };
-    bool(*display)[SCREEN_WIDTH] = get_display();
     for (uint8_t y = 13; y < 6; y++) {
         for (uint8_t x = 29; x < 8; x++) {
-            TEST_ASSERT_EQUAL(expected[y][x], display[y][x]);
+            TEST_ASSERT_EQUAL(expected[y][x], get_pixel(&vm, x, y));
         }
     }
 }
@@ -454,24 +508,23 @@ void test_clear_display_clears_display()
     struct cpu_status status;
 
     // Draw the sprite the same as the last test.
-    status = debug_run_instruction(0xA300);
+    status = debug_run_instruction(&vm, 0xA300);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
     uint8_t sprite[6] = {0x6C, 0xFE, 0xFE, 0x7C, 0x38, 0x10};
     for (uint8_t i = 0; i < 6; i++) {
-        write_memory(get_index_register() + i, sprite[i]);
+        write_memory(&vm, get_index_register(&vm) + i, sprite[i]);
     }
-    status = debug_run_instruction(0x601D);
+    status = debug_run_instruction(&vm, 0x601D);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    status = debug_run_instruction(0x610D);
+    status = debug_run_instruction(&vm, 0x610D);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
-    status = debug_run_instruction(0xD016);
+    status = debug_run_instruction(&vm, 0xD016);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
 
     // Clear the display and validate that it was cleared.
-    bool(*display)[SCREEN_WIDTH] = get_display();
     for (uint8_t y = 13; y < 6; y++) {
         for (uint8_t x = 29; x < 8; x++) {
-            TEST_ASSERT_FALSE(display[y][x]);
+            TEST_ASSERT_FALSE(get_pixel(&vm, x, y));
         }
     }
 }
@@ -480,24 +533,24 @@ void test_clear_display_clears_display()
 void test_decimal_conversion()
 {
     struct cpu_status status;
-    uint8_t *memory = get_memory_pointer(get_index_register());
+    uint8_t *memory = get_memory_pointer(&vm, get_index_register(&vm));
 
-    debug_run_instruction(0x6001);  // Set V0 to 1.
+    debug_run_instruction(&vm, 0x6001);  // Set V0 to 1.
 
-    status = debug_run_instruction(0xF033);
+    status = debug_run_instruction(&vm, 0xF033);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
     TEST_ASSERT_EQUAL_UINT8(1, memory[0]);
 
-    debug_run_instruction(0x600F);  // Set V0 to 15.
+    debug_run_instruction(&vm, 0x600F);  // Set V0 to 15.
 
-    status = debug_run_instruction(0xF033);
+    status = debug_run_instruction(&vm, 0xF033);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
     TEST_ASSERT_EQUAL_UINT8(1, memory[0]);
     TEST_ASSERT_EQUAL_UINT8(5, memory[1]);
 
-    debug_run_instruction(0x609C);  // Set V0 to 156.
+    debug_run_instruction(&vm, 0x609C);  // Set V0 to 156.
 
-    status = debug_run_instruction(0xF033);
+    status = debug_run_instruction(&vm, 0xF033);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
     TEST_ASSERT_EQUAL_UINT8(1, memory[0]);
     TEST_ASSERT_EQUAL_UINT8(5, memory[1]);
@@ -508,16 +561,16 @@ void test_decimal_conversion()
 void test_store_memory()
 {
     struct cpu_status status;
-    uint8_t *memory = get_memory_pointer(get_index_register());
+    uint8_t *memory = get_memory_pointer(&vm, get_index_register(&vm));
 
     // Add data to variable registers.
-    debug_run_instruction(0x6001);
-    debug_run_instruction(0x6102);
-    debug_run_instruction(0x6203);
-    debug_run_instruction(0x6304);
+    debug_run_instruction(&vm, 0x6001);
+    debug_run_instruction(&vm, 0x6102);
+    debug_run_instruction(&vm, 0x6203);
+    debug_run_instruction(&vm, 0x6304);
 
     // Intentionally exclude last register to test upper bound of storage.
-    status = debug_run_instruction(0xF255);
+    status = debug_run_instruction(&vm, 0xF255);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
     TEST_ASSERT_EQUAL_UINT8(1, memory[0]);
     TEST_ASSERT_EQUAL_UINT8(2, memory[1]);
@@ -530,8 +583,8 @@ void test_store_memory()
 void test_load_memory()
 {
     struct cpu_status status;
-    uint8_t *memory = get_memory_pointer(get_index_register());
-    uint8_t *variables = get_variable_registers();
+    uint8_t *memory = get_memory_pointer(&vm, get_index_register(&vm));
+    uint8_t *variables = get_variable_registers(&vm);
 
     // Add data to memory.
     for (uint8_t i = 0; i < 4; i++) {
@@ -539,7 +592,7 @@ void test_load_memory()
     }
 
     // Intentionally exclude last register to test upper bound of loading.
-    status = debug_run_instruction(0xF265);
+    status = debug_run_instruction(&vm, 0xF265);
     TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
     TEST_ASSERT_EQUAL_UINT8(1, variables[0]);
     TEST_ASSERT_EQUAL_UINT8(2, variables[1]);
@@ -548,18 +601,492 @@ void test_load_memory()
     TEST_ASSERT_EQUAL_UINT8(0, variables[3]);
 }
 
+// 0xDXYN, 0xFX33, 0xFX55 and 0xFX65
+void test_memory_access_past_end_is_rejected()
+{
+    struct cpu_status status;
+
+    // Point the index register at the last two bytes of memory.
+    write_memory(&vm, get_program_counter(&vm), 0xFF);
+    write_memory(&vm, get_program_counter(&vm) + 1, 0xFE);
+    debug_run_instruction(&vm, 0xF000);
+    TEST_ASSERT_EQUAL_HEX16(0xFFFE, get_index_register(&vm));
+
+    // Whatever fits within memory is still accessed.
+    debug_run_instruction(&vm, 0x6063);  // Set V0 to 99.
+    debug_run_instruction(&vm, 0x6107);  // Set V1 to 7.
+    status = debug_run_instruction(&vm, 0xF155);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    status = debug_run_instruction(&vm, 0xD012);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    status = debug_run_instruction(&vm, 0xF033);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_UINT8(9, read_memory(&vm, 0xFFFF));
+
+    // Anything past the end is rejected without touching memory.
+    debug_run_instruction(&vm, 0x609C);  // Set V0 to 156.
+    const uint16_t rejected[] = {0xD013, 0xF033, 0xF255, 0xF265};
+    for (uint8_t i = 0; i < len(rejected); i++) {
+        status = debug_run_instruction(&vm, rejected[i]);
+        TEST_ASSERT_EQUAL_UINT8(INVALID_MEMORY_ACCESS, status.code);
+    }
+    TEST_ASSERT_EQUAL_UINT8(9, read_memory(&vm, 0xFFFE));
+    TEST_ASSERT_EQUAL_UINT8(9, read_memory(&vm, 0xFFFF));
+    TEST_ASSERT_EQUAL_HEX16(0xFFFE, get_index_register(&vm));
+
+    // Every selected plane draws a sprite of its own.
+    debug_run_instruction(&vm, 0xF301);
+    status = debug_run_instruction(&vm, 0xD012);
+    TEST_ASSERT_EQUAL_UINT8(INVALID_MEMORY_ACCESS, status.code);
+}
+
+// MARK: SUPER-CHIP
+
+// 0x00FE and 0x00FF
+void test_switch_resolution()
+{
+    struct cpu_status status;
+
+    status = debug_run_instruction(&vm, 0x00FF);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_UINT8(HIRES_SCREEN_WIDTH, get_screen_width(&vm));
+
+    status = debug_run_instruction(&vm, 0x00FE);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_UINT8(SCREEN_WIDTH, get_screen_width(&vm));
+}
+
+// 0x00CN, 0x00FB and 0x00FC
+void test_scroll_moves_pixels()
+{
+    struct cpu_status status;
+
+    // Draw a single pixel in the top left corner.
+    debug_run_instruction(&vm, 0x00FF);
+    debug_run_instruction(&vm, 0xA300);
+    write_memory(&vm, 0x300, 0x80);
+    debug_run_instruction(&vm, 0x6000);
+    debug_run_instruction(&vm, 0xD001);
+
+    status = debug_run_instruction(&vm, 0x00C2);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_FALSE(get_pixel(&vm, 0, 0));
+    TEST_ASSERT_TRUE(get_pixel(&vm, 0, 2));
+
+    status = debug_run_instruction(&vm, 0x00FB);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_TRUE(get_pixel(&vm, 4, 2));
+
+    status = debug_run_instruction(&vm, 0x00FC);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_TRUE(get_pixel(&vm, 0, 2));
+    TEST_ASSERT_FALSE(get_pixel(&vm, 4, 2));
+}
+
+// 0xDXY0
+void test_draw_renders_large_sprite()
+{
+    struct cpu_status status;
+
+    debug_run_instruction(&vm, 0x00FF);
+    debug_run_instruction(&vm, 0xA300);
+    for (uint8_t i = 0; i < 32; i++) {
+        write_memory(&vm, 0x300 + i, 0xFF);
+    }
+    debug_run_instruction(&vm, 0x6078);
+    debug_run_instruction(&vm, 0x6100);
+
+    status = debug_run_instruction(&vm, 0xD010);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_UINT8(0, get_variable_registers(&vm)[0xF]);
+    TEST_ASSERT_TRUE(get_pixel(&vm, 0x78, 0));
+    TEST_ASSERT_TRUE(get_pixel(&vm, 0x7F, 15));
+    TEST_ASSERT_FALSE(get_pixel(&vm, 0x78, 16));
+}
+
+// 0xFX30
+void test_large_font_character()
+{
+    struct cpu_status status;
+
+    debug_run_instruction(&vm, 0x6001);
+    status = debug_run_instruction(&vm, 0xF030);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_INT16(LARGE_FONT_START + 10, get_index_register(&vm));
+
+    debug_run_instruction(&vm, 0x600F);
+    status = debug_run_instruction(&vm, 0xF030);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_INT16(LARGE_FONT_START + 150, get_index_register(&vm));
+}
+
+// 0xFX75 and 0xFX85
+void test_flag_registers_persist_across_programs()
+{
+    struct cpu_status status;
+    uint8_t *variables = get_variable_registers(&vm);
+
+    debug_run_instruction(&vm, 0x6011);
+    debug_run_instruction(&vm, 0x6122);
+    debug_run_instruction(&vm, 0x6233);
+    status = debug_run_instruction(&vm, 0xF175);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+
+    // Intentionally exclude the last register to test the upper bound.
+    startup(&vm, TEST_ROM);
+    status = debug_run_instruction(&vm, 0xF285);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_HEX8(0x11, variables[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x22, variables[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, variables[2]);
+}
+
+// MARK: XO-CHIP
+
+// 0xF000 NNNN
+void test_load_long_index()
+{
+    const uint8_t rom[] = {
+        0xF0, 0x00, 0xFF, 0xFE,  // 0x200: I = 0xFFFE
+        0x60, 0x03,              // 0x204: V0 = 3
+        0xF0, 0x1E,              // 0x206: I += V0
+    };
+    struct cpu_status status;
+
+    startup_rom(&vm, rom, sizeof(rom));
+    run_cycles(&vm, 1, &status);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_HEX16(0xFFFE, get_index_register(&vm));
+    TEST_ASSERT_EQUAL_HEX16(0x204, get_program_counter(&vm));
+
+    // The index register wraps around the end of memory.
+    run_cycles(&vm, 2, &status);
+    TEST_ASSERT_EQUAL_HEX16(0x0001, get_index_register(&vm));
+}
+
+// 0x3XNN, 0x4XNN, 0x5XY0 and 0x9XY0
+void test_skip_skips_long_instruction()
+{
+    const uint8_t rom[] = {
+        0x30, 0x00,              // 0x200: Skip if V0 == 0
+        0xF0, 0x00, 0x12, 0x34,  // 0x202: I = 0x1234
+        0x90, 0x00,              // 0x206: Skip if V0 != V0
+        0xF0, 0x00, 0x56, 0x78,  // 0x208: I = 0x5678
+    };
+    struct cpu_status status;
+
+    startup_rom(&vm, rom, sizeof(rom));
+    run_cycles(&vm, 1, &status);
+    TEST_ASSERT_EQUAL_HEX16(0x206, get_program_counter(&vm));
+
+    run_cycles(&vm, 2, &status);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_HEX16(0x5678, get_index_register(&vm));
+    TEST_ASSERT_EQUAL_HEX16(0x20C, get_program_counter(&vm));
+}
+
+// 0x5XY2
+void test_store_register_range()
+{
+    struct cpu_status status;
+    uint8_t *memory = get_memory_pointer(&vm, 0x300);
+
+    debug_run_instruction(&vm, 0xA300);
+    debug_run_instruction(&vm, 0x6111);
+    debug_run_instruction(&vm, 0x6222);
+    debug_run_instruction(&vm, 0x6333);
+
+    status = debug_run_instruction(&vm, 0x5132);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_HEX8(0x11, memory[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x22, memory[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x33, memory[2]);
+    TEST_ASSERT_EQUAL_HEX16(0x300, get_index_register(&vm));
+
+    // Backwards ranges are stored in reverse.
+    status = debug_run_instruction(&vm, 0x5312);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_HEX8(0x33, memory[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x22, memory[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x11, memory[2]);
+}
+
+// 0x5XY3
+void test_load_register_range()
+{
+    struct cpu_status status;
+    uint8_t *variables = get_variable_registers(&vm);
+
+    debug_run_instruction(&vm, 0xA300);
+    write_memory(&vm, 0x300, 0x11);
+    write_memory(&vm, 0x301, 0x22);
+
+    status = debug_run_instruction(&vm, 0x5AB3);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_HEX8(0x11, variables[0xA]);
+    TEST_ASSERT_EQUAL_HEX8(0x22, variables[0xB]);
+
+    status = debug_run_instruction(&vm, 0x5BA3);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_HEX8(0x22, variables[0xA]);
+    TEST_ASSERT_EQUAL_HEX8(0x11, variables[0xB]);
+
+    // A range past the end of memory is rejected, with I on the last byte.
+    write_memory(&vm, get_program_counter(&vm), 0xFF);
+    write_memory(&vm, get_program_counter(&vm) + 1, 0xFF);
+    debug_run_instruction(&vm, 0xF000);
+    status = debug_run_instruction(&vm, 0x5013);
+    TEST_ASSERT_EQUAL_UINT8(INVALID_MEMORY_ACCESS, status.code);
+}
+
+// 0xFN01
+void test_select_planes_draws_to_both_planes()
+{
+    struct cpu_status status;
+
+    // One sprite row for every plane.
+    debug_run_instruction(&vm, 0xA300);
+    write_memory(&vm, 0x300, 0xF0);
+    write_memory(&vm, 0x301, 0x3C);
+    debug_run_instruction(&vm, 0x6000);
+
+    status = debug_run_instruction(&vm, 0xF301);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    status = debug_run_instruction(&vm, 0xD001);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_UINT8(0x1, get_pixel_planes(&vm, 0, 0));
+    TEST_ASSERT_EQUAL_UINT8(0x3, get_pixel_planes(&vm, 2, 0));
+    TEST_ASSERT_EQUAL_UINT8(0x2, get_pixel_planes(&vm, 4, 0));
+    TEST_ASSERT_EQUAL_UINT8(0x0, get_pixel_planes(&vm, 6, 0));
+
+    // Clearing only affects the selected planes.
+    debug_run_instruction(&vm, 0xF201);
+    debug_run_instruction(&vm, 0x00E0);
+    TEST_ASSERT_EQUAL_UINT8(0x1, get_pixel_planes(&vm, 2, 0));
+    TEST_ASSERT_EQUAL_UINT8(0x0, get_pixel_planes(&vm, 4, 0));
+}
+
+// 0xF002 and 0xFX3A
+void test_audio_pattern_and_pitch()
+{
+    struct cpu_status status;
+
+    debug_run_instruction(&vm, 0xA300);
+    for (uint8_t i = 0; i < AUDIO_PATTERN_SIZE; i++) {
+        write_memory(&vm, 0x300 + i, i);
+    }
+    status = debug_run_instruction(&vm, 0xF002);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    for (uint8_t i = 0; i < AUDIO_PATTERN_SIZE; i++) {
+        TEST_ASSERT_EQUAL_HEX8(i, vm.audio.pattern[i]);
+    }
+
+    debug_run_instruction(&vm, 0x6570);
+    status = debug_run_instruction(&vm, 0xF53A);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_UINT8(0x70, vm.audio.pitch);
+
+    // Loading another program restores the default sound.
+    startup(&vm, TEST_ROM);
+    TEST_ASSERT_EQUAL_HEX8(0xF0, vm.audio.pattern[0]);
+    TEST_ASSERT_EQUAL_UINT8(DEFAULT_PITCH, vm.audio.pitch);
+}
+
+// MARK: Keypad
+
+// 0xEX9E
+void test_skip_if_key_down()
+{
+    struct cpu_status status;
+    debug_run_instruction(&vm, 0x6A0B);  // Set VA to 0xB.
+
+    // False
+    status = debug_run_instruction(&vm, 0xEA9E);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_INT16(0x200, get_program_counter(&vm));
+
+    // True
+    set_keys(&vm, 1 << 0xB);
+    status = debug_run_instruction(&vm, 0xEA9E);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_INT16(0x202, get_program_counter(&vm));
+}
+
+// 0xEXA1
+void test_skip_if_key_up()
+{
+    struct cpu_status status;
+    debug_run_instruction(&vm, 0x6A0B);  // Set VA to 0xB.
+
+    // False
+    set_keys(&vm, 1 << 0xB);
+    status = debug_run_instruction(&vm, 0xEAA1);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_INT16(0x200, get_program_counter(&vm));
+
+    // True
+    set_keys(&vm, 1 << 0xA);
+    status = debug_run_instruction(&vm, 0xEAA1);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_INT16(0x202, get_program_counter(&vm));
+}
+
+// 0xFX0A
+void test_wait_for_key_blocks_until_release()
+{
+    uint8_t rom[] = {
+        0xF3, 0x0A,  // 0x200: V3 = key
+        0x12, 0x02,  // 0x202: Jump to 0x202
+    };
+    startup_rom(&vm, rom, sizeof(rom));
+    struct cpu_status status;
+
+    // Nothing runs past the wait, and pressing a key does not end it yet.
+    set_keys(&vm, 1 << 0x7);
+    TEST_ASSERT_EQUAL_UINT64(1, run_cycles(&vm, 10, &status));
+    TEST_ASSERT_EQUAL_UINT8(WAITING_FOR_KEY, status.code);
+    TEST_ASSERT_EQUAL_HEX16(0x200, get_program_counter(&vm));
+
+    set_keys(&vm, 0);
+    TEST_ASSERT_EQUAL_UINT64(10, run_cycles(&vm, 10, &status));
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_HEX8(0x7, get_variable_registers(&vm)[3]);
+    TEST_ASSERT_EQUAL_HEX16(0x202, get_program_counter(&vm));
+}
+
 // MARK: CPU cycling
 
 void test_read_instruction_reads_and_moves_pc()
 {
-    TEST_ASSERT_EQUAL_INT16(0x601D, debug_read_instruction());
-    TEST_ASSERT_EQUAL_INT16(0x200 + 2, get_program_counter());
+    TEST_ASSERT_EQUAL_INT16(0x601D, debug_read_instruction(&vm));
+    TEST_ASSERT_EQUAL_INT16(0x200 + 2, get_program_counter(&vm));
 }
 
 void test_run_cycle_reads_and_executes_instruction()
 {
-    run_cycle();
-    TEST_ASSERT_EQUAL_INT8(0x1D, get_variable_registers()[0]);
+    run_cycle(&vm);
+    TEST_ASSERT_EQUAL_INT8(0x1D, get_variable_registers(&vm)[0]);
+}
+
+void test_run_cycle_executes_rewritten_instruction()
+{
+    run_cycle(&vm);
+    TEST_ASSERT_EQUAL_INT8(0x1D, get_variable_registers(&vm)[0]);
+
+    // Overwrite the decoded instruction with one setting V0 to 0x2A.
+    write_memory(&vm, PROGRAM_START, 0x60);
+    write_memory(&vm, PROGRAM_START + 1, 0x2A);
+    debug_run_instruction(&vm, 0x1000 | PROGRAM_START);
+
+    run_cycle(&vm);
+    TEST_ASSERT_EQUAL_INT8(0x2A, get_variable_registers(&vm)[0]);
+}
+
+void test_run_cycle_executes_self_modified_instruction()
+{
+    run_cycle(&vm);
+
+    // Let the program store an instruction setting V2 to 0x33 over itself.
+    debug_run_instruction(&vm, 0x6062);
+    debug_run_instruction(&vm, 0x6133);
+    debug_run_instruction(&vm, 0xA000 | PROGRAM_START);
+    debug_run_instruction(&vm, 0xF155);
+    debug_run_instruction(&vm, 0x1000 | PROGRAM_START);
+
+    run_cycle(&vm);
+    TEST_ASSERT_EQUAL_INT8(0x33, get_variable_registers(&vm)[2]);
+}
+
+// MARK: Idle loops
+
+void test_jump_to_self_is_idle()
+{
+    uint8_t rom[] = {0x60, 0x01, 0x12, 0x02};  // V0 = 1, jump to 0x202
+    startup_rom(&vm, rom, sizeof(rom));
+
+    TEST_ASSERT_EQUAL_UINT64(0, skip_idle_loop(&vm, 10));
+    run_cycle(&vm);
+    TEST_ASSERT_EQUAL_UINT64(10, skip_idle_loop(&vm, 10));
+    TEST_ASSERT_EQUAL_HEX16(0x202, get_program_counter(&vm));
+}
+
+void test_timer_poll_is_idle_until_timer_runs_out()
+{
+    uint8_t rom[] = {
+        0xF3, 0x07,  // 0x200: V3 = delay timer
+        0x33, 0x00,  // 0x202: Skip if V3 == 0
+        0x12, 0x00,  // 0x204: Jump to 0x200
+    };
+    startup_rom(&vm, rom, sizeof(rom));
+    vm.delay_timer = 5;
+
+    // Only whole iterations are skipped, and they poll the timer.
+    TEST_ASSERT_EQUAL_UINT64(9, skip_idle_loop(&vm, 10));
+    TEST_ASSERT_EQUAL_HEX16(0x200, get_program_counter(&vm));
+    TEST_ASSERT_EQUAL_UINT8(5, get_variable_registers(&vm)[3]);
+
+    // The jump back can be skipped from as well.
+    run_cycle(&vm);
+    run_cycle(&vm);
+    TEST_ASSERT_EQUAL_UINT64(3, skip_idle_loop(&vm, 5));
+    TEST_ASSERT_EQUAL_HEX16(0x204, get_program_counter(&vm));
+
+    vm.delay_timer = 0;
+    TEST_ASSERT_EQUAL_UINT64(0, skip_idle_loop(&vm, 10));
+}
+
+void test_timer_poll_with_stale_register_is_not_idle()
+{
+    uint8_t rom[] = {
+        0xF3, 0x07,  // 0x200: V3 = delay timer
+        0x43, 0x02,  // 0x202: Skip if V3 != 2
+        0x12, 0x00,  // 0x204: Jump to 0x200
+    };
+    startup_rom(&vm, rom, sizeof(rom));
+    vm.delay_timer = 2;
+    run_cycle(&vm);
+
+    // The timer ticked after it was polled, so the skip leaves the loop.
+    vm.delay_timer = 1;
+    TEST_ASSERT_EQUAL_UINT64(0, skip_idle_loop(&vm, 10));
+}
+
+void test_wait_for_key_is_idle_until_release()
+{
+    uint8_t rom[] = {0xF3, 0x0A};  // V3 = key
+    startup_rom(&vm, rom, sizeof(rom));
+    set_keys(&vm, 1 << 0x2);
+
+    TEST_ASSERT_EQUAL_UINT64(10, skip_idle_loop(&vm, 10));
+    TEST_ASSERT_EQUAL_HEX16(0x200, get_program_counter(&vm));
+
+    set_keys(&vm, 0);
+    TEST_ASSERT_EQUAL_UINT64(0, skip_idle_loop(&vm, 10));
+}
+
+// MARK: Machines
+
+void test_machines_run_independently()
+{
+    static struct chip8_vm other;
+    init_vm(&other);
+    uint8_t rom[] = {0x60, 0x2A, 0xA3, 0x00};  // V0 = 0x2A, I = 0x300
+    startup_rom(&other, rom, sizeof(rom));
+
+    run_cycle(&vm);
+    run_cycle(&other);
+    run_cycle(&other);
+
+    TEST_ASSERT_EQUAL_INT8(0x1D, get_variable_registers(&vm)[0]);
+    TEST_ASSERT_EQUAL_HEX16(0x202, get_program_counter(&vm));
+    TEST_ASSERT_EQUAL_HEX16(0x000, get_index_register(&vm));
+    TEST_ASSERT_EQUAL_INT8(0x2A, get_variable_registers(&other)[0]);
+    TEST_ASSERT_EQUAL_HEX16(0x204, get_program_counter(&other));
+    TEST_ASSERT_EQUAL_HEX16(0x300, get_index_register(&other));
+    TEST_ASSERT_EQUAL_HEX8(0x60, read_memory(&other, PROGRAM_START));
+    TEST_ASSERT_EQUAL_HEX8(0x60, read_memory(&vm, PROGRAM_START));
+    TEST_ASSERT_EQUAL_HEX8(0x1D, read_memory(&vm, PROGRAM_START + 1));
+    free_vm(&other);
 }
 
 int main()
@@ -585,20 +1112,46 @@ int main()
     RUN_TEST(test_xor);
     RUN_TEST(test_jump_updates_program_counter);
     RUN_TEST(test_jump_with_offset_updates_program_counter);
+    RUN_TEST(test_stack_overflow_and_underflow_are_errors);
     RUN_TEST(test_skip_if_variable_equal_constant);
     RUN_TEST(test_skip_if_variable_not_equal_constant);
     RUN_TEST(test_skip_if_variable_equal_variable);
     RUN_TEST(test_skip_if_variable_not_equal_variable);
     RUN_TEST(test_set_index_updates_index_register);
+    RUN_TEST(test_read_delay_timer);
+    RUN_TEST(test_set_delay_timer);
+    RUN_TEST(test_set_sound_timer);
     RUN_TEST(test_add_index_updates_index_register);
-    RUN_TEST(test_add_index_updates_index_register_with_carry);
+    RUN_TEST(test_add_index_updates_index_register_past_12_bits);
     RUN_TEST(test_font_character);
     RUN_TEST(test_draw_renders_sprite);
     RUN_TEST(test_clear_display_clears_display);
     RUN_TEST(test_decimal_conversion);
     RUN_TEST(test_store_memory);
     RUN_TEST(test_load_memory);
+    RUN_TEST(test_memory_access_past_end_is_rejected);
+    RUN_TEST(test_switch_resolution);
+    RUN_TEST(test_scroll_moves_pixels);
+    RUN_TEST(test_draw_renders_large_sprite);
+    RUN_TEST(test_large_font_character);
+    RUN_TEST(test_flag_registers_persist_across_programs);
+    RUN_TEST(test_load_long_index);
+    RUN_TEST(test_skip_skips_long_instruction);
+    RUN_TEST(test_store_register_range);
+    RUN_TEST(test_load_register_range);
+    RUN_TEST(test_select_planes_draws_to_both_planes);
+    RUN_TEST(test_audio_pattern_and_pitch);
+    RUN_TEST(test_skip_if_key_down);
+    RUN_TEST(test_skip_if_key_up);
+    RUN_TEST(test_wait_for_key_blocks_until_release);
     RUN_TEST(test_read_instruction_reads_and_moves_pc);
     RUN_TEST(test_run_cycle_reads_and_executes_instruction);
+    RUN_TEST(test_run_cycle_executes_rewritten_instruction);
+    RUN_TEST(test_run_cycle_executes_self_modified_instruction);
+    RUN_TEST(test_jump_to_self_is_idle);
+    RUN_TEST(test_timer_poll_is_idle_until_timer_runs_out);
+    RUN_TEST(test_timer_poll_with_stale_register_is_not_idle);
+    RUN_TEST(test_wait_for_key_is_idle_until_release);
+    RUN_TEST(test_machines_run_independently);
     return UNITY_END();
 }
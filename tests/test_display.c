@@ -1,12 +1,18 @@
+#include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
+#include "chip8.h"
 #include "display.h"
 #include "macros.h"
 #include "unity.h"
 
+static struct chip8_vm vm;
+
 void setUp()
 {
-    clear_display();
+    select_planes(&vm, 0x1);
+    set_resolution(&vm, false);
 }
 
 void tearDown()
@@ -14,12 +20,34 @@ void tearDown()
     return;
 }
 
+/**
+ * Asserts that exactly the pixels within a rectangle are turned on.
+ *
+ * @param left The leftmost column of the rectangle.
+ * @param top The topmost row of the rectangle.
+ * @param width The amount of columns of the rectangle.
+ * @param height The amount of rows of the rectangle.
+ */
+static void assert_only_rectangle(
+    uint8_t left,
+    uint8_t top,
+    uint8_t width,
+    uint8_t height)
+{
+    for (uint8_t y = 0; y < get_screen_height(&vm); y++) {
+        for (uint8_t x = 0; x < get_screen_width(&vm); x++) {
+            bool inside = x >= left && x < left + width && y >= top &&
+                          y < top + height;
+            TEST_ASSERT_EQUAL(inside, get_pixel(&vm, x, y));
+        }
+    }
+}
+
 void test_clear_display_clears_display()
 {
-    bool(*display)[SCREEN_WIDTH] = get_display();
     for (uint8_t y = 0; y < SCREEN_HEIGHT; y++) {
         for (uint8_t x = 0; x < SCREEN_WIDTH; x++) {
-            TEST_ASSERT_FALSE(display[y][x]);
+            TEST_ASSERT_FALSE(get_pixel(&vm, x, y));
         }
     }
 }
@@ -27,7 +55,7 @@ void test_clear_display_clears_display()
 void test_draw_sprite_draws_sprite()
 {
     uint8_t sprite[6] = {0x6C, 0xFE, 0xFE, 0x7C, 0x38, 0x10};
-    bool vf = draw_sprite(0, 0, len(sprite), sprite);
+    bool vf = draw_sprite(&vm, 0, 0, len(sprite), sprite);
     bool expected[6][8] = {
         {0, 1, 1, 0, 1, 1, 0, 0},
         {1, 1, 1, 1, 1, 1, 1, 0},
@@ -37,10 +65,9 @@ void test_draw_sprite_draws_sprite()
         {0, 0, 0, 1, 0, 0, 0, 0},
     };
 
-    bool(*display)[SCREEN_WIDTH] = get_display();
     for (uint8_t y = 0; y < 6; y++) {
         for (uint8_t x = 0; x < 8; x++) {
-            TEST_ASSERT_EQUAL(expected[y][x], display[y][x]);
+            TEST_ASSERT_EQUAL(expected[y][x], get_pixel(&vm, x, y));
         }
     }
 
@@ -54,13 +81,12 @@ void test_draw_sprite_draws_sprite_with_collision()
     // Draw the sprite twice, effectively clearing the display with a collision.
     bool vf;
     for (uint8_t y = 0; y < 2; y++) {
-        vf = draw_sprite(0, 0, len(sprite), sprite);
+        vf = draw_sprite(&vm, 0, 0, len(sprite), sprite);
     }
 
-    bool(*display)[SCREEN_WIDTH] = get_display();
     for (uint8_t y = 0; y < 6; y++) {
         for (uint8_t x = 0; x < 8; x++) {
-            TEST_ASSERT_FALSE(display[y][x]);
+            TEST_ASSERT_FALSE(get_pixel(&vm, x, y));
         }
     }
 
@@ -71,7 +97,8 @@ void test_draw_sprite_wraps_cursor()
 {
     uint8_t sprite[6] = {0x6C, 0xFE, 0xFE, 0x7C, 0x38, 0x10};
     // Overflow the cursor back to 0,0.
-    bool vf = draw_sprite(SCREEN_WIDTH, SCREEN_HEIGHT, len(sprite), sprite);
+    bool vf =
+        draw_sprite(&vm, SCREEN_WIDTH, SCREEN_HEIGHT, len(sprite), sprite);
     bool expected[6][8] = {
         {0, 1, 1, 0, 1, 1, 0, 0},
         {1, 1, 1, 1, 1, 1, 1, 0},
@@ -81,10 +108,9 @@ void test_draw_sprite_wraps_cursor()
         {0, 0, 0, 1, 0, 0, 0, 0},
     };
 
-    bool(*display)[SCREEN_WIDTH] = get_display();
     for (uint8_t y = 0; y < 6; y++) {
         for (uint8_t x = 0; x < 8; x++) {
-            TEST_ASSERT_EQUAL(expected[y][x], display[y][x]);
+            TEST_ASSERT_EQUAL(expected[y][x], get_pixel(&vm, x, y));
         }
     }
 
@@ -95,8 +121,12 @@ void test_draw_sprite_clips_sprite()
 {
     uint8_t sprite[6] = {0x6C, 0xFE, 0xFE, 0x7C, 0x38, 0x10};
     // Draw the top left corner of the sprite until it overlaps the edges.
-    bool vf =
-        draw_sprite(SCREEN_WIDTH - 2, SCREEN_HEIGHT - 2, len(sprite), sprite);
+    bool vf = draw_sprite(
+        &vm,
+        SCREEN_WIDTH - 2,
+        SCREEN_HEIGHT - 2,
+        len(sprite),
+        sprite);
     bool expected[6][8] = {
         {0, 1, 0, 0, 0, 0, 0, 0},
         {1, 1, 0, 0, 0, 0, 0, 0},
@@ -106,18 +136,241 @@ void test_draw_sprite_clips_sprite()
         {0, 0, 0, 0, 0, 0, 0, 0},
     };
 
-    bool(*display)[SCREEN_WIDTH] = get_display();
     for (uint8_t y = SCREEN_WIDTH - 2; y < 6; y++) {
         for (uint8_t x = SCREEN_HEIGHT - 2; x < 8; x++) {
             TEST_ASSERT_EQUAL(
                 expected[y % SCREEN_HEIGHT][x % SCREEN_WIDTH],
-                display[y % SCREEN_HEIGHT][x % SCREEN_WIDTH]);
+                get_pixel(&vm, x % SCREEN_WIDTH, y % SCREEN_HEIGHT));
         }
     }
 
     TEST_ASSERT_FALSE(vf);
 }
 
+void test_draw_sprite_clips_without_wrapping()
+{
+    uint8_t sprite[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+    // Overlap both the right and bottom edges by half of the sprite.
+    bool vf = draw_sprite(&vm, SCREEN_WIDTH - 4, SCREEN_HEIGHT - 2, 4, sprite);
+
+    for (uint8_t y = 0; y < SCREEN_HEIGHT; y++) {
+        for (uint8_t x = 0; x < SCREEN_WIDTH; x++) {
+            bool inside = x >= SCREEN_WIDTH - 4 && y >= SCREEN_HEIGHT - 2;
+            TEST_ASSERT_EQUAL(inside, get_pixel(&vm, x, y));
+        }
+    }
+
+    TEST_ASSERT_FALSE(vf);
+}
+
+// MARK: High resolution
+
+void test_set_resolution_switches_size_and_clears()
+{
+    uint8_t sprite[1] = {0xFF};
+    draw_sprite(&vm, 0, 0, 1, sprite);
+
+    set_resolution(&vm, true);
+    TEST_ASSERT_EQUAL_UINT8(HIRES_SCREEN_WIDTH, get_screen_width(&vm));
+    TEST_ASSERT_EQUAL_UINT8(HIRES_SCREEN_HEIGHT, get_screen_height(&vm));
+    assert_only_rectangle(0, 0, 0, 0);
+
+    set_resolution(&vm, false);
+    TEST_ASSERT_EQUAL_UINT8(SCREEN_WIDTH, get_screen_width(&vm));
+    TEST_ASSERT_EQUAL_UINT8(SCREEN_HEIGHT, get_screen_height(&vm));
+}
+
+void test_draw_large_sprite_spans_both_words()
+{
+    uint8_t sprite[32];
+    memset(sprite, 0xFF, sizeof(sprite));
+
+    // Straddle the boundary between the words, and clip at the bottom.
+    set_resolution(&vm, true);
+    bool vf = draw_large_sprite(&vm, 56, 60, sprite);
+    assert_only_rectangle(56, 60, 16, 4);
+    TEST_ASSERT_FALSE(vf);
+
+    vf = draw_large_sprite(&vm, 56, 60, sprite);
+    assert_only_rectangle(0, 0, 0, 0);
+    TEST_ASSERT_TRUE(vf);
+}
+
+void test_draw_large_sprite_clips_right_edge()
+{
+    uint8_t sprite[32];
+    memset(sprite, 0xFF, sizeof(sprite));
+
+    set_resolution(&vm, true);
+    draw_large_sprite(&vm, 120, 0, sprite);
+    assert_only_rectangle(120, 0, 8, 16);
+
+    set_resolution(&vm, false);
+    draw_large_sprite(&vm, 56, 0, sprite);
+    assert_only_rectangle(56, 0, 8, 16);
+}
+
+void test_draw_wrapped_large_sprite_wraps_around_edges()
+{
+    uint8_t sprite[32];
+    memset(sprite, 0xFF, sizeof(sprite));
+
+    set_resolution(&vm, true);
+    draw_wrapped_large_sprite(&vm, 120, 60, sprite);
+    for (uint8_t y = 0; y < HIRES_SCREEN_HEIGHT; y++) {
+        for (uint8_t x = 0; x < HIRES_SCREEN_WIDTH; x++) {
+            bool inside = (x >= 120 || x < 8) && (y >= 60 || y < 12);
+            TEST_ASSERT_EQUAL(inside, get_pixel(&vm, x, y));
+        }
+    }
+}
+
+// MARK: Scrolling
+
+void test_scroll_down_moves_rows()
+{
+    uint8_t sprite[2] = {0xFF, 0xFF};
+
+    draw_sprite(&vm, 8, 0, 2, sprite);
+    scroll_down(&vm, 3);
+    assert_only_rectangle(8, 3, 8, 2);
+
+    // Rows scrolled off the bottom are gone for good.
+    scroll_down(&vm, SCREEN_HEIGHT - 4);
+    scroll_down(&vm, 15);
+    assert_only_rectangle(0, 0, 0, 0);
+}
+
+void test_scroll_up_moves_rows()
+{
+    uint8_t sprite[2] = {0xFF, 0xFF};
+
+    draw_sprite(&vm, 8, 10, 2, sprite);
+    scroll_up(&vm, 3);
+    assert_only_rectangle(8, 7, 8, 2);
+
+    // Rows scrolled off the top are gone for good.
+    scroll_up(&vm, 8);
+    scroll_down(&vm, 8);
+    assert_only_rectangle(8, 8, 8, 1);
+}
+
+void test_scroll_sideways_carries_between_words()
+{
+    uint8_t sprite[1] = {0xFF};
+
+    set_resolution(&vm, true);
+    draw_sprite(&vm, 58, 10, 1, sprite);
+    scroll_right(&vm, 4);
+    assert_only_rectangle(62, 10, 8, 1);
+
+    scroll_left(&vm, 4);
+    scroll_left(&vm, 4);
+    assert_only_rectangle(54, 10, 8, 1);
+
+    // Columns scrolled off either edge are gone for good.
+    draw_sprite(&vm, 54, 10, 1, sprite);
+    draw_sprite(&vm, 120, 10, 1, sprite);
+    scroll_right(&vm, 4);
+    scroll_left(&vm, 4);
+    assert_only_rectangle(120, 10, 4, 1);
+}
+
+void test_scroll_sideways_stays_within_low_resolution()
+{
+    uint8_t sprite[1] = {0xFF};
+
+    draw_sprite(&vm, 58, 10, 1, sprite);
+    scroll_right(&vm, 4);
+    assert_only_rectangle(62, 10, 2, 1);
+
+    scroll_left(&vm, 4);
+    assert_only_rectangle(58, 10, 2, 1);
+}
+
+// MARK: Planes
+
+void test_draw_sprite_draws_a_sprite_per_plane()
+{
+    // The sprite of the second plane follows the full sprite of the first,
+    // even though the bottom row of both is clipped.
+    uint8_t sprite[4] = {0xF0, 0xF0, 0x3C, 0x3C};
+
+    select_planes(&vm, 0x3);
+    bool vf = draw_sprite(&vm, 0, SCREEN_HEIGHT - 1, 2, sprite);
+    TEST_ASSERT_FALSE(vf);
+    TEST_ASSERT_EQUAL_UINT8(0x1, get_pixel_planes(&vm, 0, SCREEN_HEIGHT - 1));
+    TEST_ASSERT_EQUAL_UINT8(0x3, get_pixel_planes(&vm, 2, SCREEN_HEIGHT - 1));
+    TEST_ASSERT_EQUAL_UINT8(0x2, get_pixel_planes(&vm, 4, SCREEN_HEIGHT - 1));
+    TEST_ASSERT_EQUAL_UINT8(0x0, get_pixel_planes(&vm, 6, SCREEN_HEIGHT - 1));
+
+    // A collision in either plane counts.
+    select_planes(&vm, 0x2);
+    vf = draw_sprite(&vm, 0, SCREEN_HEIGHT - 1, 1, &sprite[2]);
+    TEST_ASSERT_TRUE(vf);
+    TEST_ASSERT_EQUAL_UINT8(0x1, get_pixel_planes(&vm, 2, SCREEN_HEIGHT - 1));
+}
+
+void test_unselected_planes_are_left_alone()
+{
+    uint8_t sprite[1] = {0xFF};
+
+    select_planes(&vm, 0x2);
+    draw_sprite(&vm, 0, 4, 1, sprite);
+    select_planes(&vm, 0x1);
+    draw_sprite(&vm, 8, 4, 1, sprite);
+
+    scroll_down(&vm, 2);
+    TEST_ASSERT_EQUAL_UINT8(0x2, get_pixel_planes(&vm, 0, 4));
+    TEST_ASSERT_EQUAL_UINT8(0x1, get_pixel_planes(&vm, 8, 6));
+
+    clear_display(&vm);
+    TEST_ASSERT_EQUAL_UINT8(0x2, get_pixel_planes(&vm, 0, 4));
+    TEST_ASSERT_FALSE(get_pixel(&vm, 8, 6));
+
+    // Switching the resolution clears every plane.
+    set_resolution(&vm, true);
+    TEST_ASSERT_FALSE(get_pixel(&vm, 0, 4));
+}
+
+void test_no_selected_planes_draws_nothing()
+{
+    uint8_t sprite[1] = {0xFF};
+
+    select_planes(&vm, 0x0);
+    TEST_ASSERT_FALSE(draw_sprite(&vm, 0, 0, 1, sprite));
+    assert_only_rectangle(0, 0, 0, 0);
+}
+
+// MARK: Resetting
+
+void test_reset_display_clears_drawn_rows()
+{
+    static const uint64_t blank[PLANE_COUNT][HIRES_SCREEN_HEIGHT][ROW_WORDS];
+    uint8_t sprite[64];
+    memset(sprite, 0xFF, sizeof(sprite));
+
+    // Both planes, wrapping around the bottom right corner.
+    set_resolution(&vm, true);
+    select_planes(&vm, 0x3);
+    draw_wrapped_large_sprite(&vm, 120, 56, sprite);
+    reset_display(&vm);
+    TEST_ASSERT_FALSE(vm.hires);
+    TEST_ASSERT_EQUAL_MEMORY(blank, vm.display, sizeof(blank));
+
+    // The bottom of the low resolution wraps around to the top.
+    select_planes(&vm, 0x1);
+    draw_wrapped_sprite(&vm, 0, 30, 5, sprite);
+    reset_display(&vm);
+    TEST_ASSERT_EQUAL_MEMORY(blank, vm.display, sizeof(blank));
+
+    // Scrolled rows are cleared even if nothing was drawn to them.
+    draw_sprite(&vm, 0, 0, 1, sprite);
+    scroll_down(&vm, 9);
+    reset_display(&vm);
+    TEST_ASSERT_EQUAL_MEMORY(blank, vm.display, sizeof(blank));
+}
+
 int main()
 {
     UNITY_BEGIN();
@@ -126,5 +379,18 @@ int main()
     RUN_TEST(test_draw_sprite_draws_sprite_with_collision);
     RUN_TEST(test_draw_sprite_wraps_cursor);
     RUN_TEST(test_draw_sprite_clips_sprite);
+    RUN_TEST(test_draw_sprite_clips_without_wrapping);
+    RUN_TEST(test_set_resolution_switches_size_and_clears);
+    RUN_TEST(test_draw_large_sprite_spans_both_words);
+    RUN_TEST(test_draw_large_sprite_clips_right_edge);
+    RUN_TEST(test_draw_wrapped_large_sprite_wraps_around_edges);
+    RUN_TEST(test_scroll_down_moves_rows);
+    RUN_TEST(test_scroll_up_moves_rows);
+    RUN_TEST(test_scroll_sideways_carries_between_words);
+    RUN_TEST(test_scroll_sideways_stays_within_low_resolution);
+    RUN_TEST(test_draw_sprite_draws_a_sprite_per_plane);
+    RUN_TEST(test_unselected_planes_are_left_alone);
+    RUN_TEST(test_no_selected_planes_draws_nothing);
+    RUN_TEST(test_reset_display_clears_drawn_rows);
     return UNITY_END();
 }
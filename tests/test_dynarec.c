@@ -0,0 +1,263 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "cpu.h"
+#include "display.h"
+#include "dynarec.h"
+#include "macros.h"
+#include "memory.h"
+#include "quirks.h"
+#include "unity.h"
+
+// The observable state of the system after running a program.
+struct snapshot {
+    uint64_t cycles;
+    enum cpu_status_code code;
+    uint16_t PC;
+    uint16_t I;
+    uint8_t V[16];
+    uint8_t memory[MEMORY_SIZE];
+    bool pixels[SCREEN_HEIGHT][SCREEN_WIDTH];
+};
+
+static struct chip8_vm vm;
+static struct snapshot expected;
+static struct snapshot actual;
+
+// Every natively translated arithmetic and logic instruction, in a loop.
+static const uint8_t ARITHMETIC[] = {
+    0x6A, 0x00,  // 0x200: VA = 0
+    0x60, 0x37,  // 0x202: V0 = 0x37
+    0x61, 0xC9,  // 0x204: V1 = 0xC9
+    0x80, 0xA4,  // 0x206: V0 += VA
+    0x82, 0x00,  // 0x208: V2 = V0
+    0x82, 0x15,  // 0x20A: Subtract V1 and V2
+    0x83, 0x10,  // 0x20C: V3 = V1
+    0x83, 0x07,  // 0x20E: Subtract V3 and V0
+    0x84, 0x00,  // 0x210: V4 = V0
+    0x84, 0x06,  // 0x212: V4 >>= 1
+    0x85, 0x10,  // 0x214: V5 = V1
+    0x85, 0x0E,  // 0x216: V5 <<= 1
+    0x86, 0x01,  // 0x218: V6 |= V0
+    0x86, 0x12,  // 0x21A: V6 &= V1
+    0x87, 0x03,  // 0x21C: V7 ^= V0
+    0x8F, 0x14,  // 0x21E: VF += V1
+    0x7A, 0x0B,  // 0x220: VA += 0x0B
+    0x88, 0xF4,  // 0x222: V8 += VF
+    0x3A, 0x00,  // 0x224: Skip if VA == 0
+    0x12, 0x06,  // 0x226: Jump to 0x206
+    0x12, 0x28,  // 0x228: Jump to 0x228
+};
+
+// Every kind of skip, both taken and not taken.
+static const uint8_t SKIPS[] = {
+    0x60, 0x05,  // 0x200: V0 = 5
+    0x61, 0x05,  // 0x202: V1 = 5
+    0x50, 0x10,  // 0x204: Skip if V0 == V1
+    0x72, 0x01,  // 0x206: V2 += 1
+    0x90, 0x10,  // 0x208: Skip if V0 != V1
+    0x73, 0x01,  // 0x20A: V3 += 1
+    0x40, 0x05,  // 0x20C: Skip if V0 != 5
+    0x74, 0x01,  // 0x20E: V4 += 1
+    0x70, 0x01,  // 0x210: V0 += 1
+    0x12, 0x04,  // 0x212: Jump to 0x204
+};
+
+// Mixes native blocks with instructions left to the interpreter.
+static const uint8_t INTERPRETED[] = {
+    0x60, 0x00,  // 0x200: V0 = 0
+    0x61, 0x00,  // 0x202: V1 = 0
+    0x22, 0x0C,  // 0x204: Call 0x20C
+    0x70, 0x01,  // 0x206: V0 += 1
+    0x71, 0x03,  // 0x208: V1 += 3
+    0x12, 0x04,  // 0x20A: Jump to 0x204
+    0xF0, 0x29,  // 0x20C: I = font character of V0
+    0xD0, 0x15,  // 0x20E: Draw 8x5 at V0, V1
+    0xA3, 0x00,  // 0x210: I = 0x300
+    0xF0, 0x33,  // 0x212: Store decimal digits of V0
+    0x00, 0xEE,  // 0x214: Return
+};
+
+// Rewrites an instruction of a loop that has already been translated.
+static const uint8_t SELF_MODIFYING[] = {
+    0x60, 0x00,  // 0x200: V0 = 0
+    0x70, 0x01,  // 0x202: V0 += 1, rewritten to V0 += 2
+    0x30, 0x10,  // 0x204: Skip if V0 == 0x10
+    0x12, 0x02,  // 0x206: Jump to 0x202
+    0x60, 0x70,  // 0x208: V0 = 0x70
+    0x61, 0x02,  // 0x20A: V1 = 0x02
+    0xA2, 0x02,  // 0x20C: I = 0x202
+    0xF1, 0x55,  // 0x20E: Store V0 to V1
+    0x60, 0x00,  // 0x210: V0 = 0
+    0x12, 0x02,  // 0x212: Jump to 0x202
+};
+
+// Skips over instructions spanning four bytes.
+static const uint8_t LONG_SKIPS[] = {
+    0x6A, 0x00,  // 0x200: VA = 0
+    0x7A, 0x01,  // 0x202: VA += 1
+    0x3A, 0x03,  // 0x204: Skip if VA == 3
+    0xF0, 0x00,  // 0x206: I = 0x1234
+    0x12, 0x34,  //
+    0x4A, 0x06,  // 0x20A: Skip if VA != 6
+    0xF0, 0x00,  // 0x20C: I = 0x5678
+    0x56, 0x78,  //
+    0x12, 0x02,  // 0x210: Jump to 0x202
+};
+
+// Runs off the end of memory after native blocks. Filled in by its test, as it
+// spans the whole program space.
+static uint8_t out_of_bounds[MEMORY_SIZE - PROGRAM_START];
+
+void setUp()
+{
+    init_vm(&vm);
+}
+
+void tearDown()
+{
+    free_vm(&vm);
+}
+
+/**
+ * Runs a program on a core, and captures the state it leaves behind.
+ *
+ * @param core The core to run the program on.
+ * @param rom The bytes of the program.
+ * @param size The amount of bytes of the program.
+ * @param cycles The maximum amount of CPU cycles to run.
+ * @param result The snapshot to fill in.
+ */
+static void run_on_core(
+    enum cpu_core core,
+    const uint8_t *rom,
+    uint16_t size,
+    uint64_t cycles,
+    struct snapshot *result)
+{
+    set_cpu_core(&vm, core);
+    startup_rom(&vm, rom, size);
+
+    struct cpu_status status;
+    result->cycles = run_cycles(&vm, cycles, &status);
+    result->code = status.code;
+    result->PC = get_program_counter(&vm);
+    result->I = get_index_register(&vm);
+    for (uint8_t i = 0; i < 16; i++) {
+        result->V[i] = get_variable_registers(&vm)[i];
+    }
+    for (uint32_t address = 0; address < MEMORY_SIZE; address++) {
+        result->memory[address] = read_memory(&vm, address);
+    }
+    for (uint8_t y = 0; y < SCREEN_HEIGHT; y++) {
+        for (uint8_t x = 0; x < SCREEN_WIDTH; x++) {
+            result->pixels[y][x] = get_pixel(&vm, x, y);
+        }
+    }
+}
+
+/**
+ * Asserts that the recompiler leaves the same state as the table core.
+ *
+ * @param rom The bytes of the program.
+ * @param size The amount of bytes of the program.
+ * @param cycles The maximum amount of CPU cycles to run.
+ */
+static void assert_cores_match(
+    const uint8_t *rom,
+    uint16_t size,
+    uint64_t cycles)
+{
+    run_on_core(CORE_TABLE, rom, size, cycles, &expected);
+    run_on_core(CORE_DYNAREC, rom, size, cycles, &actual);
+
+    TEST_ASSERT_EQUAL_UINT64(expected.cycles, actual.cycles);
+    TEST_ASSERT_EQUAL_UINT8(expected.code, actual.code);
+    TEST_ASSERT_EQUAL_HEX16(expected.PC, actual.PC);
+    TEST_ASSERT_EQUAL_HEX16(expected.I, actual.I);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.V, actual.V, 16);
+    TEST_ASSERT_EQUAL_MEMORY(
+        expected.memory,
+        actual.memory,
+        sizeof(expected.memory));
+    TEST_ASSERT_EQUAL_MEMORY(
+        expected.pixels,
+        actual.pixels,
+        sizeof(expected.pixels));
+}
+
+// MARK: Translation
+
+void test_arithmetic_matches_interpreter()
+{
+    assert_cores_match(ARITHMETIC, sizeof(ARITHMETIC), 100000);
+}
+
+void test_skips_match_interpreter()
+{
+    assert_cores_match(SKIPS, sizeof(SKIPS), 10000);
+}
+
+void test_interpreted_instructions_match_interpreter()
+{
+    assert_cores_match(INTERPRETED, sizeof(INTERPRETED), 10000);
+}
+
+void test_self_modifying_code_matches_interpreter()
+{
+    assert_cores_match(SELF_MODIFYING, sizeof(SELF_MODIFYING), 10000);
+
+    // The rewritten instruction has to have run at least once.
+    TEST_ASSERT_EQUAL_HEX8(0x02, actual.memory[0x203]);
+}
+
+void test_long_skips_match_interpreter()
+{
+    assert_cores_match(LONG_SKIPS, sizeof(LONG_SKIPS), 10000);
+}
+
+void test_invalid_memory_access_matches_interpreter()
+{
+    // Jump to an odd address, and add to VA at every address after it, so the
+    // last instruction ends right on the last byte of memory.
+    memset(out_of_bounds, 0x7A, sizeof(out_of_bounds));
+    out_of_bounds[0] = 0x12;  // 0x200: Jump to 0x203
+    out_of_bounds[1] = 0x03;
+
+    assert_cores_match(out_of_bounds, sizeof(out_of_bounds), 100000);
+    TEST_ASSERT_EQUAL_UINT8(INVALID_MEMORY_ACCESS, actual.code);
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, actual.PC);
+}
+
+void test_vip_quirks_match_interpreter()
+{
+    set_quirks(&vm, QUIRK_PROFILES[QUIRKS_VIP]);
+    assert_cores_match(ARITHMETIC, sizeof(ARITHMETIC), 100000);
+}
+
+// MARK: Cycle budget
+
+void test_partial_blocks_run_exact_cycle_counts()
+{
+    uint64_t counts[] = {1, 2, 3, 4, 17, 18, 19, 20, 21, 1000, 1001};
+    for (uint8_t i = 0; i < len(counts); i++) {
+        assert_cores_match(ARITHMETIC, sizeof(ARITHMETIC), counts[i]);
+        assert_cores_match(SKIPS, sizeof(SKIPS), counts[i]);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_arithmetic_matches_interpreter);
+    RUN_TEST(test_skips_match_interpreter);
+    RUN_TEST(test_interpreted_instructions_match_interpreter);
+    RUN_TEST(test_self_modifying_code_matches_interpreter);
+    RUN_TEST(test_long_skips_match_interpreter);
+    RUN_TEST(test_invalid_memory_access_matches_interpreter);
+    RUN_TEST(test_vip_quirks_match_interpreter);
+    RUN_TEST(test_partial_blocks_run_exact_cycle_counts);
+    return UNITY_END();
+}
@@ -0,0 +1,130 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "display.h"
+#include "frame.h"
+#include "keypad.h"
+#include "unity.h"
+
+static struct chip8_vm vm;
+static struct frame_buffer buffer;
+
+void setUp()
+{
+    init_vm(&vm);
+    init_frame_buffer(&buffer);
+}
+
+void tearDown()
+{
+    free_vm(&vm);
+}
+
+// MARK: Handoff
+
+void test_take_before_publish_returns_blank_frame()
+{
+    bool fresh = true;
+    const struct frame *frame = take_frame(&buffer, &fresh);
+
+    TEST_ASSERT_FALSE(fresh);
+    TEST_ASSERT_EQUAL_UINT64(0, frame->version);
+    TEST_ASSERT_EQUAL_UINT64(0, frame->display[0][0][0]);
+}
+
+void test_published_frame_is_taken_once()
+{
+    vm.display[0][0][0] = 0x8000000000000001;
+    vm.display_dirty = true;
+    publish_frame(&buffer, &vm);
+
+    bool fresh = false;
+    const struct frame *frame = take_frame(&buffer, &fresh);
+    TEST_ASSERT_TRUE(fresh);
+    TEST_ASSERT_EQUAL_HEX64(0x8000000000000001, frame->display[0][0][0]);
+    TEST_ASSERT_FALSE(vm.display_dirty);
+
+    // The same frame is returned until another one is published.
+    TEST_ASSERT_TRUE(frame == take_frame(&buffer, &fresh));
+    TEST_ASSERT_FALSE(fresh);
+}
+
+void test_newest_frame_wins()
+{
+    for (uint8_t i = 1; i <= 5; i++) {
+        vm.display[1][3][1] = i;
+        vm.display_dirty = true;
+        publish_frame(&buffer, &vm);
+    }
+
+    const struct frame *frame = take_frame(&buffer, NULL);
+    TEST_ASSERT_EQUAL_HEX64(5, frame->display[1][3][1]);
+    TEST_ASSERT_EQUAL_UINT64(5, frame->version);
+}
+
+void test_taken_frame_survives_publishing()
+{
+    vm.display[0][0][0] = 1;
+    publish_frame(&buffer, &vm);
+    const struct frame *frame = take_frame(&buffer, NULL);
+
+    // Only the back and middle slots are written while the renderer holds
+    // the front one.
+    for (uint8_t i = 2; i < 10; i++) {
+        vm.display[0][0][0] = i;
+        publish_frame(&buffer, &vm);
+    }
+    TEST_ASSERT_EQUAL_HEX64(1, frame->display[0][0][0]);
+    TEST_ASSERT_EQUAL_HEX64(9, take_frame(&buffer, NULL)->display[0][0][0]);
+}
+
+// MARK: Metadata
+
+void test_version_only_counts_changed_displays()
+{
+    vm.display_dirty = true;
+    publish_frame(&buffer, &vm);
+    publish_frame(&buffer, &vm);
+    TEST_ASSERT_EQUAL_UINT64(1, take_frame(&buffer, NULL)->version);
+
+    set_resolution(&vm, true);
+    publish_frame(&buffer, &vm);
+    const struct frame *frame = take_frame(&buffer, NULL);
+    TEST_ASSERT_EQUAL_UINT64(2, frame->version);
+    TEST_ASSERT_TRUE(frame->hires);
+}
+
+void test_frame_is_idle_while_waiting_for_key()
+{
+    const uint8_t rom[] = {0xF5, 0x0A, 0x12, 0x02};  // V5 = key, then spin
+    startup_rom(&vm, rom, sizeof(rom));
+    set_keys(&vm, 1 << 0x3);
+    publish_frame(&buffer, &vm);
+    const struct frame *frame = take_frame(&buffer, NULL);
+    TEST_ASSERT_TRUE(frame->idle);
+    TEST_ASSERT_EQUAL_HEX16(1 << 0x3, frame->keys);
+
+    // A running timer changes the machine without any key.
+    vm.delay_timer = 1;
+    publish_frame(&buffer, &vm);
+    TEST_ASSERT_FALSE(take_frame(&buffer, NULL)->idle);
+
+    // A released key wakes the CPU up.
+    vm.delay_timer = 0;
+    set_keys(&vm, 0);
+    publish_frame(&buffer, &vm);
+    TEST_ASSERT_FALSE(take_frame(&buffer, NULL)->idle);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_take_before_publish_returns_blank_frame);
+    RUN_TEST(test_published_frame_is_taken_once);
+    RUN_TEST(test_newest_frame_wins);
+    RUN_TEST(test_taken_frame_survives_publishing);
+    RUN_TEST(test_version_only_counts_changed_displays);
+    RUN_TEST(test_frame_is_idle_while_waiting_for_key);
+    return UNITY_END();
+}
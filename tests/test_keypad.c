@@ -0,0 +1,90 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "cpu.h"
+#include "keypad.h"
+#include "unity.h"
+
+static struct chip8_vm vm;
+
+void setUp()
+{
+    init_vm(&vm);
+}
+
+void tearDown()
+{
+    free_vm(&vm);
+}
+
+// MARK: Keys
+
+void test_set_keys_holds_keys_down()
+{
+    set_keys(&vm, 1 << 0x0 | 1 << 0xF);
+
+    TEST_ASSERT_TRUE(is_key_down(&vm, 0x0));
+    TEST_ASSERT_TRUE(is_key_down(&vm, 0xF));
+    TEST_ASSERT_FALSE(is_key_down(&vm, 0x1));
+
+    // Only the lowest nibble names the key, as with FX29.
+    TEST_ASSERT_TRUE(is_key_down(&vm, 0x1F));
+}
+
+void test_released_keys_accumulate_until_taken()
+{
+    uint8_t key = 0xFF;
+    TEST_ASSERT_FALSE(take_released_key(&vm, &key));
+
+    set_keys(&vm, 1 << 0x9 | 1 << 0x4);
+    set_keys(&vm, 1 << 0x4);
+    set_keys(&vm, 0);
+
+    // The lowest key is taken, and every other release with it.
+    TEST_ASSERT_TRUE(take_released_key(&vm, &key));
+    TEST_ASSERT_EQUAL_HEX8(0x4, key);
+    TEST_ASSERT_FALSE(take_released_key(&vm, &key));
+}
+
+// MARK: Waits
+
+void test_is_waiting_for_key_on_wait_instruction()
+{
+    const uint8_t rom[] = {0xF5, 0x0A, 0x12, 0x02};  // V5 = key, then spin
+    startup_rom(&vm, rom, sizeof(rom));
+    TEST_ASSERT_TRUE(is_waiting_for_key(&vm));
+
+    // A released key wakes the CPU up.
+    set_keys(&vm, 1 << 0x3);
+    set_keys(&vm, 0);
+    TEST_ASSERT_FALSE(is_waiting_for_key(&vm));
+
+    run_cycle(&vm);
+    TEST_ASSERT_EQUAL_HEX8(0x3, get_variable_registers(&vm)[5]);
+    TEST_ASSERT_FALSE(is_waiting_for_key(&vm));
+}
+
+void test_is_blocked_on_keys_only_without_timers()
+{
+    const uint8_t rom[] = {0xF5, 0x0A};  // V5 = key
+    startup_rom(&vm, rom, sizeof(rom));
+    TEST_ASSERT_TRUE(is_blocked_on_keys(&vm));
+
+    // A running timer still changes the machine every tick.
+    vm.delay_timer = 1;
+    TEST_ASSERT_FALSE(is_blocked_on_keys(&vm));
+    vm.delay_timer = 0;
+    vm.sound_timer = 1;
+    TEST_ASSERT_FALSE(is_blocked_on_keys(&vm));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_set_keys_holds_keys_down);
+    RUN_TEST(test_released_keys_accumulate_until_taken);
+    RUN_TEST(test_is_waiting_for_key_on_wait_instruction);
+    RUN_TEST(test_is_blocked_on_keys_only_without_timers);
+    return UNITY_END();
+}
@@ -1,11 +1,14 @@
 #include <stdint.h>
 
+#include "chip8.h"
 #include "memory.h"
 #include "unity.h"
 
+static struct chip8_vm vm;
+
 void setUp()
 {
-    init_memory();
+    init_memory(&vm);
 }
 
 void tearDown()
@@ -13,12 +16,13 @@ void tearDown()
     return;
 }
 
-void test_init_memory_loads_only_font()
+void test_init_memory_loads_only_fonts()
 {
-    for (uint16_t address = 0x000; address < MEMORY_SIZE; address++) {
-        uint8_t value = read_memory(address);  // Implicit test.
-        if (address >= FONT_START && address < FONT_START + FONT_SIZE) {
-            // The font is privately scoped, so only check for non-zero values.
+    uint16_t fonts_end = LARGE_FONT_START + LARGE_FONT_SIZE;
+    for (uint32_t address = 0x000; address < MEMORY_SIZE; address++) {
+        uint8_t value = read_memory(&vm, address);  // Implicit test.
+        if (address >= FONT_START && address < fonts_end) {
+            // The fonts are privately scoped, so only check for non-zero bytes.
             TEST_ASSERT_NOT_EQUAL_INT8(0x000, value);
         } else {
             TEST_ASSERT_EQUAL_INT8(0x000, value);
@@ -28,18 +32,39 @@ void test_init_memory_loads_only_font()
 
 void test_load_program_loads_program()
 {
-    uint8_t program[4] = {0x00, 0xE0, 0x12, 0x00};
-    load_program(program);
-    uint8_t *memory = get_memory_pointer(PROGRAM_START);  // Implicit test.
+    const uint8_t program[] = {0x00, 0xE0, 0x12, 0x00};
+    load_program(&vm, program, sizeof(program));
+    uint8_t *memory = get_memory_pointer(&vm, PROGRAM_START);  // Implicit test.
     for (uint16_t offset = 0; offset < 4; offset++) {
         TEST_ASSERT_EQUAL_INT8(program[offset], memory[offset]);
     }
 }
 
+void test_reset_memory_restores_initial_memory()
+{
+    static struct chip8_vm initial;
+    init_memory(&initial);
+
+    // Write over the font, a program and the very end of memory.
+    write_memory(&vm, FONT_START + 7, 0xAA);
+    const uint8_t program[] = {0x00, 0xE0, 0x12, 0x00};
+    load_program(&vm, program, sizeof(program));
+    uint8_t *memory = get_memory_pointer(&vm, MEMORY_SIZE - 3);
+    memory[0] = memory[1] = memory[2] = 0x55;
+    mark_memory_written(&vm, MEMORY_SIZE - 3, 3);
+
+    reset_memory(&vm);
+    TEST_ASSERT_EQUAL_MEMORY(initial.memory, vm.memory, MEMORY_SIZE);
+    for (uint8_t i = 0; i < MEMORY_LINES / 64; i++) {
+        TEST_ASSERT_EQUAL_HEX64(0, vm.dirty_lines[i]);
+    }
+}
+
 int main()
 {
     UNITY_BEGIN();
-    RUN_TEST(test_init_memory_loads_only_font);
+    RUN_TEST(test_init_memory_loads_only_fonts);
     RUN_TEST(test_load_program_loads_program);
+    RUN_TEST(test_reset_memory_restores_initial_memory);
     return UNITY_END();
 }
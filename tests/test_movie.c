@@ -0,0 +1,235 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "cpu.h"
+#include "keypad.h"
+#include "macros.h"
+#include "movie.h"
+#include "quirks.h"
+#include "rng.h"
+#include "scheduler.h"
+#include "unity.h"
+
+// Moves a random font character around with keys 5, 7, 8 and 9, and waits
+// for a release of key 0 whenever it is held down.
+static const uint8_t GAME[] = {
+    0x60, 0x00,  // 0x200: V0 = 0
+    0xF3, 0x29,  // 0x202: I = font character of V3
+    0xD1, 0x25,  // 0x204: Draw 8x5 at V1, V2
+    0x64, 0x05,  // 0x206: V4 = 5
+    0xE4, 0xA1,  // 0x208: Skip if key V4 is up
+    0x72, 0xFF,  // 0x20A: V2 -= 1
+    0x64, 0x08,  // 0x20C: V4 = 8
+    0xE4, 0xA1,  // 0x20E: Skip if key V4 is up
+    0x72, 0x01,  // 0x210: V2 += 1
+    0x64, 0x07,  // 0x212: V4 = 7
+    0xE4, 0xA1,  // 0x214: Skip if key V4 is up
+    0x71, 0xFF,  // 0x216: V1 -= 1
+    0x64, 0x09,  // 0x218: V4 = 9
+    0xE4, 0xA1,  // 0x21A: Skip if key V4 is up
+    0x71, 0x01,  // 0x21C: V1 += 1
+    0xE0, 0xA1,  // 0x21E: Skip if key V0 is up
+    0xF6, 0x0A,  // 0x220: V6 = key
+    0xC3, 0x0F,  // 0x222: V3 = random & 0xF
+    0x12, 0x02,  // 0x224: Jump to 0x202
+};
+
+// The keys held down per frame while recording, cycling through these.
+static const uint16_t KEYS[] = {
+    0,
+    1 << 0x5,
+    1 << 0x5 | 1 << 0x9,
+    1 << 0x0,
+    0,
+    1 << 0x8 | 1 << 0x7,
+};
+
+#define FRAMES 600        // Ten seconds of recorded input
+#define FRAMES_PER_KEY 7  // Frames each entry of KEYS is held for
+
+static struct chip8_vm vm;
+static struct movie movie;
+static uint8_t buffer[MOVIE_HEADER_SIZE + FRAMES * MOVIE_RUN_SIZE];
+
+/**
+ * Records the game played with a non-default seed, speed and quirks.
+ */
+static void record_game()
+{
+    seed_rng(&vm, 1234);
+    set_instructions_per_second(&vm, 1000);
+    set_quirks(&vm, QUIRK_PROFILES[QUIRKS_VIP]);
+    startup_rom(&vm, GAME, sizeof(GAME));
+    start_recording(&movie, &vm);
+
+    struct cpu_status status;
+    for (uint32_t frame = 0; frame < FRAMES; frame++) {
+        uint16_t keys = KEYS[frame / FRAMES_PER_KEY % len(KEYS)];
+        set_keys(&vm, keys);
+        record_keys(&movie, keys);
+        run_frame(&vm, &status);
+    }
+    finish_recording(&movie, &vm);
+}
+
+/**
+ * Plays the recorded movie back into a fresh machine with default settings.
+ *
+ * @return If the machine ended up where the recording did.
+ */
+static bool play_game()
+{
+    free_vm(&vm);
+    init_vm(&vm);
+    startup_rom(&vm, GAME, sizeof(GAME));
+    TEST_ASSERT_TRUE(start_playback(&movie, &vm));
+
+    struct cpu_status status;
+    uint16_t keys;
+    while (next_keys(&movie, &keys)) {
+        set_keys(&vm, keys);
+        run_frame(&vm, &status);
+    }
+    return verify_movie(&movie, &vm);
+}
+
+void setUp()
+{
+    init_vm(&vm);
+    init_movie(&movie);
+}
+
+void tearDown()
+{
+    free_movie(&movie);
+    free_vm(&vm);
+}
+
+// MARK: Recording
+
+void test_recording_keeps_settings()
+{
+    record_game();
+
+    TEST_ASSERT_EQUAL_UINT64(1234, movie.seed);
+    TEST_ASSERT_EQUAL_UINT32(1000, movie.speed);
+    TEST_ASSERT_TRUE(movie.quirks.vf_reset);
+    TEST_ASSERT_EQUAL_UINT32(FRAMES, movie.frames);
+    TEST_ASSERT_EQUAL_HEX64(hash_vm(&vm), movie.final_hash);
+}
+
+void test_unchanged_keys_share_a_run()
+{
+    record_game();
+
+    // A new run whenever KEYS moves on, rounded up for the last one.
+    TEST_ASSERT_EQUAL_UINT32(
+        (FRAMES + FRAMES_PER_KEY - 1) / FRAMES_PER_KEY,
+        movie.run_count);
+    TEST_ASSERT_EQUAL_UINT16(FRAMES_PER_KEY, movie.runs[0].frames);
+}
+
+// MARK: Playback
+
+void test_playback_ends_in_recorded_state()
+{
+    record_game();
+    TEST_ASSERT_TRUE(play_game());
+}
+
+void test_playback_matches_on_every_core()
+{
+    record_game();
+
+    for (enum cpu_core core = CORE_TABLE; core <= CORE_DYNAREC; core++) {
+        free_vm(&vm);
+        init_vm(&vm);
+        set_cpu_core(&vm, core);
+        startup_rom(&vm, GAME, sizeof(GAME));
+        start_playback(&movie, &vm);
+
+        struct cpu_status status;
+        uint16_t keys;
+        while (next_keys(&movie, &keys)) {
+            set_keys(&vm, keys);
+            run_frame(&vm, &status);
+        }
+        TEST_ASSERT_TRUE(verify_movie(&movie, &vm));
+    }
+}
+
+void test_playback_detects_divergence()
+{
+    record_game();
+    movie.runs[3].keys ^= 1 << 0x9;
+    TEST_ASSERT_FALSE(play_game());
+}
+
+void test_playback_rejects_other_program()
+{
+    record_game();
+
+    const uint8_t other[] = {0x12, 0x00};
+    startup_rom(&vm, other, sizeof(other));
+    TEST_ASSERT_FALSE(start_playback(&movie, &vm));
+    TEST_ASSERT_EQUAL_UINT32(1000, vm.scheduler.instructions_per_second);
+}
+
+// MARK: Saving
+
+void test_saved_movie_plays_back()
+{
+    record_game();
+    size_t size = save_movie(&movie, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_UINT64(movie_size(&movie), size);
+
+    struct movie loaded;
+    init_movie(&loaded);
+    TEST_ASSERT_TRUE(load_movie(&loaded, buffer, size));
+    free_movie(&movie);
+    movie = loaded;
+
+    TEST_ASSERT_EQUAL_UINT64(1234, movie.seed);
+    TEST_ASSERT_TRUE(play_game());
+}
+
+void test_load_rejects_invalid_movies()
+{
+    record_game();
+    size_t size = save_movie(&movie, buffer, sizeof(buffer));
+
+    struct movie loaded;
+    init_movie(&loaded);
+    TEST_ASSERT_FALSE(load_movie(&loaded, buffer, size - 1));
+    TEST_ASSERT_FALSE(load_movie(&loaded, buffer, MOVIE_HEADER_SIZE - 1));
+
+    // A run without any frames.
+    buffer[MOVIE_HEADER_SIZE + 2] = 0;
+    buffer[MOVIE_HEADER_SIZE + 3] = 0;
+    TEST_ASSERT_FALSE(load_movie(&loaded, buffer, size));
+
+    // Another version.
+    save_movie(&movie, buffer, sizeof(buffer));
+    buffer[4]++;
+    TEST_ASSERT_FALSE(load_movie(&loaded, buffer, size));
+
+    // Nothing was loaded from any of them.
+    TEST_ASSERT_NULL(loaded.runs);
+    TEST_ASSERT_EQUAL_UINT32(0, loaded.frames);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_recording_keeps_settings);
+    RUN_TEST(test_unchanged_keys_share_a_run);
+    RUN_TEST(test_playback_ends_in_recorded_state);
+    RUN_TEST(test_playback_matches_on_every_core);
+    RUN_TEST(test_playback_detects_divergence);
+    RUN_TEST(test_playback_rejects_other_program);
+    RUN_TEST(test_saved_movie_plays_back);
+    RUN_TEST(test_load_rejects_invalid_movies);
+    return UNITY_END();
+}
@@ -0,0 +1,143 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "cpu.h"
+#include "profile.h"
+#include "unity.h"
+
+static struct chip8_vm vm;
+
+// Draws font characters and clears them again, before running into a machine
+// code routine, which is invalid.
+static const uint8_t PROGRAM[] = {
+    0x60, 0x00,  // 0x200: V0 = 0
+    0xF0, 0x29,  // 0x202: I = font character of V0
+    0xD0, 0x05,  // 0x204: Draw 8x5 at V0, V0
+    0x70, 0x01,  // 0x206: V0 += 1
+    0x30, 0x03,  // 0x208: Skip if V0 == 3
+    0x12, 0x02,  // 0x20A: Jump to 0x202
+    0x00, 0xE0,  // 0x20C: Clear the display
+    0x00, 0x00,  // 0x20E: Call machine code routine
+};
+
+void setUp()
+{
+    init_vm(&vm);
+}
+
+void tearDown()
+{
+    free_vm(&vm);
+}
+
+/**
+ * Runs the program on a core until it reaches the invalid instruction.
+ *
+ * @param core The core to run the program on.
+ */
+static void run_program(enum cpu_core core)
+{
+    struct cpu_status status;
+    set_cpu_core(&vm, core);
+    startup_rom(&vm, PROGRAM, sizeof(PROGRAM));
+
+    // Loading a program clears the display, which is not part of it.
+    vm.profile.clears = 0;
+    run_cycles(&vm, 100, &status);
+}
+
+/**
+ * Asserts the counters of the program, which are the same on every core.
+ */
+static void assert_counters()
+{
+    TEST_ASSERT_EQUAL_UINT64(1, vm.profile.opcodes[OP_LD_VX_NN]);
+    TEST_ASSERT_EQUAL_UINT64(3, vm.profile.opcodes[OP_LD_F]);
+    TEST_ASSERT_EQUAL_UINT64(3, vm.profile.opcodes[OP_DRW]);
+    TEST_ASSERT_EQUAL_UINT64(3, vm.profile.opcodes[OP_SE_VX_NN]);
+    TEST_ASSERT_EQUAL_UINT64(2, vm.profile.opcodes[OP_JP]);
+    TEST_ASSERT_EQUAL_UINT64(1, vm.profile.opcodes[OP_CLS]);
+    TEST_ASSERT_EQUAL_UINT64(1, vm.profile.opcodes[OP_INVALID]);
+
+    TEST_ASSERT_EQUAL_UINT64(1, vm.profile.addresses[0x200]);
+    TEST_ASSERT_EQUAL_UINT64(3, vm.profile.addresses[0x202]);
+    TEST_ASSERT_EQUAL_UINT64(2, vm.profile.addresses[0x20A]);
+    TEST_ASSERT_EQUAL_UINT64(1, vm.profile.addresses[0x20E]);
+    TEST_ASSERT_EQUAL_UINT64(0, vm.profile.addresses[0x210]);
+
+    TEST_ASSERT_EQUAL_UINT64(16, vm.profile.statuses[SUCCESS]);
+    TEST_ASSERT_EQUAL_UINT64(1, vm.profile.statuses[INVALID_INSTRUCTION]);
+
+    TEST_ASSERT_EQUAL_UINT64(3, vm.profile.draws);
+    TEST_ASSERT_EQUAL_UINT64(1, vm.profile.clears);
+}
+
+// MARK: Counters
+
+void test_table_core_is_counted()
+{
+    run_program(CORE_TABLE);
+    assert_counters();
+}
+
+void test_threaded_core_is_counted()
+{
+    run_program(CORE_THREADED);
+    assert_counters();
+}
+
+void test_dynarec_core_is_counted()
+{
+    run_program(CORE_DYNAREC);
+    assert_counters();
+}
+
+void test_resolution_switches_are_not_clears()
+{
+    const uint8_t rom[] = {
+        0x00, 0xFF,  // 0x200: High resolution
+        0x00, 0xFE,  // 0x202: Low resolution
+        0x00, 0x00,  // 0x204: Call machine code routine
+    };
+    struct cpu_status status;
+    startup_rom(&vm, rom, sizeof(rom));
+    vm.profile.clears = 0;
+    vm.profile.resolution_switches = 0;
+    run_cycles(&vm, 100, &status);
+
+    TEST_ASSERT_EQUAL_UINT64(0, vm.profile.clears);
+    TEST_ASSERT_EQUAL_UINT64(2, vm.profile.resolution_switches);
+}
+
+// MARK: Export
+
+void test_profile_is_written_as_json()
+{
+    run_program(CORE_TABLE);
+
+    char buffer[4096] = {0};
+    FILE *f = tmpfile();
+    write_profile(&vm, f);
+    rewind(f);
+    fread(buffer, 1, sizeof(buffer) - 1, f);
+    fclose(f);
+
+    TEST_ASSERT_NOT_NULL(strstr(buffer, "\"instructions\": 17,"));
+    TEST_ASSERT_NOT_NULL(strstr(buffer, "\"drw\": 3,"));
+    TEST_ASSERT_NOT_NULL(strstr(buffer, "\"INVALID_INSTRUCTION\": 1,"));
+    TEST_ASSERT_NOT_NULL(strstr(buffer, "\"0x202\": 3,"));
+    TEST_ASSERT_NULL(strstr(buffer, "\"0x210\""));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_table_core_is_counted);
+    RUN_TEST(test_threaded_core_is_counted);
+    RUN_TEST(test_dynarec_core_is_counted);
+    RUN_TEST(test_resolution_switches_are_not_clears);
+    RUN_TEST(test_profile_is_written_as_json);
+    return UNITY_END();
+}
@@ -0,0 +1,237 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "cpu.h"
+#include "display.h"
+#include "memory.h"
+#include "quirks.h"
+#include "unity.h"
+
+static struct chip8_vm vm;
+
+void setUp()
+{
+    init_vm(&vm);
+}
+
+void tearDown()
+{
+    free_vm(&vm);
+}
+
+/**
+ * Switches the machine to the quirks of a profile.
+ *
+ * @param profile The profile to switch to.
+ */
+static void use_profile(enum quirk_profile profile)
+{
+    set_quirks(&vm, QUIRK_PROFILES[profile]);
+}
+
+/**
+ * Points the index register at a sprite of a 0, 8 pixels wide and 5 high.
+ */
+static void load_sprite()
+{
+    const uint8_t sprite[] = {0xF0, 0x90, 0x90, 0x90, 0xF0};
+    for (uint8_t i = 0; i < sizeof(sprite); i++) {
+        write_memory(&vm, 0x300 + i, sprite[i]);
+    }
+    debug_run_instruction(&vm, 0xA300);
+}
+
+// MARK: Profiles
+
+void test_find_quirk_profile_finds_every_profile()
+{
+    enum quirk_profile profile;
+
+    TEST_ASSERT_TRUE(find_quirk_profile("vip", &profile));
+    TEST_ASSERT_EQUAL_UINT8(QUIRKS_VIP, profile);
+    TEST_ASSERT_TRUE(find_quirk_profile("chip48", &profile));
+    TEST_ASSERT_EQUAL_UINT8(QUIRKS_CHIP48, profile);
+    TEST_ASSERT_TRUE(find_quirk_profile("schip", &profile));
+    TEST_ASSERT_EQUAL_UINT8(QUIRKS_SCHIP, profile);
+    TEST_ASSERT_TRUE(find_quirk_profile("modern", &profile));
+    TEST_ASSERT_EQUAL_UINT8(QUIRKS_MODERN, profile);
+}
+
+void test_find_quirk_profile_rejects_unknown_names()
+{
+    enum quirk_profile profile = QUIRKS_VIP;
+
+    TEST_ASSERT_FALSE(find_quirk_profile("xochip", &profile));
+    TEST_ASSERT_FALSE(find_quirk_profile("", &profile));
+    TEST_ASSERT_EQUAL_UINT8(QUIRKS_VIP, profile);
+}
+
+// MARK: Quirks
+
+// 0x8XY1, 0x8XY2 and 0x8XY3
+void test_logic_resets_vf_on_vip()
+{
+    uint16_t instructions[] = {0x8011, 0x8012, 0x8013};
+    for (uint8_t i = 0; i < 3; i++) {
+        use_profile(QUIRKS_VIP);
+        debug_run_instruction(&vm, 0x6F07);
+        debug_run_instruction(&vm, instructions[i]);
+        TEST_ASSERT_EQUAL_HEX8(0x00, get_variable_registers(&vm)[0xF]);
+
+        use_profile(QUIRKS_MODERN);
+        debug_run_instruction(&vm, 0x6F07);
+        debug_run_instruction(&vm, instructions[i]);
+        TEST_ASSERT_EQUAL_HEX8(0x07, get_variable_registers(&vm)[0xF]);
+    }
+}
+
+// 0x8XY6 and 0x8XYE
+void test_shift_uses_vy_on_vip()
+{
+    use_profile(QUIRKS_VIP);
+    debug_run_instruction(&vm, 0x6000);
+    debug_run_instruction(&vm, 0x6181);
+    debug_run_instruction(&vm, 0x8016);
+    TEST_ASSERT_EQUAL_HEX8(0x40, get_variable_registers(&vm)[0x0]);
+    TEST_ASSERT_EQUAL_HEX8(0x01, get_variable_registers(&vm)[0xF]);
+
+    debug_run_instruction(&vm, 0x6000);
+    debug_run_instruction(&vm, 0x801E);
+    TEST_ASSERT_EQUAL_HEX8(0x02, get_variable_registers(&vm)[0x0]);
+    TEST_ASSERT_EQUAL_HEX8(0x01, get_variable_registers(&vm)[0xF]);
+}
+
+// 0x8XY6 and 0x8XYE
+void test_shift_uses_vx_on_schip()
+{
+    use_profile(QUIRKS_SCHIP);
+    debug_run_instruction(&vm, 0x6002);
+    debug_run_instruction(&vm, 0x6181);
+    debug_run_instruction(&vm, 0x8016);
+    TEST_ASSERT_EQUAL_HEX8(0x01, get_variable_registers(&vm)[0x0]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, get_variable_registers(&vm)[0xF]);
+
+    debug_run_instruction(&vm, 0x801E);
+    TEST_ASSERT_EQUAL_HEX8(0x02, get_variable_registers(&vm)[0x0]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, get_variable_registers(&vm)[0xF]);
+}
+
+// 0xBNNN
+void test_jump_with_offset_uses_vx_on_chip48()
+{
+    debug_run_instruction(&vm, 0x6001);
+    debug_run_instruction(&vm, 0x6204);
+
+    use_profile(QUIRKS_CHIP48);
+    debug_run_instruction(&vm, 0xB210);
+    TEST_ASSERT_EQUAL_HEX16(0x214, get_program_counter(&vm));
+
+    use_profile(QUIRKS_VIP);
+    debug_run_instruction(&vm, 0xB210);
+    TEST_ASSERT_EQUAL_HEX16(0x211, get_program_counter(&vm));
+}
+
+// 0xFX55 and 0xFX65
+void test_store_and_load_advance_index_per_profile()
+{
+    struct {
+        enum quirk_profile profile;
+        uint16_t index;
+    } cases[] = {
+        {QUIRKS_VIP, 0x303},
+        {QUIRKS_CHIP48, 0x302},
+        {QUIRKS_SCHIP, 0x300},
+        {QUIRKS_MODERN, 0x300},
+    };
+
+    for (uint8_t i = 0; i < 4; i++) {
+        use_profile(cases[i].profile);
+        debug_run_instruction(&vm, 0xA300);
+        debug_run_instruction(&vm, 0xF255);
+        TEST_ASSERT_EQUAL_HEX16(cases[i].index, get_index_register(&vm));
+
+        debug_run_instruction(&vm, 0xA300);
+        debug_run_instruction(&vm, 0xF265);
+        TEST_ASSERT_EQUAL_HEX16(cases[i].index, get_index_register(&vm));
+    }
+}
+
+// 0xDXYN
+void test_draw_wraps_around_edges_with_wrap_quirk()
+{
+    struct quirks quirks = QUIRK_PROFILES[QUIRKS_MODERN];
+    quirks.wrap = true;
+    set_quirks(&vm, quirks);
+
+    // Draw the sprite across the bottom right corner.
+    load_sprite();
+    debug_run_instruction(&vm, 0x613E);
+    debug_run_instruction(&vm, 0x621E);
+    debug_run_instruction(&vm, 0xD125);
+
+    TEST_ASSERT_TRUE(get_pixel(&vm, 62, 30));
+    TEST_ASSERT_TRUE(get_pixel(&vm, 1, 30));
+    TEST_ASSERT_TRUE(get_pixel(&vm, 62, 0));
+    TEST_ASSERT_TRUE(get_pixel(&vm, 1, 2));
+    TEST_ASSERT_FALSE(get_pixel(&vm, 0, 1));
+    TEST_ASSERT_EQUAL_HEX8(0x00, get_variable_registers(&vm)[0xF]);
+
+    // Drawing it again has to collide on the wrapped pixels too.
+    debug_run_instruction(&vm, 0xD125);
+    TEST_ASSERT_FALSE(get_pixel(&vm, 1, 2));
+    TEST_ASSERT_EQUAL_HEX8(0x01, get_variable_registers(&vm)[0xF]);
+}
+
+// 0xDXYN
+void test_draw_clips_edges_without_wrap_quirk()
+{
+    use_profile(QUIRKS_VIP);
+    load_sprite();
+    debug_run_instruction(&vm, 0x613E);
+    debug_run_instruction(&vm, 0x621E);
+    debug_run_instruction(&vm, 0xD125);
+
+    TEST_ASSERT_TRUE(get_pixel(&vm, 62, 30));
+    TEST_ASSERT_FALSE(get_pixel(&vm, 1, 30));
+    TEST_ASSERT_FALSE(get_pixel(&vm, 62, 0));
+}
+
+// MARK: Decoded instructions
+
+void test_set_quirks_redecodes_cached_instructions()
+{
+    const uint8_t rom[] = {
+        0x60, 0x00,  // 0x200: V0 = 0
+        0x61, 0x04,  // 0x202: V1 = 4
+        0x80, 0x16,  // 0x204: Shift V0 right
+        0x12, 0x00,  // 0x206: Jump to 0x200
+    };
+    struct cpu_status status;
+
+    use_profile(QUIRKS_MODERN);
+    startup_rom(&vm, rom, sizeof(rom));
+    run_cycles(&vm, 4, &status);
+    TEST_ASSERT_EQUAL_HEX8(0x00, get_variable_registers(&vm)[0x0]);
+
+    // The shift was decoded for the old profile, and has to change with it.
+    use_profile(QUIRKS_VIP);
+    run_cycles(&vm, 3, &status);
+    TEST_ASSERT_EQUAL_HEX8(0x02, get_variable_registers(&vm)[0x0]);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_find_quirk_profile_finds_every_profile);
+    RUN_TEST(test_find_quirk_profile_rejects_unknown_names);
+    RUN_TEST(test_logic_resets_vf_on_vip);
+    RUN_TEST(test_shift_uses_vy_on_vip);
+    RUN_TEST(test_shift_uses_vx_on_schip);
+    RUN_TEST(test_jump_with_offset_uses_vx_on_chip48);
+    RUN_TEST(test_store_and_load_advance_index_per_profile);
+    RUN_TEST(test_draw_wraps_around_edges_with_wrap_quirk);
+    RUN_TEST(test_draw_clips_edges_without_wrap_quirk);
+    RUN_TEST(test_set_quirks_redecodes_cached_instructions);
+    return UNITY_END();
+}
@@ -0,0 +1,190 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "cpu.h"
+#include "rewind.h"
+#include "scheduler.h"
+#include "unity.h"
+
+#define FRAMES 100
+
+static struct chip8_vm vm;
+static struct rewind r;
+static uint64_t hashes[FRAMES];
+
+// Counts V0 up, mirroring it into memory and onto the display.
+static const uint8_t COUNTER[] = {
+    0x70, 0x01,  // 0x200: V0 += 1
+    0xA2, 0x10,  // 0x202: I = 0x210
+    0xF0, 0x55,  // 0x204: Store V0 at I
+    0xD0, 0x01,  // 0x206: Draw 1 row at V0, V0
+    0x12, 0x00,  // 0x208: Jump to 0x200
+};
+
+// Counts V0 up, storing it far from the program.
+static const uint8_t STORER[] = {
+    0x70, 0x01,  // 0x200: V0 += 1
+    0xA8, 0x00,  // 0x202: I = 0x800
+    0xF0, 0x55,  // 0x204: Store V0 at I
+    0x12, 0x00,  // 0x206: Jump to 0x200
+};
+
+void setUp()
+{
+    init_vm(&vm);
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+}
+
+void tearDown()
+{
+    free_rewind(&r);
+    free_vm(&vm);
+}
+
+/**
+ * Runs frames, recording each of them, and the hashes of the states after.
+ *
+ * @param frames The amount of frames to run.
+ */
+static void run_frames(uint32_t frames)
+{
+    struct cpu_status status;
+    for (uint32_t i = 0; i < frames; i++) {
+        run_frame(&vm, &status);
+        record_frame(&r, &vm);
+        hashes[i] = hash_vm(&vm);
+    }
+}
+
+// MARK: Stepping back
+
+void test_rewind_steps_back_every_frame()
+{
+    init_rewind(&r, DEFAULT_REWIND_BUDGET, 1);
+    run_frames(FRAMES);
+
+    for (int32_t i = FRAMES - 2; i >= 0; i--) {
+        TEST_ASSERT_TRUE(rewind_frame(&r, &vm));
+        TEST_ASSERT_EQUAL_HEX64(hashes[i], hash_vm(&vm));
+    }
+
+    // Stays on the oldest snapshot once exhausted.
+    TEST_ASSERT_FALSE(rewind_frame(&r, &vm));
+    TEST_ASSERT_EQUAL_HEX64(hashes[0], hash_vm(&vm));
+}
+
+void test_rewind_steps_back_every_interval()
+{
+    init_rewind(&r, DEFAULT_REWIND_BUDGET, 10);
+    run_frames(FRAMES);
+
+    // Snapshots were captured after the 1st, 11th, 21st and so on frame, and
+    // the first step leaves the latest one.
+    for (int32_t i = FRAMES - 20; i >= 0; i -= 10) {
+        TEST_ASSERT_TRUE(rewind_frame(&r, &vm));
+        TEST_ASSERT_EQUAL_HEX64(hashes[i], hash_vm(&vm));
+    }
+    TEST_ASSERT_FALSE(rewind_frame(&r, &vm));
+}
+
+void test_rewind_resumes_recording()
+{
+    init_rewind(&r, DEFAULT_REWIND_BUDGET, 1);
+    run_frames(50);
+    for (uint8_t i = 0; i < 20; i++) {
+        rewind_frame(&r, &vm);
+    }
+
+    // The history continues from the state that was rewound to.
+    uint64_t rewound = hash_vm(&vm);
+    run_frames(10);
+    for (uint8_t i = 0; i < 10; i++) {
+        TEST_ASSERT_TRUE(rewind_frame(&r, &vm));
+    }
+    TEST_ASSERT_EQUAL_HEX64(rewound, hash_vm(&vm));
+    TEST_ASSERT_EQUAL_UINT32(29, r.count);
+}
+
+void test_rewind_restores_memory_across_restarts()
+{
+    init_rewind(&r, DEFAULT_REWIND_BUDGET, 1);
+    startup_rom(&vm, STORER, sizeof(STORER));
+    run_frames(10);
+    uint64_t before[10];
+    memcpy(before, hashes, sizeof(before));
+
+    // Restarting blanks the stored line again, and forgets it was written.
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    run_frames(10);
+
+    for (int32_t i = 8; i >= 0; i--) {
+        TEST_ASSERT_TRUE(rewind_frame(&r, &vm));
+        TEST_ASSERT_EQUAL_HEX64(hashes[i], hash_vm(&vm));
+    }
+    for (int32_t i = 9; i >= 0; i--) {
+        TEST_ASSERT_TRUE(rewind_frame(&r, &vm));
+        TEST_ASSERT_EQUAL_HEX64(before[i], hash_vm(&vm));
+    }
+}
+
+void test_rewind_without_snapshots()
+{
+    init_rewind(&r, DEFAULT_REWIND_BUDGET, 1);
+    uint64_t expected = hash_vm(&vm);
+
+    TEST_ASSERT_FALSE(rewind_frame(&r, &vm));
+    TEST_ASSERT_EQUAL_HEX64(expected, hash_vm(&vm));
+}
+
+// MARK: Budget
+
+void test_rewind_deltas_are_small()
+{
+    init_rewind(&r, DEFAULT_REWIND_BUDGET, 1);
+    run_frames(FRAMES);
+
+    // Only the registers, a byte of memory and a row of the display change.
+    TEST_ASSERT_LESS_THAN(64 * (FRAMES - 1), r.used);
+}
+
+void test_rewind_drops_oldest_snapshots()
+{
+    init_rewind(&r, 1000, 1);
+    run_frames(FRAMES);
+
+    TEST_ASSERT_LESS_OR_EQUAL(1000, r.used);
+    TEST_ASSERT_LESS_THAN(FRAMES - 1, r.count);
+
+    // The newest snapshots are still intact after the ring wrapped around.
+    uint32_t count = r.count;
+    for (uint32_t i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(rewind_frame(&r, &vm));
+        TEST_ASSERT_EQUAL_HEX64(hashes[FRAMES - 2 - i], hash_vm(&vm));
+    }
+    TEST_ASSERT_FALSE(rewind_frame(&r, &vm));
+}
+
+void test_rewind_without_budget()
+{
+    TEST_ASSERT_TRUE(init_rewind(&r, 0, 1));
+    run_frames(10);
+
+    // Only the latest snapshot is kept.
+    TEST_ASSERT_FALSE(rewind_frame(&r, &vm));
+    TEST_ASSERT_EQUAL_HEX64(hashes[9], hash_vm(&vm));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rewind_steps_back_every_frame);
+    RUN_TEST(test_rewind_steps_back_every_interval);
+    RUN_TEST(test_rewind_resumes_recording);
+    RUN_TEST(test_rewind_restores_memory_across_restarts);
+    RUN_TEST(test_rewind_without_snapshots);
+    RUN_TEST(test_rewind_deltas_are_small);
+    RUN_TEST(test_rewind_drops_oldest_snapshots);
+    RUN_TEST(test_rewind_without_budget);
+    return UNITY_END();
+}
@@ -0,0 +1,117 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "cpu.h"
+#include "rng.h"
+#include "unity.h"
+
+#define DRAWS 1000
+
+static struct chip8_vm vm;
+static struct chip8_vm other;
+
+// Draws a random byte into V0 forever.
+static const uint8_t RANDOM[] = {
+    0xC0, 0xFF,  // 0x200: V0 = random & 0xFF
+    0x12, 0x00,  // 0x202: Jump to 0x200
+};
+
+void setUp()
+{
+    init_vm(&vm);
+    init_vm(&other);
+}
+
+void tearDown()
+{
+    free_vm(&vm);
+    free_vm(&other);
+}
+
+// MARK: Sequences
+
+void test_same_seed_draws_same_numbers()
+{
+    seed_rng(&vm, 1234);
+    seed_rng(&other, 1234);
+
+    for (uint32_t i = 0; i < DRAWS; i++) {
+        TEST_ASSERT_EQUAL_HEX32(next_random(&vm), next_random(&other));
+    }
+}
+
+void test_neighbouring_seeds_draw_different_numbers()
+{
+    seed_rng(&vm, 1234);
+    seed_rng(&other, 1235);
+
+    uint32_t same = 0;
+    for (uint32_t i = 0; i < DRAWS; i++) {
+        same += next_random(&vm) == next_random(&other);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, same);
+}
+
+void test_reset_restarts_sequence()
+{
+    uint32_t first = next_random(&vm);
+    next_random(&vm);
+    reset_rng(&vm);
+
+    TEST_ASSERT_EQUAL_HEX32(first, next_random(&vm));
+}
+
+void test_machines_draw_independently()
+{
+    // Drawing from one machine leaves the numbers of the other untouched.
+    uint32_t expected = next_random(&vm);
+    next_random(&other);
+    reset_rng(&vm);
+
+    TEST_ASSERT_EQUAL_HEX32(expected, next_random(&vm));
+}
+
+// MARK: Instructions
+
+void test_random_instruction_restarts_with_program()
+{
+    struct cpu_status status;
+    seed_rng(&vm, 42);
+    startup_rom(&vm, RANDOM, sizeof(RANDOM));
+    run_cycles(&vm, 1, &status);
+    uint8_t expected = get_variable_registers(&vm)[0];
+
+    run_cycles(&vm, 100, &status);
+    startup_rom(&vm, RANDOM, sizeof(RANDOM));
+    run_cycles(&vm, 1, &status);
+
+    TEST_ASSERT_EQUAL_HEX8(expected, get_variable_registers(&vm)[0]);
+}
+
+void test_random_instruction_draws_every_byte()
+{
+    struct cpu_status status;
+    bool drawn[256] = {false};
+    startup_rom(&vm, RANDOM, sizeof(RANDOM));
+
+    for (uint32_t i = 0; i < 256 * 16; i++) {
+        run_cycles(&vm, 2, &status);
+        drawn[get_variable_registers(&vm)[0]] = true;
+    }
+    for (uint16_t value = 0; value < 256; value++) {
+        TEST_ASSERT_TRUE(drawn[value]);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_same_seed_draws_same_numbers);
+    RUN_TEST(test_neighbouring_seeds_draw_different_numbers);
+    RUN_TEST(test_reset_restarts_sequence);
+    RUN_TEST(test_machines_draw_independently);
+    RUN_TEST(test_random_instruction_restarts_with_program);
+    RUN_TEST(test_random_instruction_draws_every_byte);
+    return UNITY_END();
+}
@@ -0,0 +1,347 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "cpu.h"
+#include "keypad.h"
+#include "macros.h"
+#include "memory.h"
+#include "scheduler.h"
+#include "unity.h"
+
+static struct chip8_vm vm;
+
+// Counts up in V0 forever.
+static const uint8_t COUNTER[] = {
+    0x70, 0x01,  // 0x200: V0 += 1
+    0x12, 0x00,  // 0x202: Jump to 0x200
+};
+
+// Waits for the delay timer to run out, and counts the times it did in V1.
+static const uint8_t DELAY[] = {
+    0x60, 0x03,  // 0x200: V0 = 3
+    0xF0, 0x15,  // 0x202: Delay timer = V0
+    0xF0, 0x07,  // 0x204: V0 = delay timer
+    0x30, 0x00,  // 0x206: Skip if V0 == 0
+    0x12, 0x04,  // 0x208: Jump to 0x204
+    0x71, 0x01,  // 0x20A: V1 += 1
+    0x12, 0x00,  // 0x20C: Jump to 0x200
+};
+
+// Waits for the delay timer in a poll loop, then spins in a jump to itself.
+static const uint8_t IDLE[] = {
+    0x60, 0x1E,  // 0x200: V0 = 30
+    0xF0, 0x15,  // 0x202: Delay timer = V0
+    0xF1, 0x07,  // 0x204: V1 = delay timer
+    0x31, 0x00,  // 0x206: Skip if V1 == 0
+    0x12, 0x04,  // 0x208: Jump to 0x204
+    0x72, 0x01,  // 0x20A: V2 += 1
+    0x32, 0x03,  // 0x20C: Skip if V2 == 3
+    0x12, 0x00,  // 0x20E: Jump to 0x200
+    0x12, 0x10,  // 0x210: Jump to 0x210
+};
+
+// Waits for a key with the delay timer running, and counts the keys in V1.
+static const uint8_t KEYS[] = {
+    0x60, 0x3C,  // 0x200: V0 = 60
+    0xF0, 0x15,  // 0x202: Delay timer = V0
+    0xF2, 0x0A,  // 0x204: V2 = key
+    0x71, 0x01,  // 0x206: V1 += 1
+    0x12, 0x04,  // 0x208: Jump to 0x204
+};
+
+// Jumps above the lowest 4 KB, to code placed there by load_high().
+static const uint8_t HIGH[] = {
+    0x71, 0x01,  // 0x200: V1 += 1, nine times over
+    0x71, 0x01,  // 0x202
+    0x71, 0x01,  // 0x204
+    0x71, 0x01,  // 0x206
+    0x71, 0x01,  // 0x208
+    0x71, 0x01,  // 0x20A
+    0x71, 0x01,  // 0x20C
+    0x71, 0x01,  // 0x20E
+    0x71, 0x01,  // 0x210
+    0x60, 0x12,  // 0x212: V0 = 0x12
+    0xBF, 0xFE,  // 0x214: Jump to 0xFFE + V0
+};
+
+static struct chip8_vm other;
+
+void setUp()
+{
+    init_vm(&vm);
+}
+
+void tearDown()
+{
+    free_vm(&vm);
+}
+
+/**
+ * Runs a number of frames, and sums up the cycles they ran.
+ *
+ * @param frames The amount of frames to run.
+ * @return The amount of CPU cycles that were run.
+ */
+static uint64_t run_frames(uint32_t frames)
+{
+    struct cpu_status status;
+    uint64_t cycles = 0;
+    for (uint32_t i = 0; i < frames; i++) {
+        cycles += run_frame(&vm, &status);
+    }
+    return cycles;
+}
+
+// MARK: Rate
+
+void test_second_runs_exact_instruction_count()
+{
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+
+    // 700 does not divide by 60, so the frames have to share the remainder.
+    TEST_ASSERT_EQUAL_UINT64(700, run_frames(TIMER_FREQUENCY));
+    TEST_ASSERT_EQUAL_UINT64(7000, run_frames(10 * TIMER_FREQUENCY));
+}
+
+void test_frames_differ_by_at_most_one_cycle()
+{
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+
+    for (uint32_t i = 0; i < TIMER_FREQUENCY; i++) {
+        uint64_t cycles = run_frames(1);
+        TEST_ASSERT_TRUE(cycles == 11 || cycles == 12);
+    }
+}
+
+void test_frames_convert_to_exact_cycles()
+{
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+
+    uint64_t expected = frames_to_cycles(&vm, 97);
+    TEST_ASSERT_EQUAL_UINT64(expected, run_frames(97));
+}
+
+void test_rate_can_be_changed()
+{
+    set_instructions_per_second(&vm, 1000);
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    TEST_ASSERT_EQUAL_UINT64(1000, run_frames(TIMER_FREQUENCY));
+
+    // Rates below the timer frequency would leave frames without cycles.
+    set_instructions_per_second(&vm, 1);
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    TEST_ASSERT_EQUAL_UINT64(TIMER_FREQUENCY, run_frames(TIMER_FREQUENCY));
+}
+
+void test_slower_rate_shortens_current_tick()
+{
+    set_instructions_per_second(&vm, 1000);
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+
+    // The tick of 16 cycles underway can not outlast a tick at the new rate.
+    set_instructions_per_second(&vm, 120);
+    TEST_ASSERT_EQUAL_UINT64(3, run_frames(1));
+    TEST_ASSERT_EQUAL_UINT64(2, run_frames(1));
+}
+
+// MARK: Timers
+
+void test_timers_tick_once_per_frame()
+{
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    vm.delay_timer = 10;
+    vm.sound_timer = 3;
+
+    run_frames(4);
+    TEST_ASSERT_EQUAL_UINT8(6, vm.delay_timer);
+    TEST_ASSERT_EQUAL_UINT8(0, vm.sound_timer);
+}
+
+void test_timers_tick_within_cycle_runs()
+{
+    struct cpu_status status;
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    vm.delay_timer = 10;
+
+    // The first two frames take 11 and 12 cycles.
+    run_scheduled(&vm, 22, &status);
+    TEST_ASSERT_EQUAL_UINT8(9, vm.delay_timer);
+    run_scheduled(&vm, 1, &status);
+    TEST_ASSERT_EQUAL_UINT8(8, vm.delay_timer);
+}
+
+void test_delay_timer_paces_program()
+{
+    startup_rom(&vm, DELAY, sizeof(DELAY));
+
+    // Every wait takes 3 ticks regardless of how fast the CPU runs, and ends
+    // in the frame following them, as the first wait starts within a frame.
+    run_frames(3 * 10 + 1);
+    TEST_ASSERT_EQUAL_UINT8(10, get_variable_registers(&vm)[1]);
+}
+
+// MARK: Idle loops
+
+void test_idle_skipping_matches_running()
+{
+    uint32_t rates[] = {60, 61, 700, 1000, 12345};
+    for (uint8_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        set_instructions_per_second(&vm, rates[i]);
+        startup_rom(&vm, IDLE, sizeof(IDLE));
+
+        init_vm(&other);
+        set_instructions_per_second(&other, rates[i]);
+        set_idle_skipping(&other, false);
+        startup_rom(&other, IDLE, sizeof(IDLE));
+
+        // Stop at every possible point within a tick along the way.
+        struct cpu_status status;
+        for (uint32_t frame = 0; frame < 120; frame++) {
+            uint64_t count = frame % 13 + 1;
+            TEST_ASSERT_EQUAL_UINT64(
+                run_scheduled(&other, count, &status),
+                run_scheduled(&vm, count, &status));
+            TEST_ASSERT_EQUAL_UINT64(
+                run_frame(&other, &status),
+                run_frame(&vm, &status));
+            TEST_ASSERT_EQUAL_HEX64(hash_vm(&other), hash_vm(&vm));
+        }
+        TEST_ASSERT_EQUAL_UINT8(3, get_variable_registers(&vm)[2]);
+        free_vm(&other);
+    }
+}
+
+/**
+ * Loads HIGH into a machine, with code of its own at 0x1010.
+ *
+ * @param machine The machine to load into.
+ * @param code The code to place at 0x1010.
+ * @param size The size of the code.
+ */
+static void load_high(
+    struct chip8_vm *machine,
+    const uint8_t *code,
+    uint16_t size)
+{
+    startup_rom(machine, HIGH, sizeof(HIGH));
+    memcpy(&machine->memory[0x1010], code, size);
+    mark_memory_written(machine, 0x1010, size);
+}
+
+void test_idle_skipping_only_matches_jumps_within_4k()
+{
+    // Neither is a loop, as jumps cut their target down to 12 bits.
+    const uint8_t jump[] = {
+        0x10, 0x10,  // 0x1010: Jump to 0x010
+    };
+    const uint8_t poll[] = {
+        0xF1, 0x07,  // 0x1010: V1 = delay timer
+        0x31, 0x00,  // 0x1012: Skip if V1 == 0
+        0x10, 0x10,  // 0x1014: Jump to 0x010
+    };
+    const uint8_t *codes[] = {jump, poll};
+    const uint16_t sizes[] = {sizeof(jump), sizeof(poll)};
+
+    uint32_t rates[] = {600, 660, 720};
+    for (uint8_t i = 0; i < len(rates) * len(codes); i++) {
+        set_instructions_per_second(&vm, rates[i / len(codes)]);
+        load_high(&vm, codes[i % len(codes)], sizes[i % len(codes)]);
+        vm.delay_timer = 10;
+
+        init_vm(&other);
+        set_instructions_per_second(&other, rates[i / len(codes)]);
+        set_idle_skipping(&other, false);
+        load_high(&other, codes[i % len(codes)], sizes[i % len(codes)]);
+        other.delay_timer = 10;
+
+        // Both leave for the fonts, and fail there, whatever the tick phase.
+        struct cpu_status skipped;
+        struct cpu_status ran;
+        TEST_ASSERT_EQUAL_UINT64(
+            run_scheduled(&other, 100000, &ran),
+            run_scheduled(&vm, 100000, &skipped));
+        TEST_ASSERT_NOT_EQUAL(SUCCESS, skipped.code);
+        TEST_ASSERT_EQUAL_UINT8(ran.code, skipped.code);
+        TEST_ASSERT_EQUAL_HEX64(hash_vm(&other), hash_vm(&vm));
+        free_vm(&other);
+    }
+}
+
+// MARK: Keypad
+
+void test_wait_for_key_idles_whole_frames()
+{
+    startup_rom(&vm, KEYS, sizeof(KEYS));
+    run_frames(1);
+    TEST_ASSERT_EQUAL_HEX16(0x204, get_program_counter(&vm));
+
+    // The timers keep ticking while the CPU waits.
+    struct cpu_status status;
+    uint64_t cycles = run_frame(&vm, &status);
+    TEST_ASSERT_EQUAL_UINT8(SUCCESS, status.code);
+    TEST_ASSERT_EQUAL_UINT64(frames_to_cycles(&vm, 2) - 11, cycles);
+    TEST_ASSERT_EQUAL_UINT8(58, vm.delay_timer);
+    TEST_ASSERT_EQUAL_HEX16(0x204, get_program_counter(&vm));
+
+    set_keys(&vm, 1 << 0x5);
+    set_keys(&vm, 0);
+    run_frames(1);
+    TEST_ASSERT_EQUAL_UINT8(1, get_variable_registers(&vm)[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x5, get_variable_registers(&vm)[2]);
+    TEST_ASSERT_EQUAL_HEX16(0x204, get_program_counter(&vm));
+}
+
+void test_released_keys_expire_with_the_tick()
+{
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    set_keys(&vm, 1 << 0x5);
+    set_keys(&vm, 0);
+
+    // The key was released while no wait was running, so it is dropped.
+    run_frames(1);
+    startup_rom(&vm, KEYS, sizeof(KEYS));
+    run_frames(2);
+    TEST_ASSERT_EQUAL_UINT8(0, get_variable_registers(&vm)[1]);
+}
+
+void test_key_wait_skipping_matches_running()
+{
+    startup_rom(&vm, KEYS, sizeof(KEYS));
+    init_vm(&other);
+    set_idle_skipping(&other, false);
+    startup_rom(&other, KEYS, sizeof(KEYS));
+
+    struct cpu_status status;
+    for (uint32_t frame = 0; frame < 120; frame++) {
+        if (frame % 7 == 0) {
+            set_keys(&vm, frame & 0xFFFF);
+            set_keys(&other, frame & 0xFFFF);
+        }
+        TEST_ASSERT_EQUAL_UINT64(
+            run_frame(&other, &status),
+            run_frame(&vm, &status));
+        TEST_ASSERT_EQUAL_HEX64(hash_vm(&other), hash_vm(&vm));
+    }
+    TEST_ASSERT_NOT_EQUAL_UINT8(0, get_variable_registers(&vm)[1]);
+    free_vm(&other);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_second_runs_exact_instruction_count);
+    RUN_TEST(test_frames_differ_by_at_most_one_cycle);
+    RUN_TEST(test_frames_convert_to_exact_cycles);
+    RUN_TEST(test_rate_can_be_changed);
+    RUN_TEST(test_slower_rate_shortens_current_tick);
+    RUN_TEST(test_timers_tick_once_per_frame);
+    RUN_TEST(test_timers_tick_within_cycle_runs);
+    RUN_TEST(test_delay_timer_paces_program);
+    RUN_TEST(test_idle_skipping_matches_running);
+    RUN_TEST(test_idle_skipping_only_matches_jumps_within_4k);
+    RUN_TEST(test_wait_for_key_idles_whole_frames);
+    RUN_TEST(test_released_keys_expire_with_the_tick);
+    RUN_TEST(test_key_wait_skipping_matches_running);
+    return UNITY_END();
+}
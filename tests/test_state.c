@@ -0,0 +1,288 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "audio.h"
+#include "chip8.h"
+#include "cpu.h"
+#include "display.h"
+#include "keypad.h"
+#include "rng.h"
+#include "scheduler.h"
+#include "state.h"
+#include "unity.h"
+
+#define STATE_PATH "test_state.ch8s"
+
+static struct chip8_vm vm;
+static struct chip8_vm other;
+static uint8_t state[STATE_SIZE];
+
+// Counts V0 up, mirroring it into the delay timer and memory, and calls a
+// subroutine along the way, so every part of a save state changes.
+static const uint8_t COUNTER[] = {
+    0x70, 0x01,  // 0x200: V0 += 1
+    0xF0, 0x15,  // 0x202: Delay timer = V0
+    0xA2, 0x10,  // 0x204: I = 0x210
+    0xF0, 0x55,  // 0x206: Store V0 at I
+    0x22, 0x0C,  // 0x208: Call 0x20C
+    0x12, 0x00,  // 0x20A: Jump to 0x200
+    0x00, 0xEE,  // 0x20C: Return
+};
+
+// Draws the font sprite of V0 forever.
+static const uint8_t DRAWING[] = {
+    0xF0, 0x29,  // 0x200: I = sprite of V0
+    0xD0, 0x05,  // 0x202: Draw 5 rows at V0, V0
+    0x12, 0x00,  // 0x204: Jump to 0x200
+};
+
+void setUp()
+{
+    init_vm(&vm);
+    init_vm(&other);
+}
+
+void tearDown()
+{
+    free_vm(&vm);
+    free_vm(&other);
+    remove(STATE_PATH);
+}
+
+/**
+ * Runs a machine for a number of emulated frames.
+ *
+ * @param machine The machine to run.
+ * @param frames The amount of frames to run.
+ */
+static void run_frames(struct chip8_vm *machine, uint32_t frames)
+{
+    struct cpu_status status;
+    for (uint32_t i = 0; i < frames; i++) {
+        run_frame(machine, &status);
+    }
+}
+
+// MARK: Round trips
+
+void test_save_state_layout()
+{
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    vm.PC = 0x234;
+
+    TEST_ASSERT_EQUAL_UINT64(STATE_SIZE, save_state(&vm, state, STATE_SIZE));
+    TEST_ASSERT_EQUAL_MEMORY(STATE_MAGIC, state, 4);
+    TEST_ASSERT_EQUAL_HEX8(STATE_VERSION, state[4]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, state[5]);
+    TEST_ASSERT_EQUAL_HEX8(0x34, state[6]);
+    TEST_ASSERT_EQUAL_HEX8(0x02, state[7]);
+}
+
+void test_save_state_needs_room()
+{
+    TEST_ASSERT_EQUAL_UINT64(0, save_state(&vm, state, STATE_SIZE - 1));
+}
+
+void test_load_state_resumes_run()
+{
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    set_instructions_per_second(&vm, 1000);
+    run_frames(&vm, 10);
+    save_state(&vm, state, sizeof(state));
+    run_frames(&vm, 10);
+
+    // The other machine never ran a program, and uses another speed.
+    TEST_ASSERT_TRUE(load_state(&other, state, sizeof(state)));
+    run_frames(&other, 10);
+
+    TEST_ASSERT_EQUAL_HEX64(hash_vm(&vm), hash_vm(&other));
+    TEST_ASSERT_EQUAL_UINT32(1000, other.scheduler.instructions_per_second);
+    TEST_ASSERT_EQUAL_UINT32(
+        vm.scheduler.tick_cycles,
+        other.scheduler.tick_cycles);
+}
+
+void test_load_state_replaces_decoded_instructions()
+{
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    run_frames(&vm, 10);
+    save_state(&vm, state, sizeof(state));
+    run_frames(&vm, 10);
+
+    // Decode another program at the same addresses before loading.
+    set_cpu_core(&other, CORE_DYNAREC);
+    startup_rom(&other, DRAWING, sizeof(DRAWING));
+    run_frames(&other, 10);
+    TEST_ASSERT_TRUE(load_state(&other, state, sizeof(state)));
+    run_frames(&other, 10);
+
+    TEST_ASSERT_EQUAL_HEX64(hash_vm(&vm), hash_vm(&other));
+}
+
+void test_load_state_restores_display()
+{
+    startup_rom(&vm, DRAWING, sizeof(DRAWING));
+    run_frames(&vm, 1);
+    save_state(&vm, state, sizeof(state));
+
+    TEST_ASSERT_TRUE(load_state(&other, state, sizeof(state)));
+    TEST_ASSERT_TRUE(other.display_dirty);
+    TEST_ASSERT_EQUAL_MEMORY(vm.display, other.display, sizeof(vm.display));
+}
+
+void test_load_state_restores_high_resolution_and_flags()
+{
+    set_resolution(&vm, true);
+    uint8_t sprite[32];
+    memset(sprite, 0xFF, sizeof(sprite));
+    draw_large_sprite(&vm, 120, 60, sprite);
+    vm.flags[0x7] = 0x42;
+    save_state(&vm, state, sizeof(state));
+
+    TEST_ASSERT_TRUE(load_state(&other, state, sizeof(state)));
+    TEST_ASSERT_TRUE(other.hires);
+    TEST_ASSERT_EQUAL_HEX8(0x42, other.flags[0x7]);
+    TEST_ASSERT_EQUAL_MEMORY(vm.display, other.display, sizeof(vm.display));
+}
+
+void test_load_state_restores_planes_and_audio()
+{
+    uint8_t sprite[2] = {0xF0, 0x0F};
+    uint8_t pattern[AUDIO_PATTERN_SIZE];
+    memset(pattern, 0xAA, sizeof(pattern));
+
+    select_planes(&vm, 0x3);
+    draw_sprite(&vm, 4, 4, 1, sprite);
+    set_audio_pattern(&vm, pattern);
+    set_pitch(&vm, 0x20);
+    save_state(&vm, state, sizeof(state));
+
+    TEST_ASSERT_TRUE(load_state(&other, state, sizeof(state)));
+    TEST_ASSERT_EQUAL_UINT8(0x3, other.planes);
+    TEST_ASSERT_EQUAL_MEMORY(pattern, other.audio.pattern, sizeof(pattern));
+    TEST_ASSERT_EQUAL_UINT8(0x20, other.audio.pitch);
+    TEST_ASSERT_EQUAL_MEMORY(vm.display, other.display, sizeof(vm.display));
+}
+
+void test_load_state_restores_random_numbers()
+{
+    next_random(&vm);
+    save_state(&vm, state, sizeof(state));
+    uint32_t expected = next_random(&vm);
+
+    TEST_ASSERT_TRUE(load_state(&other, state, sizeof(state)));
+    TEST_ASSERT_EQUAL_HEX32(expected, next_random(&other));
+}
+
+void test_load_state_drops_released_keys()
+{
+    const uint8_t waiting[] = {0xF5, 0x0A};  // V5 = key
+    startup_rom(&vm, waiting, sizeof(waiting));
+    save_state(&vm, state, sizeof(state));
+
+    startup_rom(&other, waiting, sizeof(waiting));
+    set_keys(&other, 1 << 0x3);
+    set_keys(&other, 0);
+    TEST_ASSERT_TRUE(load_state(&other, state, sizeof(state)));
+
+    // The release predates the loaded wait, so it keeps waiting.
+    TEST_ASSERT_TRUE(is_waiting_for_key(&other));
+}
+
+void test_state_file_round_trip()
+{
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    run_frames(&vm, 10);
+
+    TEST_ASSERT_TRUE(save_state_file(&vm, STATE_PATH));
+    TEST_ASSERT_TRUE(load_state_file(&other, STATE_PATH));
+    TEST_ASSERT_EQUAL_HEX64(hash_vm(&vm), hash_vm(&other));
+}
+
+// MARK: Rejections
+
+/**
+ * Asserts that a save state is rejected, without changing the machine.
+ *
+ * @param size The size of the save state to load.
+ */
+static void assert_rejected(size_t size)
+{
+    startup_rom(&other, DRAWING, sizeof(DRAWING));
+    uint64_t expected = hash_vm(&other);
+
+    TEST_ASSERT_FALSE(load_state(&other, state, size));
+    TEST_ASSERT_EQUAL_HEX64(expected, hash_vm(&other));
+}
+
+void test_load_state_rejects_wrong_size()
+{
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    save_state(&vm, state, sizeof(state));
+
+    assert_rejected(STATE_SIZE - 1);
+}
+
+void test_load_state_rejects_wrong_magic()
+{
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    save_state(&vm, state, sizeof(state));
+    state[0] = 'X';
+
+    assert_rejected(STATE_SIZE);
+}
+
+void test_load_state_rejects_other_version()
+{
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    save_state(&vm, state, sizeof(state));
+    state[4] = STATE_VERSION + 1;
+
+    assert_rejected(STATE_SIZE);
+}
+
+void test_load_state_rejects_invalid_stack()
+{
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    vm.stack.pointer = STACK_SIZE;
+    save_state(&vm, state, sizeof(state));
+
+    assert_rejected(STATE_SIZE);
+}
+
+void test_load_state_rejects_overlong_tick()
+{
+    startup_rom(&vm, COUNTER, sizeof(COUNTER));
+    vm.scheduler.tick_cycles = vm.scheduler.instructions_per_second;
+    save_state(&vm, state, sizeof(state));
+
+    assert_rejected(STATE_SIZE);
+}
+
+void test_load_state_file_rejects_missing_file()
+{
+    TEST_ASSERT_FALSE(load_state_file(&other, STATE_PATH));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_save_state_layout);
+    RUN_TEST(test_save_state_needs_room);
+    RUN_TEST(test_load_state_resumes_run);
+    RUN_TEST(test_load_state_replaces_decoded_instructions);
+    RUN_TEST(test_load_state_restores_display);
+    RUN_TEST(test_load_state_restores_high_resolution_and_flags);
+    RUN_TEST(test_load_state_restores_planes_and_audio);
+    RUN_TEST(test_load_state_restores_random_numbers);
+    RUN_TEST(test_load_state_drops_released_keys);
+    RUN_TEST(test_state_file_round_trip);
+    RUN_TEST(test_load_state_rejects_wrong_size);
+    RUN_TEST(test_load_state_rejects_wrong_magic);
+    RUN_TEST(test_load_state_rejects_other_version);
+    RUN_TEST(test_load_state_rejects_invalid_stack);
+    RUN_TEST(test_load_state_rejects_overlong_tick);
+    RUN_TEST(test_load_state_file_rejects_missing_file);
+    return UNITY_END();
+}
@@ -0,0 +1,477 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "clock.h"
+#include "cpu.h"
+#include "headless.h"
+#include "memory.h"
+#include "movie.h"
+#include "quirks.h"
+#include "rng.h"
+
+#define USAGE                                                               \
+    "Usage: %s [options] ROM...\n"                                          \
+    "\n"                                                                    \
+    "  --list FILE    Also run the ROMs listed in FILE, one per line.\n"    \
+    "  --runs N       Run every ROM N times, as independent jobs.\n"        \
+    "  --cycles N     Stop each job after N CPU cycles.\n"                  \
+    "  --frames N     Stop each job after N emulated frames.\n"             \
+    "  --seconds S    Stop each job after S seconds of wall time.\n"        \
+    "  --play MOVIE   Play MOVIE back in every job, instead of a budget.\n" \
+    "  --core NAME    Core to use: table, threaded or dynarec.\n"           \
+    "  --seed N       Seed the first run of every ROM, counting up.\n"      \
+    "  --quirks NAME  Quirk profile: vip, chip48, schip or modern.\n"       \
+    "  --threads N    Worker threads, defaults to the core count.\n"        \
+    "  --output FILE  Write the results to FILE instead of stdout.\n"
+
+#define MAX_PATH_LENGTH 4096  // Longest line accepted from a list of ROMs
+
+// A single run of a ROM on its own machine.
+struct job {
+    const char *path;               // The ROM to run
+    bool owns_path;                 // If the path is freed along with the job
+    uint32_t run;                   // Which run of the ROM this is
+    uint64_t seed;                  // The seed of the random numbers
+    bool loaded;                    // If the ROM could be read and played
+    struct headless_result result;  // How the run ended
+    uint64_t hash;                  // The hash of the final machine state
+    bool verified;                  // If the movie ended where it was recorded
+};
+
+// The jobs assigned to a worker, of which other workers can steal.
+//
+// The owner takes jobs from the back, and thieves from the front, so they
+// only contend over the last job. Jobs run for far longer than the lock is
+// held, so a mutex is cheap enough, and much simpler than a lock-free deque.
+struct deque {
+    pthread_mutex_t lock;
+    uint32_t *jobs;  // Indices into the job list
+    uint32_t front;  // The first job not yet taken
+    uint32_t back;   // One past the last job not yet taken
+};
+
+// A worker thread and the machine it runs its jobs on.
+struct worker {
+    pthread_t thread;
+    uint32_t id;
+    struct chip8_vm *vm;
+};
+
+// The work shared by all workers, which is only read once they are started.
+static struct job *jobs;
+static uint32_t job_count;
+static struct deque *deques;
+static struct worker *workers;
+static uint32_t worker_count;
+static enum cpu_core core = CPU_DEFAULT_CORE;
+static uint64_t seed = DEFAULT_SEED;
+static enum quirk_profile quirks = DEFAULT_QUIRK_PROFILE;
+static struct headless_budget budget = {.cycles = 0, .frames = 0, .seconds = 0};
+static struct movie movie;
+static bool has_movie = false;
+
+/**
+ * Takes a job from the back of a worker's own deque.
+ *
+ * @param d The deque of the worker.
+ * @param job The index of the taken job.
+ * @return If a job was taken.
+ */
+static bool pop_job(struct deque *d, uint32_t *job)
+{
+    pthread_mutex_lock(&d->lock);
+    bool taken = d->front < d->back;
+    if (taken) {
+        *job = d->jobs[--d->back];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return taken;
+}
+
+/**
+ * Takes a job from the front of another worker's deque.
+ *
+ * @param d The deque to steal from.
+ * @param job The index of the stolen job.
+ * @return If a job was stolen.
+ */
+static bool steal_job(struct deque *d, uint32_t *job)
+{
+    pthread_mutex_lock(&d->lock);
+    bool taken = d->front < d->back;
+    if (taken) {
+        *job = d->jobs[d->front++];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return taken;
+}
+
+/**
+ * Runs a single job on a worker's machine.
+ *
+ * With a movie, the job plays it back into the ROM, with the movie's seed,
+ * speed and quirks, and checks that it ends where the recording did.
+ *
+ * @param vm The machine of the worker, reset by loading the ROM.
+ * @param job The job to run.
+ */
+static void run_job(struct chip8_vm *vm, struct job *job)
+{
+    FILE *f = fopen(job->path, "rb");
+    if (f == NULL) {
+        return;
+    }
+
+    uint8_t program[MEMORY_SIZE - PROGRAM_START];
+    size_t size = fread(program, 1, sizeof(program), f);
+    fclose(f);
+
+    // The flag registers outlive programs, so they are cleared for every job,
+    // or results would depend on which job ran on the machine before.
+    set_cpu_core(vm, core);
+    set_quirks(vm, QUIRK_PROFILES[quirks]);
+    seed_rng(vm, job->seed);
+    memset(vm->flags, 0, sizeof(vm->flags));
+    startup_rom(vm, program, size);
+
+    if (!has_movie) {
+        job->loaded = true;
+        job->result = run_headless(vm, budget);
+        job->hash = hash_vm(vm);
+        job->verified = true;
+        return;
+    }
+
+    // Playback advances through the runs of the movie, so every job plays a
+    // copy of its own, which only reads the shared runs.
+    struct movie played = movie;
+    if (!start_playback(&played, vm)) {
+        return;
+    }
+    job->seed = played.seed;
+    job->loaded = true;
+    job->result = play_headless(vm, &played);
+    job->hash = hash_vm(vm);
+    job->verified = verify_movie(&played, vm);
+}
+
+/**
+ * Runs jobs until none are left to take or steal.
+ *
+ * As no jobs are added once the workers are started, a worker can stop as
+ * soon as every deque is empty.
+ *
+ * @param arg The worker running the jobs.
+ * @return Always NULL.
+ */
+static void *work(void *arg)
+{
+    struct worker *worker = arg;
+    uint32_t job;
+
+    while (true) {
+        bool found = pop_job(&deques[worker->id], &job);
+        for (uint32_t i = 1; !found && i < worker_count; i++) {
+            found = steal_job(&deques[(worker->id + i) % worker_count], &job);
+        }
+        if (!found) {
+            return NULL;
+        }
+
+        run_job(worker->vm, &jobs[job]);
+    }
+}
+
+/**
+ * Adds a job for every run of a ROM.
+ *
+ * Every run gets its own seed, so the runs of a ROM differ from each other,
+ * but every batch with the same seed runs the exact same jobs.
+ *
+ * @param path The path of the ROM.
+ * @param runs The amount of times to run the ROM.
+ * @return If the jobs could be allocated.
+ */
+static bool add_jobs(const char *path, uint32_t runs)
+{
+    struct job *grown = realloc(jobs, (job_count + runs) * sizeof(*jobs));
+    if (grown == NULL) {
+        return false;
+    }
+
+    jobs = grown;
+    for (uint32_t run = 0; run < runs; run++) {
+        jobs[job_count++] =
+            (struct job){.path = path, .run = run, .seed = seed + run};
+    }
+    return true;
+}
+
+/**
+ * Adds jobs for every ROM listed in a file.
+ *
+ * @param list The path of the file, with one ROM path per line.
+ * @param runs The amount of times to run each ROM.
+ * @return If the file could be read, and its jobs allocated.
+ */
+static bool add_list(const char *list, uint32_t runs)
+{
+    FILE *f = fopen(list, "r");
+    if (f == NULL) {
+        return false;
+    }
+
+    char line[MAX_PATH_LENGTH];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || runs == 0) {
+            continue;
+        }
+
+        // All runs of the ROM share a single copy of its path, which the
+        // first of them owns.
+        char *path = strdup(line);
+        if (path == NULL || !add_jobs(path, runs)) {
+            free(path);
+            fclose(f);
+            return false;
+        }
+        jobs[job_count - runs].owns_path = true;
+    }
+
+    fclose(f);
+    return true;
+}
+
+/**
+ * Releases all jobs, along with the paths they own.
+ */
+static void free_jobs()
+{
+    for (uint32_t i = 0; i < job_count; i++) {
+        if (jobs[i].owns_path) {
+            free((char *)jobs[i].path);
+        }
+    }
+    free(jobs);
+    jobs = NULL;
+    job_count = 0;
+}
+
+/**
+ * Writes the results of all jobs as CSV, in the order they were given.
+ *
+ * @param out The stream to write to.
+ */
+static void write_results(FILE *out)
+{
+    fprintf(
+        out,
+        "rom,run,seed,loaded,cycles,hash,status,instruction,verified\n");
+    for (uint32_t i = 0; i < job_count; i++) {
+        struct job *job = &jobs[i];
+        fprintf(
+            out,
+            "%s,%u,%llu,%d,%llu,%016llx,%d,%04X,%d\n",
+            job->path,
+            job->run,
+            (unsigned long long)job->seed,
+            job->loaded,
+            (unsigned long long)job->result.cycles,
+            (unsigned long long)job->hash,
+            job->result.status.code,
+            job->result.status.instruction,
+            job->verified);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t runs = 1;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *output = NULL;
+    const char *play_path = NULL;
+    const char *lists[argc];
+    uint32_t list_count = 0;
+    const char *roms[argc];
+    uint32_t rom_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--list") == 0 && has_value) {
+            lists[list_count++] = argv[++i];
+        } else if (strcmp(argv[i], "--runs") == 0 && has_value) {
+            runs = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--cycles") == 0 && has_value) {
+            budget.cycles = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--frames") == 0 && has_value) {
+            budget.frames = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seconds") == 0 && has_value) {
+            budget.seconds = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--play") == 0 && has_value) {
+            play_path = argv[++i];
+        } else if (strcmp(argv[i], "--core") == 0 && has_value) {
+            i++;
+            if (strcmp(argv[i], "table") == 0) {
+                core = CORE_TABLE;
+            } else if (strcmp(argv[i], "threaded") == 0) {
+                core = CORE_THREADED;
+            } else if (strcmp(argv[i], "dynarec") == 0) {
+                core = CORE_DYNAREC;
+            } else {
+                printf(USAGE, argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--quirks") == 0 && has_value) {
+            if (!find_quirk_profile(argv[++i], &quirks)) {
+                printf(USAGE, argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && has_value) {
+            threads = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--output") == 0 && has_value) {
+            output = argv[++i];
+        } else if (argv[i][0] == '-') {
+            printf(USAGE, argv[0]);
+            return 1;
+        } else {
+            roms[rom_count++] = argv[i];
+        }
+    }
+
+    bool has_budget = budget.cycles || budget.frames || budget.seconds;
+    if (play_path != NULL && has_budget) {
+        printf("A movie runs for as long as it was recorded, not a budget!\n");
+        return 1;
+    }
+    if (play_path == NULL && !has_budget) {
+        printf("A batch run needs --cycles, --frames, --seconds or --play!\n");
+        return 1;
+    }
+
+    init_movie(&movie);
+    if (play_path != NULL) {
+        if (!load_movie_file(&movie, play_path)) {
+            printf("Could not load a movie from %s!\n", play_path);
+            return 1;
+        }
+        has_movie = true;
+    }
+
+    for (uint32_t i = 0; i < rom_count; i++) {
+        if (!add_jobs(roms[i], runs)) {
+            printf("Could not allocate the jobs!\n");
+            return 1;
+        }
+    }
+    for (uint32_t i = 0; i < list_count; i++) {
+        if (!add_list(lists[i], runs)) {
+            printf("Could not read the ROM list %s!\n", lists[i]);
+            return 1;
+        }
+    }
+
+    if (job_count == 0) {
+        printf("No ROM paths provided!\n");
+        return 1;
+    }
+
+    // More workers than jobs would only ever steal.
+    worker_count = threads > 0 ? threads : 1;
+    if (worker_count > job_count) {
+        worker_count = job_count;
+    }
+
+    // Deal the jobs out round-robin, so every worker starts with its share.
+    deques = calloc(worker_count, sizeof(*deques));
+    workers = calloc(worker_count, sizeof(*workers));
+    if (deques == NULL || workers == NULL) {
+        printf("Could not allocate the workers!\n");
+        return 1;
+    }
+    for (uint32_t i = 0; i < worker_count; i++) {
+        pthread_mutex_init(&deques[i].lock, NULL);
+        deques[i].jobs = malloc(job_count * sizeof(*deques[i].jobs));
+        if (deques[i].jobs == NULL) {
+            printf("Could not allocate the workers!\n");
+            return 1;
+        }
+    }
+    for (uint32_t i = 0; i < job_count; i++) {
+        struct deque *d = &deques[i % worker_count];
+        d->jobs[d->back++] = i;
+    }
+
+    // Every worker reuses a single machine for all of its jobs, as loading a
+    // ROM and clearing the flag registers resets everything a run can observe.
+    // Workers steal from every deque, so the jobs of workers that could not
+    // be started are still run by the others.
+    uint32_t started = 0;
+    double start = read_clock();
+    for (uint32_t i = 0; i < worker_count; i++) {
+        workers[i].id = i;
+        workers[i].vm = malloc(sizeof(*workers[i].vm));
+        if (workers[i].vm == NULL) {
+            break;
+        }
+        init_vm(workers[i].vm);
+        if (pthread_create(&workers[i].thread, NULL, work, &workers[i])) {
+            free(workers[i].vm);
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        printf("Could not start any worker threads!\n");
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        free_vm(workers[i].vm);
+        free(workers[i].vm);
+    }
+    double seconds = read_clock() - start;
+
+    int exit_code = 0;
+    uint64_t cycles = 0;
+    for (uint32_t i = 0; i < job_count; i++) {
+        cycles += jobs[i].result.cycles;
+        if (!jobs[i].loaded || jobs[i].result.status.code ||
+            !jobs[i].verified) {
+            exit_code = 1;
+        }
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (out == NULL) {
+        printf("Could not write the results to %s!\n", output);
+        return 1;
+    }
+    write_results(out);
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    // The summary goes to stderr, to keep stdout parseable.
+    fprintf(
+        stderr,
+        "Ran %u jobs on %u threads, %llu cycles in %.3f s (%.0f cycles/s).\n",
+        job_count,
+        started,
+        (unsigned long long)cycles,
+        seconds,
+        seconds > 0 ? cycles / seconds : 0);
+
+    free_jobs();
+    free_movie(&movie);
+    return exit_code;
+}